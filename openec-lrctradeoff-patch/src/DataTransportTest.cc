@@ -0,0 +1,198 @@
+#include "common/TcpTransport.hh"
+#include "inc/include.hh"
+#include "util/RedisUtil.hh"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+void usage()
+{
+  cout << "Usage: ./DataTransportTest pktsize pktnum credit port" << endl;
+  cout << "  0. pktsize (size of a packet in bytes)" << endl;
+  cout << "  1. pktnum (number of packets per fetch)" << endl;
+  cout << "  2. credit (packets a peer may send ahead)" << endl;
+  cout << "  3. port (e.g., 7380)" << endl;
+  cout << "Two agents are emulated on 127.0.0.1 and 127.0.0.2 of the loopback," << endl;
+  cout << "with 1 MiB of packets held each, so that publishing waits for the fetches." << endl;
+}
+
+// content of packet i
+char pattern(int i, int j)
+{
+  return (char)(i * 31 + j);
+}
+
+bool sendInt(int fd, int value)
+{
+  int tmp = htonl(value);
+  return send(fd, &tmp, 4, MSG_NOSIGNAL) == 4;
+}
+
+bool recvFull(int fd, char *buf, int len)
+{
+  int hasread = 0;
+  while (hasread < len)
+  {
+    int ret = recv(fd, buf + hasread, len - hasread, 0);
+    if (ret <= 0)
+      return false;
+    hasread += ret;
+  }
+  return true;
+}
+
+// read one |len|data| frame, the length of its data or -1
+int recvPacket(int fd)
+{
+  int len;
+  if (!recvFull(fd, (char *)&len, 4))
+    return -1;
+  len = ntohl(len);
+  vector<char> data(len);
+  return recvFull(fd, data.data(), len) ? len : -1;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 5)
+  {
+    usage();
+    exit(1);
+  }
+
+  int pktsize = atoi(argv[1]);
+  int pktnum = atoi(argv[2]);
+  int credit = atoi(argv[3]);
+  int port = atoi(argv[4]);
+
+  unsigned int ip1 = inet_addr("127.0.0.1");
+  unsigned int ip2 = inet_addr("127.0.0.2");
+  TcpTransport *agent1 = new TcpTransport(ip1, port, credit, 1);
+  TcpTransport *agent2 = new TcpTransport(ip2, port, credit, 1);
+
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+
+  // two fetches of the same keys on agent2 start before agent1 publishes them
+  int fetchnum = 2;
+  vector<int> errors(fetchnum, 0);
+  vector<thread> fetchThreads;
+  for (int f = 0; f < fetchnum; f++)
+  {
+    fetchThreads.push_back(thread([&, f]
+                                  {
+      int i = 0;
+      agent2->fetch(ip1, "stripe0:0", "fetch" + to_string(f), 0, pktnum, [&](OECDataPacket *pkt)
+                    {
+        if (pkt->getDatalen() != pktsize)
+          errors[f]++;
+        else
+        {
+          char *data = pkt->getData();
+          for (int j = 0; j < pktsize; j++)
+            if (data[j] != pattern(i, j))
+            {
+              errors[f]++;
+              break;
+            }
+        }
+        i++;
+        delete pkt; }); }));
+  }
+
+  // each packet is published once for both fetches
+  DataSender *sender = agent1->createSender();
+  for (int i = 0; i < pktnum; i++)
+  {
+    OECDataPacket *pkt = new OECDataPacket(pktsize, false);
+    char *data = pkt->getData();
+    for (int j = 0; j < pktsize; j++)
+      data[j] = pattern(i, j);
+    sender->put("stripe0:0:" + to_string(i), pkt, fetchnum);
+  }
+  sender->flush();
+  delete sender;
+
+  for (int f = 0; f < fetchnum; f++)
+    fetchThreads[f].join();
+
+  gettimeofday(&time2, NULL);
+  double duration = RedisUtil::duration(time1, time2);
+
+  // the connections are idle now and reused by the next fetch in reverse direction
+  int reverse = 0;
+  sender = agent2->createSender();
+  sender->put("stripe1:0:0", new OECDataPacket(pktsize), 1);
+  delete sender;
+  agent1->fetch(ip2, "stripe1:0", "reverse", 0, 1, [&](OECDataPacket *pkt)
+                { reverse += pkt->getDatalen() == pktsize ? 0 : 1;
+                  delete pkt; });
+
+  // packets start to num-1 of keybase with pktsize + i bytes, published
+  // while fetched as publishing waits for the fetches
+  auto publish = [&](string keybase, int start, int num)
+  {
+    return thread([=]
+                  {
+      DataSender *sender = agent1->createSender();
+      for (int i = start; i < num; i++)
+        sender->put(keybase + ":" + to_string(i), new OECDataPacket(pktsize + i), 1);
+      delete sender; });
+  };
+
+  // a fetch resumes in the middle of the keys
+  int resumed = 0;
+  thread publishThread = publish("stripe2:0", 1, 3);
+  int next = 1;
+  agent2->fetch(ip1, "stripe2:0", "resumed", 1, 3, [&](OECDataPacket *pkt)
+                { resumed += pkt->getDatalen() == pktsize + next ? 0 : 1;
+                  next++;
+                  delete pkt; });
+  resumed += next == 3 ? 0 : 1;
+  publishThread.join();
+
+  // a peer that is down fails the fetch instead of the agent
+  int down = agent1->fetch(inet_addr("127.0.0.3"), "stripe3:0", "down", 0, 1, [&](OECDataPacket *pkt)
+                           { delete pkt; })
+                 ? 1
+                 : 0;
+
+  // a connection breaks with packets sent and not acknowledged: the fetch
+  // acknowledges packet 0, delivers packet 1 and resumes at packet 2, which
+  // agent1 sends again
+  int broken = 0;
+  publishThread = publish("stripe4:0", 0, 4);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = ip1;
+  string keybase = "stripe4:0", fetchid = "broken";
+  bool sent = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+              sendInt(fd, TCPTRANSPORT_FETCH) && sendInt(fd, 0) && sendInt(fd, 4) && sendInt(fd, 2) &&
+              sendInt(fd, keybase.size()) && send(fd, keybase.c_str(), keybase.size(), MSG_NOSIGNAL) == (int)keybase.size() &&
+              sendInt(fd, fetchid.size()) && send(fd, fetchid.c_str(), fetchid.size(), MSG_NOSIGNAL) == (int)fetchid.size();
+  broken += sent && recvPacket(fd) == pktsize && sendInt(fd, TCPTRANSPORT_CREDIT) && sendInt(fd, 1) &&
+                    recvPacket(fd) == pktsize + 1
+                ? 0
+                : 1;
+  close(fd);
+  next = 2;
+  agent2->fetch(ip1, keybase, fetchid, 2, 4, [&](OECDataPacket *pkt)
+                { broken += pkt->getDatalen() == pktsize + next ? 0 : 1;
+                  next++;
+                  delete pkt; });
+  broken += next == 4 ? 0 : 1;
+  publishThread.join();
+
+  int errnum = reverse + resumed + down + broken;
+  for (int f = 0; f < fetchnum; f++)
+    errnum += errors[f];
+  cout << "DataTransportTest: " << fetchnum * pktnum << " packets in " << duration << " ms, "
+       << (double)fetchnum * pktnum * pktsize / 1048576 / (duration / 1000) << " MiB/s, " << errnum << " errors" << endl;
+  return errnum == 0 ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include "common/Config.hh"
+#include "ec/ECBase.hh"
+#include "ec/ECDAG.hh"
+#include "ec/ECPolicy.hh"
+#include "inc/include.hh"
+#include "util/RedisUtil.hh"
+
+#include <atomic>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+// allocations made while counting is set, to report the allocations of each stage;
+// the replaced operator new only counts inside plan
+static atomic<long> allocnum(0);
+static atomic<bool> counting(false);
+
+void *operator new(size_t size)
+{
+  if (counting.load(memory_order_relaxed))
+    allocnum++;
+  void *ptr = malloc(size);
+  if (!ptr)
+    throw bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void usage()
+{
+  cout << "Usage: ./ECDAGBenchmark iterations [ecid ...]" << endl;
+  cout << "  0. iterations (number of plans per failure case)" << endl;
+  cout << "  1. ecid (policies in conf/sysSetting.xml to run, all of them by default)" << endl;
+  cout << "Prints one csv line per policy, operation (repair or maintenance), failed block and stage." << endl;
+}
+
+const vector<string> stages = {"decode", "reconstruct", "toposort", "candidates", "optimize2", "parseForOEC", "persist", "plan"};
+
+struct StageStats
+{
+  vector<double> _durations;
+  long _allocs = 0;
+};
+
+double percentile(vector<double> durations, double p)
+{
+  sort(durations.begin(), durations.end());
+  int idx = (int)(p * (durations.size() - 1) + 0.5);
+  return durations[idx];
+}
+
+unsigned int synthIp(int rack, int node)
+{
+  string ip = "10.0." + to_string(rack) + "." + to_string(node + 1);
+  return inet_addr(ip.c_str());
+}
+
+// plan the repair of lostidx once, adding the time and allocations of each stage to stats;
+// under maintenance the rack of lostidx is out, and the code decodes the way the
+// coordinator does then
+void plan(ECPolicy *ecpolicy, int lostidx, bool undermaintenance, int pktnum, vector<StageStats> &stats)
+{
+  bool maintenance = ecpolicy->isMaintenance() ||
+                     (undermaintenance && ecpolicy->getApproachIdx() >= 0 && lostidx < ecpolicy->getK());
+  counting = true;
+  ECBase *ec = ecpolicy->createECClass(maintenance);
+  int ecn = ecpolicy->getN();
+  int eck = ecpolicy->getK();
+  int ecw = ecpolicy->getW();
+  int opt = ecpolicy->getOpt();
+
+  // synthetic rack map: each group of the code in a rack of its own, a node per block
+  vector<vector<int>> group;
+  ec->Place(group);
+  vector<int> sid2rack(ecn, group.size());
+  for (int gp_id = 0; gp_id < group.size(); gp_id++)
+  {
+    for (auto bid : group[gp_id])
+      sid2rack[bid] = gp_id;
+  }
+  unordered_map<unsigned int, string> ip2Rack;
+  unordered_map<int, unsigned int> sid2ip;
+  unordered_map<int, pair<string, unsigned int>> objlist;
+  vector<unsigned int> allIps;
+  vector<int> integrity(ecn, 1);
+  integrity[lostidx] = 0;
+  if (maintenance)
+  {
+    for (int i = 0; i < ecn; i++)
+    {
+      if (sid2rack[i] == sid2rack[lostidx])
+        integrity[i] = 0;
+    }
+  }
+  for (int sid = 0; sid < ecn; sid++)
+  {
+    int rack = sid2rack[sid];
+    unsigned int ip = synthIp(rack, sid);
+    ip2Rack.insert(make_pair(ip, "rack" + to_string(rack)));
+    allIps.push_back(ip);
+    // the lost block is rebuilt on a new node in its rack, or out of the rack under maintenance
+    if (sid == lostidx)
+    {
+      rack = undermaintenance ? group.size() + 1 : rack;
+      ip = synthIp(rack, ecn);
+      ip2Rack.insert(make_pair(ip, "rack" + to_string(rack)));
+      allIps.push_back(ip);
+    }
+    sid2ip.insert(make_pair(sid, ip));
+    objlist.insert(make_pair(sid, make_pair("benchobj" + to_string(sid), ip)));
+  }
+
+  vector<int> availcidx;
+  vector<int> toreccidx;
+  for (int i = 0; i < ecn; i++)
+  {
+    for (int j = 0; j < ecw; j++)
+    {
+      if (i == lostidx)
+        toreccidx.push_back(i * ecw + j);
+      else if (integrity[i] == 1)
+        availcidx.push_back(i * ecw + j);
+    }
+  }
+
+  struct timeval time1, time2, time3;
+  long allocs1, allocs2;
+  auto begin = [&]()
+  {
+    allocs1 = allocnum;
+    gettimeofday(&time1, NULL);
+  };
+  auto end = [&](int stage)
+  {
+    gettimeofday(&time2, NULL);
+    allocs2 = allocnum;
+    stats[stage]._durations.push_back(RedisUtil::duration(time1, time2));
+    stats[stage]._allocs += allocs2 - allocs1;
+  };
+
+  long allocs0 = allocnum;
+  struct timeval time0;
+  gettimeofday(&time0, NULL);
+
+  begin();
+  ECDAG *ecdag = ec->Decode(availcidx, toreccidx);
+  end(0);
+
+  begin();
+  ecdag->reconstruct(opt);
+  end(1);
+
+  begin();
+  vector<int> toposeq = ecdag->toposort();
+  end(2);
+
+  begin();
+  unordered_map<int, unsigned int> cid2ip;
+  for (int i = 0; i < toposeq.size(); i++)
+  {
+    int cidx = toposeq[i];
+    vector<unsigned int> candidates = ecdag->getNode(cidx)->candidateIps(sid2ip, cid2ip, allIps, ecn, eck, ecw, 1);
+    cid2ip.insert(make_pair(cidx, candidates[0]));
+  }
+  end(3);
+
+  begin();
+  ecdag->optimize2(opt, cid2ip, ip2Rack, ecn, eck, ecw, sid2ip, allIps, 1);
+  end(4);
+
+  begin();
+  unordered_map<int, AGCommand *> agCmds = ecdag->parseForOEC(cid2ip, "benchstripe", ecn, eck, ecw, pktnum, objlist);
+  end(5);
+
+  begin();
+  vector<AGCommand *> persistCmds = ecdag->persist(cid2ip, "benchstripe", ecn, eck, ecw, pktnum, objlist);
+  end(6);
+
+  gettimeofday(&time3, NULL);
+  stats[7]._durations.push_back(RedisUtil::duration(time0, time3));
+  stats[7]._allocs += allocnum - allocs0;
+
+  for (auto item : agCmds)
+    if (item.second)
+      delete item.second;
+  for (auto item : persistCmds)
+    delete item;
+  delete ecdag;
+  delete ec;
+  counting = false;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    usage();
+    exit(1);
+  }
+
+  int iterations = max(atoi(argv[1]), 1);
+  string confpath = "conf/sysSetting.xml";
+  Config *conf = new Config(confpath);
+
+  vector<string> ecids;
+  for (int i = 2; i < argc; i++)
+  {
+    string ecid = string(argv[i]);
+    if (conf->_ecPolicyMap.find(ecid) == conf->_ecPolicyMap.end())
+    {
+      cerr << "ECDAGBenchmark: unknown ecid " << ecid << endl;
+      usage();
+      exit(1);
+    }
+    ecids.push_back(ecid);
+  }
+  if (ecids.empty())
+  {
+    for (auto item : conf->_ecPolicyMap)
+      ecids.push_back(item.first);
+    sort(ecids.begin(), ecids.end());
+  }
+  int pktnum = 64 * 1048576 / conf->_pktSize;
+
+  // planning prints a lot, keep it out of the csv
+  stringstream csv;
+  csv << "ecid,operation,failed_idx,stage,iterations,p50_ms,p90_ms,p99_ms,max_ms,allocs_per_plan" << endl;
+  cout.flush();
+  int stdoutfd = dup(STDOUT_FILENO);
+  int nullfd = open("/dev/null", O_WRONLY);
+  dup2(nullfd, STDOUT_FILENO);
+  for (auto ecid : ecids)
+  {
+    ECPolicy *ecpolicy = conf->_ecPolicyMap[ecid];
+    for (bool undermaintenance : {false, true})
+    {
+      for (int lostidx = 0; lostidx < ecpolicy->getN(); lostidx++)
+      {
+        vector<StageStats> stats(stages.size());
+        for (int i = 0; i < iterations; i++)
+          plan(ecpolicy, lostidx, undermaintenance, pktnum, stats);
+        for (int s = 0; s < stages.size(); s++)
+        {
+          csv << ecid << "," << (undermaintenance ? "maintenance" : "repair") << "," << lostidx << "," << stages[s] << ","
+              << iterations << "," << percentile(stats[s]._durations, 0.5) << "," << percentile(stats[s]._durations, 0.9) << ","
+              << percentile(stats[s]._durations, 0.99) << "," << percentile(stats[s]._durations, 1.0) << ","
+              << stats[s]._allocs / iterations << endl;
+        }
+      }
+    }
+  }
+  cout.flush();
+  fflush(stdout);
+  dup2(stdoutfd, STDOUT_FILENO);
+  close(nullfd);
+  cout << csv.str();
+  return 0;
+}
@@ -15,6 +15,9 @@ void usage()
   cout << "       ./OECClient read filename saveas" << endl;
   cout << "       ./OECClient startEncode" << endl;
   cout << "       ./OECClient startRepair" << endl;
+  cout << "       ./OECClient batchRepair ip|rack" << endl;
+  cout << "       ./OECClient maintenance rack seconds" << endl;
+  cout << "       ./OECClient migrate ecpoolid ecid" << endl;
   cout << "       ./OECClient coorBench id number" << endl;
   cout << "       ./OECClient hdfsmeta" << endl;
 }
@@ -153,6 +156,77 @@ int main(int argc, char **argv)
     delete cmd;
     delete conf;
   }
+  else if (reqType == "batchRepair")
+  {
+    if (argc != 3)
+    {
+      usage();
+      return -1;
+    }
+    string failed(argv[2]);
+    string confpath("./conf/sysSetting.xml");
+    Config *conf = new Config(confpath);
+    struct timeval time1, time2;
+    gettimeofday(&time1, NULL);
+    // repair all blocks of a failed node or rack and wait for the coordinator
+    CoorCommand *cmd = new CoorCommand();
+    cmd->buildType13(13, conf->_localIp, failed);
+    cmd->sendTo(conf->_coorIp);
+
+    redisContext *waitCtx = RedisUtil::createContext(conf->_localIp);
+    string wkey = "batchrepaired:" + failed;
+    redisReply *rReply = (redisReply *)redisCommand(waitCtx, "blpop %s 0", wkey.c_str());
+    int repaired;
+    memcpy((char *)&repaired, rReply->element[1]->str, 4);
+    repaired = ntohl(repaired);
+    freeReplyObject(rReply);
+    redisFree(waitCtx);
+    gettimeofday(&time2, NULL);
+    cout << "batchRepair.repaired " << repaired << " objs, duration: " << RedisUtil::duration(time1, time2) << endl;
+
+    delete cmd;
+    delete conf;
+  }
+  else if (reqType == "maintenance")
+  {
+    if (argc != 4)
+    {
+      usage();
+      return -1;
+    }
+    string rack(argv[2]);
+    int seconds = atoi(argv[3]);
+    string confpath("./conf/sysSetting.xml");
+    Config *conf = new Config(confpath);
+    // open a maintenance window on rack, 0 seconds closes it
+    CoorCommand *cmd = new CoorCommand();
+    cmd->buildType14(14, conf->_localIp, rack, seconds);
+    cmd->sendTo(conf->_coorIp);
+    cout << "maintenance.rack " << rack << " for " << seconds << " seconds" << endl;
+
+    delete cmd;
+    delete conf;
+  }
+  else if (reqType == "migrate")
+  {
+    if (argc != 4)
+    {
+      usage();
+      return -1;
+    }
+    string ecpoolid(argv[2]);
+    string ecid(argv[3]);
+    string confpath("./conf/sysSetting.xml");
+    Config *conf = new Config(confpath);
+    // the coordinator migrates the pool in the background
+    CoorCommand *cmd = new CoorCommand();
+    cmd->buildType15(15, conf->_localIp, ecpoolid, ecid);
+    cmd->sendTo(conf->_coorIp);
+    cout << "migrate.pool " << ecpoolid << " to " << ecid << endl;
+
+    delete cmd;
+    delete conf;
+  }
   else if (reqType == "coorBench")
   {
     if (argc != 4)
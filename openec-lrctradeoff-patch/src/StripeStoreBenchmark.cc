@@ -0,0 +1,192 @@
+#include "common/Config.hh"
+#include "common/SSEntry.hh"
+#include "common/StripeStore.hh"
+#include "inc/include.hh"
+#include "util/RedisUtil.hh"
+
+#include <atomic>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+void usage()
+{
+  cout << "Usage: ./StripeStoreBenchmark entries seconds [threads ...]" << endl;
+  cout << "  0. entries (number of synthetic files, each of one obj)" << endl;
+  cout << "  1. seconds (duration of each run)" << endl;
+  cout << "  2. threads (thread counts to run, 1 2 4 8 16 by default)" << endl;
+  cout << "Prints one csv line per index and thread count." << endl;
+}
+
+// the single-mutex maps the stripe store used before, as the baseline
+class MutexIndex
+{
+private:
+  unordered_map<string, SSEntry *> _entryMap;
+  mutex _lockEntryMap;
+  unordered_map<string, SSEntry *> _objMap;
+  mutex _lockObjMap;
+  unordered_map<unsigned int, int> _loadMap;
+  mutex _lockLoadMap;
+
+public:
+  void insertEntry(SSEntry *entry)
+  {
+    _entryMap.insert(make_pair(entry->getFilename(), entry));
+    for (auto obj : entry->getObjlist())
+      _objMap.insert(make_pair(obj, entry));
+  }
+
+  SSEntry *getEntry(string filename)
+  {
+    lock_guard<mutex> lck(_lockEntryMap);
+    unordered_map<string, SSEntry *>::iterator it = _entryMap.find(filename);
+    return it == _entryMap.end() ? NULL : it->second;
+  }
+
+  SSEntry *getEntryFromObj(string objname)
+  {
+    lock_guard<mutex> lck(_lockObjMap);
+    unordered_map<string, SSEntry *>::iterator it = _objMap.find(objname);
+    return it == _objMap.end() ? NULL : it->second;
+  }
+
+  int getDataLoad(unsigned int ip)
+  {
+    lock_guard<mutex> lck(_lockLoadMap);
+    return _loadMap[ip];
+  }
+
+  void increaseDataLoadMap(unsigned int ip, int load)
+  {
+    lock_guard<mutex> lck(_lockLoadMap);
+    _loadMap[ip] += load;
+  }
+};
+
+string filenameOf(int i)
+{
+  return "/bench-" + to_string(i);
+}
+
+string objnameOf(int i)
+{
+  return "/bench-" + to_string(i) + "_oecobj_0";
+}
+
+// each op looks up a file, looks up an obj, and picks the least loaded of two agents, as chooseFromCandidates does
+template <class Index>
+void lookupLoop(Index *index, Config *conf, int entries, atomic<bool> *stop, long *ops)
+{
+  unsigned int seed = (unsigned int)(long)ops;
+  vector<unsigned int> &ips = conf->_agentsIPs;
+  long done = 0;
+  while (!stop->load(memory_order_relaxed))
+  {
+    int i = rand_r(&seed) % entries;
+    SSEntry *entry = index->getEntry(filenameOf(i));
+    SSEntry *objentry = index->getEntryFromObj(objnameOf(i));
+    if (entry == NULL || objentry != entry)
+    {
+      cerr << "StripeStoreBenchmark::lookup of " << filenameOf(i) << " fails" << endl;
+      exit(1);
+    }
+    unsigned int ip1 = ips[rand_r(&seed) % ips.size()];
+    unsigned int ip2 = ips[rand_r(&seed) % ips.size()];
+    unsigned int minip = index->getDataLoad(ip1) <= index->getDataLoad(ip2) ? ip1 : ip2;
+    index->increaseDataLoadMap(minip, 1);
+    done++;
+  }
+  *ops = done;
+}
+
+// lookups per second of threadnum threads in seconds
+template <class Index>
+double run(Index *index, Config *conf, int entries, int threadnum, double seconds)
+{
+  atomic<bool> stop(false);
+  vector<long> ops(threadnum, 0);
+  vector<thread> threads;
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  for (int i = 0; i < threadnum; i++)
+    threads.push_back(thread(lookupLoop<Index>, index, conf, entries, &stop, &ops[i]));
+  usleep((long)(seconds * 1000000));
+  stop = true;
+  for (int i = 0; i < threadnum; i++)
+    threads[i].join();
+  gettimeofday(&time2, NULL);
+  long total = 0;
+  for (auto item : ops)
+    total += item;
+  return total / (RedisUtil::duration(time1, time2) / 1000);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    usage();
+    exit(1);
+  }
+
+  int entries = max(atoi(argv[1]), 1);
+  double seconds = atof(argv[2]);
+  vector<int> threadnums;
+  for (int i = 3; i < argc; i++)
+    threadnums.push_back(max(atoi(argv[i]), 1));
+  if (threadnums.empty())
+    threadnums = {1, 2, 4, 8, 16};
+
+  string confpath = "conf/sysSetting.xml";
+  Config *conf = new Config(confpath);
+  if (conf->_agentsIPs.empty())
+  {
+    cerr << "StripeStoreBenchmark::no agents in " << confpath << endl;
+    exit(1);
+  }
+
+  // the stripe store opens its metadata log in the working directory, keep it away from a coordinator's
+  char tmpdir[] = "/tmp/StripeStoreBenchmark.XXXXXX";
+  if (mkdtemp(tmpdir) == NULL || chdir(tmpdir) != 0)
+  {
+    cerr << "StripeStoreBenchmark::cannot work in " << tmpdir << endl;
+    exit(1);
+  }
+  StripeStore *stripeStore = new StripeStore(conf);
+  MutexIndex *mutexIndex = new MutexIndex();
+  for (int i = 0; i < entries; i++)
+  {
+    unsigned int loc = conf->_agentsIPs[i % conf->_agentsIPs.size()];
+    SSEntry *entry = new SSEntry(filenameOf(i), 0, 1, "bench_pool", {objnameOf(i)}, {loc});
+    stripeStore->insertEntry(entry);
+    mutexIndex->insertEntry(entry);
+  }
+
+  stringstream csv;
+  csv << "index,threads,entries,lookups_per_sec,speedup" << endl;
+  double stripeStoreBase = 0, mutexBase = 0;
+  for (auto threadnum : threadnums)
+  {
+    double throughput = run(stripeStore, conf, entries, threadnum, seconds);
+    if (stripeStoreBase == 0)
+      stripeStoreBase = throughput;
+    csv << "StripeStore," << threadnum << "," << entries << "," << (long)throughput << ","
+        << throughput / stripeStoreBase << endl;
+    throughput = run(mutexIndex, conf, entries, threadnum, seconds);
+    if (mutexBase == 0)
+      mutexBase = throughput;
+    csv << "MutexIndex," << threadnum << "," << entries << "," << (long)throughput << "," << throughput / mutexBase
+        << endl;
+  }
+  cout << csv.str();
+
+  unlink("metaLog");
+  unlink("metaSnapshot");
+  chdir("/");
+  rmdir(tmpdir);
+  return 0;
+}
@@ -0,0 +1,109 @@
+#ifndef _BLOCKINGQUEUE_HH_
+#define _BLOCKINGQUEUE_HH_
+
+#include "QueueStats.hh"
+#include "TaskPool.hh"
+
+#include "../inc/include.hh"
+
+#include <condition_variable>
+#include <queue>
+
+using namespace std;
+
+/**
+ * Queue between two stages of a pipeline.
+ *
+ * With a capacity, push blocks while the queue is full, so a fast producer
+ * never runs more than capacity items ahead of its consumer. A capacity of 0
+ * leaves the queue unbounded. The largest length reached is kept as the
+ * high-water mark and reported under the stage name, if any, when the queue
+ * is deleted.
+ */
+template <class T>
+class BlockingQueue {
+  private:
+    queue<T> _queue;
+    mutex _mutex;
+    condition_variable _notEmpty;
+    condition_variable _notFull;
+    int _capacity;
+    int _highWater;
+    bool _released;
+    string _stage;
+
+  public:
+    BlockingQueue(int capacity = 0, string stage = "") {
+      _capacity = capacity;
+      _highWater = 0;
+      _released = false;
+      _stage = stage;
+    }
+
+    ~BlockingQueue() {
+      if (!_stage.empty()) QueueStats::record(_stage, _highWater, _capacity);
+    }
+
+    void push(T item) {
+      unique_lock<mutex> lck(_mutex);
+      if (_capacity > 0 && !_released && _queue.size() >= _capacity) {
+        // let another worker of the pool run while we wait for the consumer
+        TaskPool::beginBlocking();
+        while (_capacity > 0 && !_released && _queue.size() >= _capacity) _notFull.wait(lck);
+        TaskPool::endBlocking();
+      }
+      _queue.push(item);
+      if (!_released && _queue.size() > _highWater) _highWater = _queue.size();
+      _notEmpty.notify_one();
+    }
+
+    T pop() {
+      unique_lock<mutex> lck(_mutex);
+      if (_queue.empty()) {
+        TaskPool::beginBlocking();
+        while (_queue.empty()) _notEmpty.wait(lck);
+        TaskPool::endBlocking();
+      }
+      T item = _queue.front();
+      _queue.pop();
+      if (_capacity > 0) _notFull.notify_one();
+      return item;
+    }
+
+    int getSize() {
+      unique_lock<mutex> lck(_mutex);
+      return _queue.size();
+    }
+
+    void clear() {
+      unique_lock<mutex> lck(_mutex);
+      while (!_queue.empty()) _queue.pop();
+      _notFull.notify_all();
+    }
+
+    // 0 for unbounded
+    void setCapacity(int capacity) {
+      unique_lock<mutex> lck(_mutex);
+      _capacity = capacity;
+      _notFull.notify_all();
+    }
+
+    // lift the bound for a producer that goes on past the items its consumer
+    // takes, those items are not counted in the high-water mark
+    void release() {
+      unique_lock<mutex> lck(_mutex);
+      _released = true;
+      _notFull.notify_all();
+    }
+
+    int getCapacity() {
+      return _capacity;
+    }
+
+    int getHighWater() {
+      unique_lock<mutex> lck(_mutex);
+      return _highWater;
+    }
+};
+
+#endif
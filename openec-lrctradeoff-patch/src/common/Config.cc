@@ -34,14 +34,68 @@ Config::Config(std::string& filepath) {
       _agWorkerThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "oec.controller.thread.num") {
       _coorThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.controller.background.thread.num") {
+      _coorBackgroundThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "oec.cmddist.thread.num") {
       _distThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "ec.concurrent.num") {
       _ec_concurrent = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.compute.tile.size") {
+      _computeTileSize = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.compute.thread.num") {
+      _computeThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "local.addr") {
       _localIp = inet_addr(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "packet.size") {
       _pktSize = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "packet.pool.size") {
+      _pktPoolSizeMB = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "packet.pool.hugepage") {
+      std::string hugepage = ele -> NextSiblingElement("value") -> GetText();
+      if (hugepage == "true") _pktPoolHugepage = true;
+      else _pktPoolHugepage = false;
+    } else if (attName == "oec.data.transport") {
+      _dataTransport = ele -> NextSiblingElement("value") -> GetText();
+    } else if (attName == "oec.data.port") {
+      _dataPort = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.data.credit") {
+      _dataCredit = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.data.store.size") {
+      _dataStoreMB = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.client.shm") {
+      std::string shm = ele -> NextSiblingElement("value") -> GetText();
+      if (shm == "true") _clientShm = true;
+      else _clientShm = false;
+    } else if (attName == "oec.client.shm.slots") {
+      _clientShmSlots = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.queue.depth.load") {
+      _loadQueueDepth = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.queue.depth.read") {
+      _readQueueDepth = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.queue.depth.fetch") {
+      _fetchQueueDepth = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.queue.depth.write") {
+      _writeQueueDepth = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.task.thread.num") {
+      _taskThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.task.io.thread.num") {
+      _taskIOThreadNum = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.stats.interval") {
+      _statsIntervalSec = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.plan.cache.size") {
+      _planCacheSize = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.link.crossrack.mbps") {
+      _crossRackMbps = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.link.window.ms") {
+      _linkWindowMs = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.metalog.fsync") {
+      _metaLogFsync = ele -> NextSiblingElement("value") -> GetText();
+    } else if (attName == "oec.metalog.fsync.ms") {
+      _metaLogFsyncMs = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.metalog.snapshot.mb") {
+      _metaLogSnapshotMB = std::stoi(ele -> NextSiblingElement("value") -> GetText());
+    } else if (attName == "oec.migration.mbps") {
+      _migrationMbps = std::stoi(ele -> NextSiblingElement("value") -> GetText());
     } else if (attName == "dss.type") {
       _fsType = ele->NextSiblingElement("value")->GetText();
 //    } else if (attName == "control.policy") {
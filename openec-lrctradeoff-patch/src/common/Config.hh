@@ -0,0 +1,97 @@
+#ifndef _CONFIG_HH_
+#define _CONFIG_HH_
+
+#include "../inc/include.hh"
+#include "../ec/ECPolicy.hh"
+#include "../util/tinyxml2.h"
+
+using namespace tinyxml2;
+
+class Config {
+  public:
+    Config(std::string& filepath);
+    ~Config();
+
+    // controller & agents
+    unsigned int _coorIp;
+    unsigned int _localIp;
+    std::vector<unsigned int> _agentsIPs;
+    std::unordered_map<unsigned int, std::string> _ip2Rack;
+    std::unordered_map<std::string, std::vector<unsigned int>> _rack2Ips;
+
+    int _agWorkerThreadNum;
+    int _coorThreadNum;
+    int _distThreadNum;
+    int _ec_concurrent;
+    // coordinator threads for encodings, repairs and migrations, 0 for twice ec.concurrent.num
+    int _coorBackgroundThreadNum = 0;
+
+    // data packet
+    int _pktSize;
+    int _pktPoolSizeMB = 1024;
+    bool _pktPoolHugepage = false;
+
+    // data plane between agents
+    std::string _dataTransport = "redis";
+    int _dataPort = 7380;
+    int _dataCredit = 8;
+    int _dataStoreMB = 256;
+
+    // shared-memory ring between a client and its local agent
+    bool _clientShm = true;
+    int _clientShmSlots = 32;
+
+    // packets buffered between pipeline stages of an agent, 0 for unbounded
+    int _loadQueueDepth = 16;
+    int _readQueueDepth = 16;
+    int _fetchQueueDepth = 16;
+    int _writeQueueDepth = 16;
+
+    // threads that run the stages of agent commands, 0 for the number of cores
+    int _taskThreadNum = 0;
+    int _taskIOThreadNum = 64;
+
+    // seconds between dumps of the agent buffer and thread stats, 0 disables them
+    int _statsIntervalSec = 0;
+
+    // repair plans cached by the coordinator, 0 disables the cache
+    int _planCacheSize = 1024;
+
+    // cross-rack links, a repair waits while it would put more than the window of transfer on one
+    int _crossRackMbps = 1000;
+    int _linkWindowMs = 2000;
+
+    // metadata log of the stripe store: always, interval or none
+    std::string _metaLogFsync = "interval";
+    int _metaLogFsyncMs = 100;
+    int _metaLogSnapshotMB = 64;
+
+    // placement migration moves blocks at most at this rate
+    int _migrationMbps = 200;
+
+    // compute
+    int _computeTileSize = 32768;
+    int _computeThreadNum = 1;
+
+    // dss
+    std::string _fsType;
+    std::vector<std::string> _fsParam;
+    std::unordered_map<std::string, std::vector<std::string>> _fsFactory;
+
+    // ec
+    std::unordered_map<std::string, ECPolicy*> _ecPolicyMap;
+    std::unordered_map<std::string, std::string> _offlineECMap;
+    std::unordered_map<std::string, int> _offlineECBase;
+
+    // policies
+    bool _avoid_local;
+    std::string _control_policy;
+    std::string _data_policy;
+    std::string _encode_scheduling;
+    std::string _encode_policy;
+    std::string _repair_scheduling;
+    std::string _repair_policy;
+    int _repair_threshold;
+};
+
+#endif
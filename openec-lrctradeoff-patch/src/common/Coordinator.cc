@@ -15,15 +15,37 @@ Coordinator::Coordinator(Config *conf, StripeStore *ss) : _conf(conf)
   _stripeStore = ss;
   _underfs = FSUtil::createFS(_conf->_fsType, _conf->_fsFactory[_conf->_fsType], _conf);
   srand((unsigned)time(0));
+  // galois tables are built on first use, build them before the workers plan at once
+  galois_single_multiply(1, 1, 8);
+  galois_single_divide(1, 1, 8);
+  _planCache = new PlanCache(_conf->_planCacheSize);
+  _linkScheduler = new LinkScheduler(_conf);
+  _migrator = new PlacementMigrator(_conf, _stripeStore, _linkScheduler);
+  _migrator->resume();
+  _delayNum = 0;
+  _delaySum = 0;
+  _delayMax = 0;
 }
 
 Coordinator::~Coordinator()
 {
   redisFree(_localCtx);
+  delete _planCache;
+  delete _migrator;
+  delete _linkScheduler;
 }
 
 void Coordinator::doProcess()
 {
+  for (int i = 0; i < _conf->_coorThreadNum; i++)
+    _workers.push_back(thread([=]
+                              { workerLoop(&_requestQueue); }));
+  // room for the encodings and the repairs that the stripe store runs at once
+  int backgroundNum = _conf->_coorBackgroundThreadNum > 0 ? _conf->_coorBackgroundThreadNum : 2 * max(_conf->_ec_concurrent, 1);
+  for (int i = 0; i < backgroundNum; i++)
+    _workers.push_back(thread([=]
+                              { workerLoop(&_backgroundQueue); }));
+
   redisReply *rReply;
   while (true)
   {
@@ -43,63 +65,113 @@ void Coordinator::doProcess()
       cout << "Coordinator::doProcess() receive a request!" << endl;
       char *reqStr = rReply->element[1]->str;
       CoorCommand *coorCmd = new CoorCommand(reqStr);
-      coorCmd->dump();
-      int type = coorCmd->getType();
-      switch (type)
-      {
-      case 0:
-        registerFile(coorCmd);
-        break;
-      case 1:
-        getLocation(coorCmd);
-        break;
-      case 2:
-        finalizeFile(coorCmd);
-        break;
-      case 3:
-        getFileMeta(coorCmd);
-        break;
-      case 4:
-        offlineEnc(coorCmd);
-        break;
-      case 5:
-        offlineDegradedInst(coorCmd);
-        break;
-      case 6:
-        reportLost(coorCmd);
-        break;
-      case 7:
-        setECStatus(coorCmd);
-        break;
-      case 8:
-        repairReqFromSS(coorCmd);
-        break;
-      case 9:
-        onlineDegradedInst(coorCmd);
-        break;
-      case 11:
-        reportRepaired(coorCmd);
-        break;
-      case 12:
-        coorBenchmark(coorCmd);
-        break;
-      case 21:
-        getHDFSMeta(coorCmd);
-        break;
-      case 22:
-        offlineDegradedET(coorCmd);
-        break;
-
-      default:
-        break;
-      }
-      delete coorCmd;
+      struct timeval arrival;
+      gettimeofday(&arrival, NULL);
+      if (isBackground(coorCmd->getType()))
+        _backgroundQueue.push(make_pair(coorCmd, arrival));
+      else
+        _requestQueue.push(make_pair(coorCmd, arrival));
     }
     // free reply object
     freeReplyObject(rReply);
   }
 }
 
+bool Coordinator::isBackground(int type)
+{
+  // offline encoding, repair, batch repair and migration
+  return type == 4 || type == 8 || type == 13 || type == 15;
+}
+
+void Coordinator::workerLoop(BlockingQueue<pair<CoorCommand *, struct timeval>> *queue)
+{
+  while (true)
+  {
+    pair<CoorCommand *, struct timeval> request = queue->pop();
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    recordDelay(RedisUtil::duration(request.second, start));
+
+    CoorCommand *coorCmd = request.first;
+    coorCmd->dump();
+    handleCommand(coorCmd);
+    delete coorCmd;
+  }
+}
+
+void Coordinator::recordDelay(double delay)
+{
+  unique_lock<mutex> lck(_lockDelay);
+  _delayNum++;
+  _delaySum += delay;
+  if (delay > _delayMax)
+    _delayMax = delay;
+  cout << "Coordinator::queueing delay = " << delay << " ms, avg " << _delaySum / _delayNum
+       << " ms, max " << _delayMax << " ms over " << _delayNum << " requests" << endl;
+}
+
+void Coordinator::handleCommand(CoorCommand *coorCmd)
+{
+  int type = coorCmd->getType();
+  switch (type)
+  {
+  case 0:
+    registerFile(coorCmd);
+    break;
+  case 1:
+    getLocation(coorCmd);
+    break;
+  case 2:
+    finalizeFile(coorCmd);
+    break;
+  case 3:
+    getFileMeta(coorCmd);
+    break;
+  case 4:
+    offlineEnc(coorCmd);
+    break;
+  case 5:
+    offlineDegradedInst(coorCmd);
+    break;
+  case 6:
+    reportLost(coorCmd);
+    break;
+  case 7:
+    setECStatus(coorCmd);
+    break;
+  case 8:
+    repairReqFromSS(coorCmd);
+    break;
+  case 9:
+    onlineDegradedInst(coorCmd);
+    break;
+  case 11:
+    reportRepaired(coorCmd);
+    break;
+  case 12:
+    coorBenchmark(coorCmd);
+    break;
+  case 13:
+    batchRecovery(coorCmd);
+    break;
+  case 14:
+    setMaintenance(coorCmd);
+    break;
+  case 15:
+    migratePool(coorCmd);
+    break;
+  case 21:
+    getHDFSMeta(coorCmd);
+    break;
+  case 22:
+    offlineDegradedET(coorCmd);
+    break;
+
+  default:
+    break;
+  }
+}
+
 void Coordinator::registerFile(CoorCommand *coorCmd)
 {
   unsigned int clientIp = coorCmd->getClientip();
@@ -203,9 +275,8 @@ void Coordinator::registerOnlineEC(unsigned int clientIp, string filename, strin
     printf("add obj %d for poolstore, size: %ld\n", i, ecpool->getStripeObjList(stripename).size());
   }
 
-  _stripeStore->backupPoolStripe(ecpool->stripe2String(stripename));
-
   ecpool->unlock();
+  _stripeStore->backupPoolStripe(ecpool, stripename);
 
   // (2) add ssentry of each object (0 - n - 1)
   int objSizeMB = filesizeMB / eck;
@@ -216,7 +287,7 @@ void Coordinator::registerOnlineEC(unsigned int clientIp, string filename, strin
     _stripeStore->insertEntry(objssentry);
     objssentry->dump();
 
-    _stripeStore->backupEntry(objssentry->toString());
+    _stripeStore->backupEntry(objssentry);
   }
 
   // after this, we have a **fake record** that this file is "offline encoded
@@ -615,7 +686,7 @@ void Coordinator::finalizeFile(CoorCommand *coorCmd)
   }
 
   // backup this ssentry
-  _stripeStore->backupEntry(ssentry->toString());
+  _stripeStore->backupEntry(ssentry);
 }
 
 void Coordinator::offlineEnc(CoorCommand *coorCmd)
@@ -626,8 +697,15 @@ void Coordinator::offlineEnc(CoorCommand *coorCmd)
 
   // 0. given ecpoolid, get OfflineECPool
   OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
-  ecpool->lock();
+  // the pool is locked only to read and add objs, planning holds the lock of the stripe in StripeStore
+  ecpool->lockShared();
   ECPolicy *ecpolicy = ecpool->getEcpolicy();
+  // objs in current stripe (now we only have source objs)
+  vector<string> stripelist = ecpool->getStripeObjList(stripename);
+  // maximum obj size in current stripe
+  int basesizeMB = ecpool->getBasesize();
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
   ECBase *ec = ecpolicy->createECClass();
   int n = ecpolicy->getN();
   int k = ecpolicy->getK();
@@ -655,8 +733,6 @@ void Coordinator::offlineEnc(CoorCommand *coorCmd)
   unordered_map<int, pair<string, unsigned int>> objlist;
   // stripeidx -> location
   unordered_map<int, unsigned int> sid2ip;
-  // objs in current stripe (now we only have source objs)
-  vector<string> stripelist = ecpool->getStripeObjList(stripename);
   // location for current stripe, indexed by stripe idx (now we only have source locations)
   vector<unsigned int> stripeips;
   // stripeplaced records the objnames that have been stored in this stripe
@@ -666,8 +742,6 @@ void Coordinator::offlineEnc(CoorCommand *coorCmd)
   //  for (int i=0; i<stripelist.size(); i++) cout << stripelist[i] << " ";
   //  cout << endl;
 
-  // maximum obj size in current stripe
-  int basesizeMB = ecpool->getBasesize();
   unsigned long long basesizeBytes = (unsigned long long)basesizeMB * 1048576;
   int pktnum = basesizeBytes / (unsigned long long)_conf->_pktSize;
 
@@ -704,12 +778,14 @@ void Coordinator::offlineEnc(CoorCommand *coorCmd)
     stripeplaced.push_back(i);
 
     // add parity obj to ecpool
+    ecpool->lock();
     ecpool->addObj(objname, stripename);
+    ecpool->unlock();
     // create ssentry for parity obj, only has 1 obj in it
     SSEntry *ssentry = new SSEntry(objname, 1, basesizeMB, ecpoolid, {objname}, {loc});
     _stripeStore->insertEntry(ssentry);
   }
-  ecpool->unlock();
+  _stripeStore->unlockStripe(stripename);
 
   // debug info
   //  for (auto item: objlist) {
@@ -820,7 +896,7 @@ void Coordinator::offlineEnc(CoorCommand *coorCmd)
   for (int i = 0; i < parityobj.size(); i++)
   {
     SSEntry *curentry = _stripeStore->getEntryFromObj(parityobj[i]);
-    _stripeStore->backupEntry(curentry->toString());
+    _stripeStore->backupEntry(curentry);
   }
 
   // free
@@ -929,6 +1005,7 @@ void Coordinator::onlineDegradedInst(CoorCommand *coorCmd)
   struct timeval time1, time2, time3, time4;
   gettimeofday(&time1, NULL);
   string filename = coorCmd->getFilename();
+  _stripeStore->lockStripe(filename);
   vector<int> corruptIdx = coorCmd->getCorruptIdx();
   unsigned int ip = coorCmd->getClientip();
 
@@ -1042,6 +1119,15 @@ void Coordinator::onlineDegradedInst(CoorCommand *coorCmd)
   memcpy(instruction + offset, (char *)&tmpcomputen, 4);
   offset += 4;
 
+  // the read holds the cross-rack links from the loaded splits to the client
+  RepairLoad readLoad(_conf);
+  for (auto idx : loadidx)
+  {
+    string objname = filename + "_oecobj_" + to_string(idx);
+    readLoad.addTransfer(ssentry->getLocOfObj(objname), ip, ecw);
+  }
+  _linkScheduler->reserveRead(_linkScheduler->demand(readLoad, (long)ssentry->getFilesizeMB() * 1048576 / eck / ecw));
+
   string key = "onlinedegradedinst:" + filename;
   redisContext *sendCtx = RedisUtil::createContext(ip);
   redisReply *rReply = (redisReply *)redisCommand(sendCtx, "RPUSH %s %b", key.c_str(), instruction, offset);
@@ -1063,6 +1149,7 @@ void Coordinator::onlineDegradedInst(CoorCommand *coorCmd)
   delete ecdag;
   delete ec;
   free(instruction);
+  _stripeStore->unlockStripe(filename);
 }
 
 void Coordinator::offlineDegradedInst(CoorCommand *coorCmd)
@@ -1088,8 +1175,13 @@ void Coordinator::offlineDegradedInst(CoorCommand *coorCmd)
   }
 
   OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
-  ecpool->lock();
+  // the pool is locked only for lookups, planning holds the lock of the stripe in StripeStore
+  ecpool->lockShared();
   ECPolicy *ecpolicy = ecpool->getEcpolicy();
+  string stripename = ecpool->getStripeForObj(lostobj);
+  ecpool->unlockShared();
+  // the stripe keeps the policy of its pool until a migration moves it to another placement
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
   int opt = ecpolicy->getOpt();
 
   if (opt < 0)
@@ -1110,21 +1202,21 @@ void Coordinator::offlineDegradedInst(CoorCommand *coorCmd)
     // we only need to tell client where to fetch and key to fetch
     // return: num|key-ip|key-ip|..|
   }
-  ecpool->unlock();
 }
 
 void Coordinator::optOfflineDegrade(string lostobj, unsigned int clientIp, OfflineECPool *ecpool, ECPolicy *ecpolicy)
 {
   // return |opt|stripename|num|key-ip|key-ip|...|
   cout << "Coordinator::optOfflineDegrade" << endl;
-  int opt = ecpolicy->getOpt();
-
-  // 0. create ec instances
-  ECBase *ec = ecpolicy->createECClass();
 
   // 1, get stripeobjs for lostobj to figure out lostidx
+  ecpool->lockShared();
   string stripename = ecpool->getStripeForObj(lostobj);
   vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
+  int opt = ecpolicy->getOpt();
   int lostidx;
   vector<int> integrity;
   for (int i = 0; i < stripeobjs.size(); i++)
@@ -1161,83 +1253,15 @@ void Coordinator::optOfflineDegrade(string lostobj, unsigned int clientIp, Offli
     }
   }
 
-  // hack (start): special handling for AzureLRCTradeoff: overwride integrity and availacidx
-
-  string ecClassName = ecpolicy->getClassName();
-  if (ecClassName.find("AzureLRCFlat") != std::string::npos || ecClassName.find("AzureLRCTradeoff") != std::string::npos || ecClassName.find("AzureLRCOptR") != std::string::npos || ecClassName.find("AzureLRCOptM") != std::string::npos)
+  // create ec instances, with maintenance decoding while the rack of lostobj is under maintenance
+  unsigned int lostloc = _stripeStore->getEntryFromObj(lostobj)->getLocOfObj(lostobj);
+  bool maintenance = useMaintenance(ecpolicy, lostidx, lostloc);
+  ECBase *ec = ecpolicy->createECClass(maintenance);
+  if (maintenance)
   {
-    // check if it's maintenance
-    vector<string> params = ecpolicy->getParams();
-    int approach = 0;
-    if (ecClassName.find("AzureLRCTradeoff") != std::string::npos)
-    {
-      approach = atoi(params[3].c_str());
-    }
-    else if (ecClassName.find("AzureLRCOptR") != std::string::npos || ecClassName.find("AzureLRCOptM") != std::string::npos)
-    {
-      approach = atoi(params[2].c_str());
-    }
-    if (approach == 1)
-    {
-      printf("special handling for maintenance for %s (%u, %u)\n", ecClassName.c_str(), ec->_n, ec->_k);
-
-      vector<vector<int>> group;
-      ec->Place(group);
-
-      // get failed group id
-      int failed_gp_id = -1;
-
-      for (int gp_id = 0; gp_id < group.size(); gp_id++)
-      {
-        for (auto bid : group[gp_id])
-        {
-          if (bid == lostidx)
-          {
-            failed_gp_id = gp_id;
-            break;
-          }
-        }
-
-        if (failed_gp_id != -1)
-        {
-          break;
-        }
-      }
-
-      // update integrity and availcidx
-      integrity.clear();
-      availcidx.clear();
-
-      for (int i = 0; i < ecn; i++)
-      {
-        if (i == lostidx)
-        {
-          integrity.push_back(0);
-        }
-        else
-        {
-          // if we cannot find the block in the failed group
-          if (find(group[failed_gp_id].begin(), group[failed_gp_id].end(), i) == group[failed_gp_id].end())
-          {
-            integrity.push_back(1);
-            for (int j = 0; j < ecw; j++)
-            {
-              availcidx.push_back(i * ecw + j);
-            }
-          }
-          else
-          {
-            integrity.push_back(0);
-          }
-        }
-      }
-    }
+    printf("maintenance decoding for %s (%u, %u)\n", ecpolicy->getClassName().c_str(), ec->_n, ec->_k);
+    excludeLostGroup(ec, lostidx, ecn, ecw, integrity, availcidx);
   }
-  // hack (end)
-
-  // create ecdag
-  ECDAG *ecdag = ec->Decode(availcidx, toreccidx);
-  ecdag->reconstruct(opt);
 
   // prepare sid2ip, for cip2ip
   // prepare stripeips for client info
@@ -1261,35 +1285,45 @@ void Coordinator::optOfflineDegrade(string lostobj, unsigned int clientIp, Offli
     stripeips.push_back(loc);
   }
 
-  vector<int> toposeq = ecdag->toposort();
-
-  // prepare cid2ip, for parseForOEC
+  // reuse the plan of a stripe laid out alike, or create ecdag
   unordered_map<int, unsigned int> cid2ip;
-  for (int i = 0; i < toposeq.size(); i++)
+  string plankey = PlanCache::genKey(ecpolicy->getPolicyId(), maintenance ? "degraded-maintenance" : "degraded", integrity, sid2ip, _conf->_ip2Rack);
+  ECDAG *ecdag = _planCache->lookup(plankey, sid2ip, cid2ip);
+  if (!ecdag)
   {
-    int cidx = toposeq[i];
-    ECNode *node = ecdag->getNode(cidx);
-    // vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality);
-    // // choose from candidates
-    // unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
+    ecdag = ec->Decode(availcidx, toreccidx);
+    ecdag->reconstruct(opt);
 
-    // hacked: modify ip selection
-    vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, 1);
-    // choose from candidates
-    unsigned int curip = candidates[0];
+    vector<int> toposeq = ecdag->toposort();
 
-    cid2ip.insert(make_pair(cidx, curip));
+    // prepare cid2ip, for parseForOEC
+    for (int i = 0; i < toposeq.size(); i++)
+    {
+      int cidx = toposeq[i];
+      ECNode *node = ecdag->getNode(cidx);
+      // vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality);
+      // // choose from candidates
+      // unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
+
+      // hacked: modify ip selection
+      vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, 1);
+      // choose from candidates
+      unsigned int curip = candidates[0];
+
+      cid2ip.insert(make_pair(cidx, curip));
+    }
+
+    // optimize (hacked)
+    // ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
+    ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, 1);
+    _planCache->insert(plankey, ecdag, sid2ip, cid2ip);
   }
+  ecdag->dump();
 
   // prepare pktnum for parseForOEC
   int basesizeMB = ecpool->getBasesize();
   int pktnum = basesizeMB * 1048576 / _conf->_pktSize;
 
-  // optimize (hacked)
-  // ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
-  ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, 1);
-  ecdag->dump();
-
   // 6. parse for oec
   unordered_map<int, AGCommand *> agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
 
@@ -1336,6 +1370,13 @@ void Coordinator::optOfflineDegrade(string lostobj, unsigned int clientIp, Offli
     offset += 4;
   }
 
+  // the read holds the cross-rack links of its commands and from the roots to the client
+  RepairLoad readLoad(_conf);
+  readLoad.add(agCmds, vector<AGCommand *>());
+  for (auto item : rootinfo)
+    readLoad.addTransfer(item.second, clientIp, 1);
+  _linkScheduler->reserveRead(_linkScheduler->demand(readLoad, (long)basesizeMB * 1048576 / ecw));
+
   // send instruction back to client agent
   string key = "offlinedegradedinst:" + lostobj;
   redisContext *sendCtx = RedisUtil::createContext(clientIp);
@@ -1389,18 +1430,23 @@ void Coordinator::optOfflineDegrade(string lostobj, unsigned int clientIp, Offli
       delete item.second;
   for (auto item : todelete)
     free(item);
+  _stripeStore->unlockStripe(stripename);
 }
 
 void Coordinator::nonOptOfflineDegrade(string lostobj, unsigned int clientIp, OfflineECPool *ecpool, ECPolicy *ecpolicy)
 {
   cout << "Coordinator::nonOptOfflineDegrade" << endl;
-  int opt = ecpolicy->getOpt();
-  // 0, create ec instance
-  ECBase *ec = ecpolicy->createECClass();
 
   // 1, get stripeobjs for lostobj to figure out lostidx
+  ecpool->lockShared();
   string stripename = ecpool->getStripeForObj(lostobj);
   vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
+  int opt = ecpolicy->getOpt();
+  // 0, create ec instance
+  ECBase *ec = ecpolicy->createECClass();
   int lostidx;
   vector<int> integrity;
   for (int i = 0; i < stripeobjs.size(); i++)
@@ -1536,6 +1582,15 @@ void Coordinator::nonOptOfflineDegrade(string lostobj, unsigned int clientIp, Of
   memcpy(instruction + offset, (char *)&tmpcomputen, 4);
   offset += 4;
 
+  // the read holds the cross-rack links from the loaded blocks to the client
+  RepairLoad readLoad(_conf);
+  for (int i = 0; i < loadidx.size(); i++)
+  {
+    unsigned int loc = _stripeStore->getEntryFromObj(loadobjs[i])->getLocOfObj(loadobjs[i]);
+    readLoad.addTransfer(loc, clientIp, sid2Cids[loadidx[i]].size());
+  }
+  _linkScheduler->reserveRead(_linkScheduler->demand(readLoad, (long)ecpool->getBasesize() * 1048576 / ecw));
+
   // first send out info without compute
   string key = "offlinedegradedinst:" + lostobj;
   redisContext *sendCtx = RedisUtil::createContext(clientIp);
@@ -1558,6 +1613,7 @@ void Coordinator::nonOptOfflineDegrade(string lostobj, unsigned int clientIp, Of
   delete ecdag;
   delete ec;
   free(instruction);
+  _stripeStore->unlockStripe(stripename);
 }
 
 void Coordinator::reportLost(CoorCommand *coorCmd)
@@ -1584,14 +1640,16 @@ void Coordinator::repairReqFromSS(CoorCommand *coorCmd)
 
   if (redundancy == 0)
   {
-    // return recoveryOnline(objname);
-    return recoveryOnlineHCIP(objname);
+    // recoveryOnline(objname);
+    recoveryOnlineHCIP(objname);
   }
   else
   {
-    return recoveryOfflineHCIP(objname);
-    // return recoveryOffline(objname);
+    recoveryOfflineHCIP(objname);
+    // recoveryOffline(objname);
   }
+  // the repair has been persisted, free its slot for the next lost object
+  _stripeStore->finishRepair(objname);
 }
 
 void Coordinator::recoveryOnline(string lostobj)
@@ -1611,6 +1669,7 @@ void Coordinator::recoveryOnline(string lostobj)
   // 2, get stripeobjs for lostobj to figure out lostidx
   string filename = ssentry->getFilename();
   string stripename = filename;
+  _stripeStore->lockStripe(stripename);
   vector<string> stripeobjs = ssentry->getObjlist();
   int lostidx;
   vector<int> integrity;
@@ -1758,6 +1817,24 @@ void Coordinator::recoveryOnline(string lostobj)
   // 7. add persist cmd
   vector<AGCommand *> persistCmds = ecdag->persist(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
 
+  // wait until the cross-rack links of the repair have room for it, with the stripe unlocked
+  int linkid;
+  if (!admitRepair(stripename, objlist, _linkScheduler->demand(agCmds, persistCmds, (long)objsizeMB * 1048576 / ecw), linkid))
+  {
+    // blocks of the stripe moved meanwhile, plan again against where they are now
+    delete ec;
+    delete ecdag;
+    for (auto item : agCmds)
+      if (item.second)
+        delete item.second;
+    for (auto item : persistCmds)
+      if (item)
+        delete item;
+    _stripeStore->unlockStripe(stripename);
+    recoveryOnline(lostobj);
+    return;
+  }
+
   // 8. send commands to cmddistributor
   vector<char *> todelete;
   redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
@@ -1821,6 +1898,7 @@ void Coordinator::recoveryOnline(string lostobj)
     redisFree(waitCtx);
   }
   cout << "Coordinator::repair for " << lostobj << " finishes" << endl;
+  _linkScheduler->release(linkid);
 
   // delete
   delete ec;
@@ -1833,6 +1911,7 @@ void Coordinator::recoveryOnline(string lostobj)
       delete item;
   for (auto item : todelete)
     free(item);
+  _stripeStore->unlockStripe(stripename);
 }
 
 void Coordinator::recoveryOnlineHCIP(string lostobj)
@@ -1852,6 +1931,7 @@ void Coordinator::recoveryOnlineHCIP(string lostobj)
   // 2, get stripeobjs for lostobj to figure out lostidx
   string filename = ssentry->getFilename();
   string stripename = filename;
+  _stripeStore->lockStripe(stripename);
   vector<string> stripeobjs = ssentry->getObjlist();
   int lostidx;
   vector<int> integrity;
@@ -2010,6 +2090,24 @@ void Coordinator::recoveryOnlineHCIP(string lostobj)
   // 7. add persist cmd
   vector<AGCommand *> persistCmds = ecdag->persist(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
 
+  // wait until the cross-rack links of the repair have room for it, with the stripe unlocked
+  int linkid;
+  if (!admitRepair(stripename, objlist, _linkScheduler->demand(agCmds, persistCmds, (long)objsizeMB * 1048576 / ecw), linkid))
+  {
+    // blocks of the stripe moved meanwhile, plan again against where they are now
+    delete ec;
+    delete ecdag;
+    for (auto item : agCmds)
+      if (item.second)
+        delete item.second;
+    for (auto item : persistCmds)
+      if (item)
+        delete item;
+    _stripeStore->unlockStripe(stripename);
+    recoveryOnlineHCIP(lostobj);
+    return;
+  }
+
   // 8. send commands to cmddistributor
   vector<char *> todelete;
   redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
@@ -2073,6 +2171,7 @@ void Coordinator::recoveryOnlineHCIP(string lostobj)
     redisFree(waitCtx);
   }
   cout << "Coordinator::repair for " << lostobj << " finishes" << endl;
+  _linkScheduler->release(linkid);
 
   // delete
   delete ec;
@@ -2085,6 +2184,7 @@ void Coordinator::recoveryOnlineHCIP(string lostobj)
       delete item;
   for (auto item : todelete)
     free(item);
+  _stripeStore->unlockStripe(stripename);
 }
 
 void Coordinator::recoveryOffline(string lostobj)
@@ -2093,16 +2193,15 @@ void Coordinator::recoveryOffline(string lostobj)
   SSEntry *ssentry = _stripeStore->getEntryFromObj(lostobj);
   string ecpoolid = ssentry->getEcidpool();
   OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
-  ecpool->lock();
+  ecpool->lockShared();
   ECPolicy *ecpolicy = ecpool->getEcpolicy();
 
-  // 1. create ec instances
-  ECBase *ec = ecpolicy->createECClass();
-
   // 2, get stripeobjs for lostobj to figure out lostidx
   string stripename = ecpool->getStripeForObj(lostobj);
   vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
-  ecpool->unlock();
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
   int lostidx;
   vector<int> integrity;
   for (int i = 0; i < stripeobjs.size(); i++)
@@ -2140,9 +2239,14 @@ void Coordinator::recoveryOffline(string lostobj)
     }
   }
 
-  // create ecdag
-  ECDAG *ecdag = ec->Decode(availcidx, toreccidx);
-  ecdag->reconstruct(opt);
+  // 1. create ec instances, with maintenance decoding while the rack of lostobj is under maintenance
+  bool maintenance = useMaintenance(ecpolicy, lostidx, ssentry->getLocOfObj(lostobj));
+  ECBase *ec = ecpolicy->createECClass(maintenance);
+  // integrity tells the blocks the plan reads, while alive keeps the blocks that are stored:
+  // the rest of the group of lostobj is excluded from the plan, but stays where it is
+  vector<int> alive = integrity;
+  if (maintenance)
+    excludeLostGroup(ec, lostidx, ecn, ecw, integrity, availcidx);
 
   // prepare sid2ip, for cip2ip
   // prepare stripeips for client info
@@ -2163,7 +2267,7 @@ void Coordinator::recoveryOffline(string lostobj)
 
     objlist.insert(make_pair(sid, curpair));
     sid2ip.insert(make_pair(sid, loc));
-    stripeips.push_back(loc);
+    stripeips.push_back(alive[i] == 1 ? curssentry->getLocOfObj(objname) : 0);
   }
 
   // we need to update the location for lostobj
@@ -2183,7 +2287,7 @@ void Coordinator::recoveryOffline(string lostobj)
   vector<int> placedIdx;
   for (int i = 0; i < ecn; i++)
   {
-    if (integrity[i] == 1)
+    if (i != lostidx)
     {
       placedIdx.push_back(i);
       placedIps.push_back(stripeips[i]);
@@ -2197,7 +2301,7 @@ void Coordinator::recoveryOffline(string lostobj)
       // we need to remove remaining ips in candidates
       for (int j = i + 1; j < ecn; j++)
       {
-        if (integrity[j] == 1)
+        if (alive[j] == 1)
         {
           unsigned int toremove = stripeips[j];
           vector<unsigned int>::iterator position = find(candidates.begin(), candidates.end(), toremove);
@@ -2221,27 +2325,37 @@ void Coordinator::recoveryOffline(string lostobj)
     }
   }
 
-  vector<int> toposeq = ecdag->toposort();
-
-  // prepare cid2ip, for parseForOEC
+  // reuse the plan of a stripe laid out alike, or create ecdag
   unordered_map<int, unsigned int> cid2ip;
-  for (int i = 0; i < toposeq.size(); i++)
+  string plankey = PlanCache::genKey(ecpolicy->getPolicyId(), maintenance ? "repair-maintenance" : "repair", integrity, sid2ip, _conf->_ip2Rack);
+  ECDAG *ecdag = _planCache->lookup(plankey, sid2ip, cid2ip);
+  if (!ecdag)
   {
-    int cidx = toposeq[i];
-    ECNode *node = ecdag->getNode(cidx);
-    vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality, lostidx);
-    // choose from candidates
-    unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
-    cid2ip.insert(make_pair(cidx, curip));
+    ecdag = ec->Decode(availcidx, toreccidx);
+    ecdag->reconstruct(opt);
+
+    vector<int> toposeq = ecdag->toposort();
+
+    // prepare cid2ip, for parseForOEC
+    for (int i = 0; i < toposeq.size(); i++)
+    {
+      int cidx = toposeq[i];
+      ECNode *node = ecdag->getNode(cidx);
+      vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality, lostidx);
+      // choose from candidates
+      unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
+      cid2ip.insert(make_pair(cidx, curip));
+    }
+
+    // optimize
+    ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
+    _planCache->insert(plankey, ecdag, sid2ip, cid2ip);
   }
 
   int filesizeMB = ssentry->getFilesizeMB();
   int objsizeMB = filesizeMB / eck;
   int pktnum = objsizeMB * 1048576 / _conf->_pktSize;
 
-  // optimize
-  ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
-
   // 6. parse for oec
   // vector<AGCommand*> agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
   unordered_map<int, AGCommand *> agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
@@ -2249,6 +2363,24 @@ void Coordinator::recoveryOffline(string lostobj)
   // 7. add persist cmd
   vector<AGCommand *> persistCmds = ecdag->persist(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
 
+  // wait until the cross-rack links of the repair have room for it, with the stripe unlocked
+  int linkid;
+  if (!admitRepair(stripename, objlist, _linkScheduler->demand(agCmds, persistCmds, (long)objsizeMB * 1048576 / ecw), linkid))
+  {
+    // blocks of the stripe moved meanwhile, plan again against where they are now
+    delete ec;
+    delete ecdag;
+    for (auto item : agCmds)
+      if (item.second)
+        delete item.second;
+    for (auto item : persistCmds)
+      if (item)
+        delete item;
+    _stripeStore->unlockStripe(stripename);
+    recoveryOffline(lostobj);
+    return;
+  }
+
   // 8. send commands to cmddistributor
   vector<char *> todelete;
   redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
@@ -2314,6 +2446,7 @@ void Coordinator::recoveryOffline(string lostobj)
     redisFree(waitCtx);
   }
   cout << "Coordinator::repair for " << lostobj << " finishes" << endl;
+  _linkScheduler->release(linkid);
 
   // delete
   delete ec;
@@ -2326,6 +2459,7 @@ void Coordinator::recoveryOffline(string lostobj)
       delete item;
   for (auto item : todelete)
     free(item);
+  _stripeStore->unlockStripe(stripename);
 }
 
 void Coordinator::recoveryOfflineHCIP(string lostobj)
@@ -2334,16 +2468,15 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
   SSEntry *ssentry = _stripeStore->getEntryFromObj(lostobj);
   string ecpoolid = ssentry->getEcidpool();
   OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
-  ecpool->lock();
+  ecpool->lockShared();
   ECPolicy *ecpolicy = ecpool->getEcpolicy();
 
-  // 1. create ec instances
-  ECBase *ec = ecpolicy->createECClass();
-
   // 2, get stripeobjs for lostobj to figure out lostidx
   string stripename = ecpool->getStripeForObj(lostobj);
   vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
-  ecpool->unlock();
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
   int lostidx;
   vector<int> integrity;
   for (int i = 0; i < stripeobjs.size(); i++)
@@ -2381,9 +2514,14 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
     }
   }
 
-  // create ecdag
-  ECDAG *ecdag = ec->Decode(availcidx, toreccidx);
-  ecdag->reconstruct(opt);
+  // 1. create ec instances, with maintenance decoding while the rack of lostobj is under maintenance
+  bool maintenance = useMaintenance(ecpolicy, lostidx, ssentry->getLocOfObj(lostobj));
+  ECBase *ec = ecpolicy->createECClass(maintenance);
+  // integrity tells the blocks the plan reads, while alive keeps the blocks that are stored:
+  // the rest of the group of lostobj is excluded from the plan, but stays where it is
+  vector<int> alive = integrity;
+  if (maintenance)
+    excludeLostGroup(ec, lostidx, ecn, ecw, integrity, availcidx);
 
   // prepare sid2ip, for cip2ip
   // prepare stripeips for client info
@@ -2404,7 +2542,7 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
 
     objlist.insert(make_pair(sid, curpair));
     sid2ip.insert(make_pair(sid, loc));
-    stripeips.push_back(loc);
+    stripeips.push_back(alive[i] == 1 ? curssentry->getLocOfObj(objname) : 0);
   }
 
   // we need to update the location for lostobj
@@ -2424,7 +2562,7 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
   vector<int> placedIdx;
   for (int i = 0; i < ecn; i++)
   {
-    if (integrity[i] == 1)
+    if (i != lostidx)
     {
       placedIdx.push_back(i);
       placedIps.push_back(stripeips[i]);
@@ -2438,7 +2576,7 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
       // we need to remove remaining ips in candidates
       for (int j = i + 1; j < ecn; j++)
       {
-        if (integrity[j] == 1)
+        if (alive[j] == 1)
         {
           unsigned int toremove = stripeips[j];
           vector<unsigned int>::iterator position = find(candidates.begin(), candidates.end(), toremove);
@@ -2462,38 +2600,49 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
     }
   }
 
-  vector<int> toposeq = ecdag->toposort();
-
-  // prepare cid2ip, for parseForOEC
+  // reuse the plan of a stripe laid out alike, or create ecdag; the pinned
+  // intermediate nodes sit with the lost block, so the plan binds like others
   unordered_map<int, unsigned int> cid2ip;
-  for (int i = 0; i < toposeq.size(); i++)
+  string plankey = PlanCache::genKey(ecpolicy->getPolicyId(), maintenance ? "hcip-maintenance" : "hcip", integrity, sid2ip, _conf->_ip2Rack);
+  ECDAG *ecdag = _planCache->lookup(plankey, sid2ip, cid2ip);
+  if (!ecdag)
   {
-    int cidx = toposeq[i];
-    ECNode *node = ecdag->getNode(cidx);
-    vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality, lostidx);
-    // choose from candidates
-    unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
+    ecdag = ec->Decode(availcidx, toreccidx);
+    ecdag->reconstruct(opt);
 
-    printf("before fixed IP: %d, %s\n", cidx, RedisUtil::ip2Str(curip).c_str());
+    vector<int> toposeq = ecdag->toposort();
 
-    // it's not a symbol to recover, fix the ip to the failed node
-    if (find(toreccidx.begin(), toreccidx.end(), cidx) == toreccidx.end() &&
-        find(availcidx.begin(), availcidx.end(), cidx) == availcidx.end())
+    // prepare cid2ip, for parseForOEC
+    for (int i = 0; i < toposeq.size(); i++)
     {
-      curip = sid2ip[lostidx];
+      int cidx = toposeq[i];
+      ECNode *node = ecdag->getNode(cidx);
+      vector<unsigned int> candidates = node->candidateIps(sid2ip, cid2ip, _conf->_agentsIPs, ecn, eck, ecw, locality, lostidx);
+      // choose from candidates
+      unsigned int curip = chooseFromCandidates(candidates, _conf->_repair_policy, "repair");
+
+      printf("before fixed IP: %d, %s\n", cidx, RedisUtil::ip2Str(curip).c_str());
+
+      // it's not a symbol to recover, fix the ip to the failed node
+      if (find(toreccidx.begin(), toreccidx.end(), cidx) == toreccidx.end() &&
+          find(availcidx.begin(), availcidx.end(), cidx) == availcidx.end())
+      {
+        curip = sid2ip[lostidx];
+      }
+      printf("after: fixed IP: %d, %s\n", cidx, RedisUtil::ip2Str(curip).c_str());
+
+      cid2ip.insert(make_pair(cidx, curip));
     }
-    printf("after: fixed IP: %d, %s\n", cidx, RedisUtil::ip2Str(curip).c_str());
 
-    cid2ip.insert(make_pair(cidx, curip));
+    // optimize
+    ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
+    _planCache->insert(plankey, ecdag, sid2ip, cid2ip);
   }
 
   int filesizeMB = ssentry->getFilesizeMB();
   int objsizeMB = filesizeMB / eck;
   int pktnum = objsizeMB * 1048576 / _conf->_pktSize;
 
-  // optimize
-  ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, _conf->_agentsIPs, locality);
-
   // 6. parse for oec
   // vector<AGCommand*> agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
   unordered_map<int, AGCommand *> agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
@@ -2501,6 +2650,24 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
   // 7. add persist cmd
   vector<AGCommand *> persistCmds = ecdag->persist(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
 
+  // wait until the cross-rack links of the repair have room for it, with the stripe unlocked
+  int linkid;
+  if (!admitRepair(stripename, objlist, _linkScheduler->demand(agCmds, persistCmds, (long)objsizeMB * 1048576 / ecw), linkid))
+  {
+    // blocks of the stripe moved meanwhile, plan again against where they are now
+    delete ec;
+    delete ecdag;
+    for (auto item : agCmds)
+      if (item.second)
+        delete item.second;
+    for (auto item : persistCmds)
+      if (item)
+        delete item;
+    _stripeStore->unlockStripe(stripename);
+    recoveryOfflineHCIP(lostobj);
+    return;
+  }
+
   // 8. send commands to cmddistributor
   vector<char *> todelete;
   redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
@@ -2566,6 +2733,7 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
     redisFree(waitCtx);
   }
   cout << "Coordinator::repair for " << lostobj << " finishes" << endl;
+  _linkScheduler->release(linkid);
 
   // delete
   delete ec;
@@ -2578,6 +2746,486 @@ void Coordinator::recoveryOfflineHCIP(string lostobj)
       delete item;
   for (auto item : todelete)
     free(item);
+  _stripeStore->unlockStripe(stripename);
+}
+
+void Coordinator::batchRecovery(CoorCommand *coorCmd)
+{
+  string failed = coorCmd->getFailed();
+  unsigned int clientIp = coorCmd->getClientip();
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+
+  // a rack name or the ip of a node
+  vector<unsigned int> failedIps;
+  if (_conf->_rack2Ips.find(failed) != _conf->_rack2Ips.end())
+    failedIps = _conf->_rack2Ips[failed];
+  else
+    failedIps.push_back(inet_addr(failed.c_str()));
+  vector<unsigned int> aliveIps;
+  for (auto ip : _conf->_agentsIPs)
+  {
+    if (find(failedIps.begin(), failedIps.end(), ip) == failedIps.end())
+      aliveIps.push_back(ip);
+  }
+
+  // group the lost blocks by stripe, online objects are repaired one by one
+  vector<string> lostobjs = _stripeStore->getObjsOnIps(failedIps);
+  unordered_map<string, vector<string>> stripe2lost;
+  unordered_map<string, OfflineECPool *> stripe2pool;
+  vector<string> onlineobjs;
+  int claimed = 0;
+  for (auto objname : lostobjs)
+  {
+    // the batch repairs objname, take it out of the repair queue, unless the scan
+    // path already repairs it
+    if (!_stripeStore->claimLostObj(objname))
+      continue;
+    claimed++;
+    SSEntry *ssentry = _stripeStore->getEntryFromObj(objname);
+    if (ssentry->getType() == 0)
+    {
+      onlineobjs.push_back(objname);
+      continue;
+    }
+    OfflineECPool *ecpool = _stripeStore->getECPool(ssentry->getEcidpool());
+    ecpool->lockShared();
+    string stripename = ecpool->getStripeForObj(objname);
+    ecpool->unlockShared();
+    stripe2lost[stripename].push_back(objname);
+    stripe2pool[stripename] = ecpool;
+  }
+  cout << "Coordinator::batchRecovery for " << failed << ": " << claimed << " of " << lostobjs.size() << " objs in "
+       << stripe2lost.size() << " stripes" << endl;
+
+  // the stripes that lose the most blocks are the most at risk, repair them first
+  vector<string> stripenames;
+  for (auto item : stripe2lost)
+    stripenames.push_back(item.first);
+  sort(stripenames.begin(), stripenames.end(), [&](string a, string b)
+       { return stripe2lost[a].size() > stripe2lost[b].size() ||
+                (stripe2lost[a].size() == stripe2lost[b].size() && a < b); });
+
+  // repair ec.concurrent.num stripes at a time, planned against the load of the whole batch
+  RepairLoad load(_conf);
+  int repaired = 0;
+  int wavesize = max(_conf->_ec_concurrent, 1);
+  for (int begin = 0; begin < stripenames.size(); begin += wavesize)
+  {
+    vector<string> wave(stripenames.begin() + begin, stripenames.begin() + min(begin + wavesize, (int)stripenames.size()));
+    _stripeStore->lockStripes(wave);
+
+    vector<string> planned;
+    unordered_map<string, unordered_map<int, AGCommand *>> stripeCmds;
+    unordered_map<string, vector<AGCommand *>> stripePersists;
+    unordered_map<string, unordered_map<int, pair<string, unsigned int>>> stripeObjlist;
+    unordered_map<string, double> waveDemand;
+    for (auto stripename : wave)
+    {
+      unordered_map<int, AGCommand *> agCmds;
+      vector<AGCommand *> persistCmds;
+      unordered_map<int, pair<string, unsigned int>> objlist;
+      long subBlockBytes;
+      if (!planBatchStripe(stripename, stripe2pool[stripename], stripe2lost[stripename], failedIps, aliveIps, load, agCmds, persistCmds, subBlockBytes, objlist))
+      {
+        // hand the objects back to the repair queue, which repairs them one by one
+        for (auto objname : stripe2lost[stripename])
+        {
+          _stripeStore->finishRepair(objname);
+          _stripeStore->addLostObj(objname);
+        }
+        continue;
+      }
+      load.add(agCmds, persistCmds);
+      for (auto item : _linkScheduler->demand(agCmds, persistCmds, subBlockBytes))
+        waveDemand[item.first] += item.second;
+      planned.push_back(stripename);
+      stripeCmds[stripename] = agCmds;
+      stripePersists[stripename] = persistCmds;
+      stripeObjlist[stripename] = objlist;
+    }
+
+    // wait for room on the cross-rack links with the stripes unlocked, as admitRepair does,
+    // so that degraded reads of the wave go on meanwhile
+    _stripeStore->unlockStripes(wave);
+    int linkid = _linkScheduler->reserveRepair(waveDemand);
+    _stripeStore->lockStripes(wave);
+
+    vector<AGCommand *> waveCmds;
+    vector<AGCommand *> wavePersists;
+    vector<string> waveObjs;
+    vector<string> sent;
+    for (auto stripename : planned)
+    {
+      bool valid = planValid(stripename, stripeObjlist[stripename]);
+      for (auto item : stripeCmds[stripename])
+      {
+        if (!item.second)
+          continue;
+        if (valid)
+          waveCmds.push_back(item.second);
+        else
+          delete item.second;
+      }
+      for (auto agcmd : stripePersists[stripename])
+      {
+        if (valid)
+          wavePersists.push_back(agcmd);
+        else
+          delete agcmd;
+      }
+      for (auto objname : stripe2lost[stripename])
+      {
+        if (valid)
+        {
+          waveObjs.push_back(objname);
+          continue;
+        }
+        _stripeStore->finishRepair(objname);
+        _stripeStore->addLostObj(objname);
+      }
+      if (valid)
+        sent.push_back(stripename);
+    }
+
+    // send the commands of the wave at once, and let the stripes go once they are sent
+    vector<char *> todelete;
+    redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
+    redisAppendCommand(distCtx, "MULTI");
+    for (int i = 0; i < waveCmds.size() + wavePersists.size(); i++)
+    {
+      AGCommand *agcmd = i < waveCmds.size() ? waveCmds[i] : wavePersists[i - waveCmds.size()];
+      if (!agcmd->getShouldSend())
+        continue;
+      unsigned int ip = htonl(agcmd->getSendIp());
+      char *cmdstr = agcmd->getCmd();
+      int cmLen = agcmd->getCmdLen();
+      char *todist = (char *)calloc(cmLen + 4, sizeof(char));
+      memcpy(todist, (char *)&ip, 4);
+      memcpy(todist + 4, cmdstr, cmLen);
+      todelete.push_back(todist);
+      redisAppendCommand(distCtx, "RPUSH dist_request %b", todist, cmLen + 4);
+    }
+    redisAppendCommand(distCtx, "EXEC");
+
+    redisReply *distReply;
+    for (int i = 0; i < todelete.size() + 2; i++)
+    {
+      redisGetReply(distCtx, (void **)&distReply);
+      freeReplyObject(distReply);
+    }
+    redisFree(distCtx);
+    _stripeStore->unlockStripes(wave);
+
+    // wait for the blocks of the wave to be persisted
+    for (auto agcmd : wavePersists)
+    {
+      redisContext *waitCtx = RedisUtil::createContext(agcmd->getSendIp());
+      string wkey = "writefinish:" + agcmd->getWriteObjName();
+      redisReply *fReply = (redisReply *)redisCommand(waitCtx, "blpop %s 0", wkey.c_str());
+      freeReplyObject(fReply);
+      redisFree(waitCtx);
+    }
+    _linkScheduler->release(linkid);
+
+    // log the new locations of the repaired blocks, as the migrator does once its blocks are written
+    _stripeStore->lockStripes(sent);
+    unordered_set<SSEntry *> entries;
+    for (auto objname : waveObjs)
+      entries.insert(_stripeStore->getEntryFromObj(objname));
+    for (auto ssentry : entries)
+      _stripeStore->backupEntry(ssentry);
+    _stripeStore->unlockStripes(sent);
+
+    for (auto item : waveCmds)
+      delete item;
+    for (auto item : wavePersists)
+      delete item;
+    for (auto item : todelete)
+      free(item);
+    for (auto objname : waveObjs)
+      _stripeStore->finishRepair(objname);
+    repaired += waveObjs.size();
+    cout << "Coordinator::batchRecovery.wave of " << wave.size() << " stripes finishes" << endl;
+  }
+
+  for (auto objname : onlineobjs)
+  {
+    recoveryOnlineHCIP(objname);
+    _stripeStore->finishRepair(objname);
+    repaired++;
+  }
+  load.dump();
+  _linkScheduler->dump();
+
+  gettimeofday(&time2, NULL);
+  cout << "Coordinator::batchRecovery for " << failed << " repairs " << repaired << " objs, duration = "
+       << RedisUtil::duration(time1, time2) << endl;
+
+  // batchrepaired:failed
+  redisContext *waitCtx = RedisUtil::createContext(clientIp);
+  string wkey = "batchrepaired:" + failed;
+  int tmpval = htonl(repaired);
+  redisReply *rReply = (redisReply *)redisCommand(waitCtx, "rpush %s %b", wkey.c_str(), (char *)&tmpval, sizeof(tmpval));
+  freeReplyObject(rReply);
+  redisFree(waitCtx);
+}
+
+bool Coordinator::planBatchStripe(string stripename, OfflineECPool *ecpool, vector<string> lostobjs,
+                                  vector<unsigned int> failedIps, vector<unsigned int> aliveIps, RepairLoad &load,
+                                  unordered_map<int, AGCommand *> &agCmds, vector<AGCommand *> &persistCmds, long &subBlockBytes,
+                                  unordered_map<int, pair<string, unsigned int>> &objlist)
+{
+  ecpool->lockShared();
+  ECPolicy *ecpolicy = ecpool->getEcpolicy();
+  vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
+  ecpool->unlockShared();
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
+
+  int ecn = ecpolicy->getN();
+  int eck = ecpolicy->getK();
+  int ecw = ecpolicy->getW();
+  bool locality = ecpolicy->getLocality();
+  int opt = ecpolicy->getOpt();
+  if (lostobjs.size() > ecn - eck)
+  {
+    cout << "Coordinator::batchRecovery.skip " << stripename << ", " << lostobjs.size() << " blocks lost" << endl;
+    return false;
+  }
+
+  // all the lost blocks of the stripe are repaired by one plan
+  vector<int> integrity;
+  vector<int> availcidx;
+  vector<int> toreccidx;
+  for (int i = 0; i < ecn; i++)
+  {
+    bool lost = find(lostobjs.begin(), lostobjs.end(), stripeobjs[i]) != lostobjs.end();
+    integrity.push_back(lost ? 0 : 1);
+    for (int j = 0; j < ecw; j++)
+    {
+      if (lost)
+        toreccidx.push_back(i * ecw + j);
+      else
+        availcidx.push_back(i * ecw + j);
+    }
+  }
+
+  unordered_map<int, unsigned int> sid2ip;
+  vector<unsigned int> stripeips;
+  for (int i = 0; i < ecn; i++)
+  {
+    string objname = stripeobjs[i];
+    unsigned int loc = 0;
+    if (integrity[i] == 1)
+      loc = _stripeStore->getEntryFromObj(objname)->getLocOfObj(objname);
+    objlist.insert(make_pair(i, make_pair(objname, loc)));
+    sid2ip.insert(make_pair(i, loc));
+    stripeips.push_back(loc);
+  }
+
+  // relocate the lost blocks as recoveryOffline does, off the failed nodes and onto the least loaded candidate
+  ECBase *ec = ecpolicy->createECClass();
+  vector<vector<int>> group;
+  ec->Place(group);
+  unordered_map<int, vector<int>> idx2group;
+  for (auto item : group)
+  {
+    for (auto idx : item)
+      idx2group.insert(make_pair(idx, item));
+  }
+  vector<unsigned int> placedIps;
+  vector<int> placedIdx;
+  for (int i = 0; i < ecn; i++)
+  {
+    if (integrity[i] == 1)
+    {
+      placedIdx.push_back(i);
+      placedIps.push_back(stripeips[i]);
+      continue;
+    }
+    vector<int> colocWith;
+    if (idx2group.find(i) != idx2group.end())
+      colocWith = idx2group[i];
+    vector<unsigned int> candidates;
+    for (auto ip : getCandidates(placedIps, placedIdx, colocWith))
+    {
+      if (find(failedIps.begin(), failedIps.end(), ip) == failedIps.end() &&
+          find(stripeips.begin() + i + 1, stripeips.end(), ip) == stripeips.end())
+        candidates.push_back(ip);
+    }
+    // the rack of the group is gone with the failure, go out of it
+    if (candidates.empty())
+    {
+      for (auto ip : aliveIps)
+      {
+        if (find(placedIps.begin(), placedIps.end(), ip) == placedIps.end() &&
+            find(stripeips.begin(), stripeips.end(), ip) == stripeips.end())
+          candidates.push_back(ip);
+      }
+    }
+    if (candidates.empty())
+    {
+      cout << "Coordinator::batchRecovery.skip " << stripename << ", no node left for block " << i << endl;
+      delete ec;
+      return false;
+    }
+    unsigned int curip = load.choose(candidates);
+    placedIps.push_back(curip);
+    placedIdx.push_back(i);
+    sid2ip[i] = curip;
+    objlist[i].second = curip;
+    stripeips[i] = curip;
+    _stripeStore->getEntryFromObj(objlist[i].first)->updateObjLoc(objlist[i].first, curip);
+  }
+
+  ECDAG *ecdag = ec->Decode(availcidx, toreccidx);
+  ecdag->reconstruct(opt);
+  vector<int> toposeq = ecdag->toposort();
+  unordered_map<int, unsigned int> cid2ip;
+  for (int i = 0; i < toposeq.size(); i++)
+  {
+    int cidx = toposeq[i];
+    vector<unsigned int> candidates;
+    for (auto ip : ecdag->getNode(cidx)->candidateIps(sid2ip, cid2ip, aliveIps, ecn, eck, ecw, locality))
+    {
+      if (find(failedIps.begin(), failedIps.end(), ip) == failedIps.end())
+        candidates.push_back(ip);
+    }
+    if (candidates.empty())
+      candidates = aliveIps;
+    cid2ip.insert(make_pair(cidx, load.choose(candidates)));
+  }
+  ecdag->optimize2(opt, cid2ip, _conf->_ip2Rack, ecn, eck, ecw, sid2ip, aliveIps, locality);
+
+  int filesizeMB = _stripeStore->getEntryFromObj(stripeobjs[0])->getFilesizeMB();
+  int pktnum = filesizeMB / eck * 1048576 / _conf->_pktSize;
+  subBlockBytes = (long)filesizeMB / eck * 1048576 / ecw;
+  agCmds = ecdag->parseForOEC(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
+  persistCmds = ecdag->persist(cid2ip, stripename, ecn, eck, ecw, pktnum, objlist);
+
+  delete ecdag;
+  delete ec;
+  return true;
+}
+
+void Coordinator::setMaintenance(CoorCommand *coorCmd)
+{
+  string rack = coorCmd->getRack();
+  int seconds = coorCmd->getSeconds();
+  if (_conf->_rack2Ips.find(rack) == _conf->_rack2Ips.end())
+  {
+    cout << "Coordinator::setMaintenance unknown rack " << rack << endl;
+    return;
+  }
+  cout << "Coordinator::setMaintenance rack " << rack << " for " << seconds << " seconds" << endl;
+  _stripeStore->setRackMaintenance(rack, seconds);
+}
+
+void Coordinator::migratePool(CoorCommand *coorCmd)
+{
+  string ecpoolid = coorCmd->getECPoolId();
+  string ecid = coorCmd->getEcid();
+  if (_conf->_offlineECMap.find(ecpoolid) == _conf->_offlineECMap.end())
+  {
+    cout << "Coordinator::migratePool unknown pool " << ecpoolid << endl;
+    return;
+  }
+  if (_conf->_ecPolicyMap.find(ecid) == _conf->_ecPolicyMap.end())
+  {
+    cout << "Coordinator::migratePool unknown ecid " << ecid << endl;
+    return;
+  }
+  // moving blocks keeps their content, so only a placement of the same code fits
+  ECPolicy *poolpolicy = _conf->_ecPolicyMap[_conf->_offlineECMap[ecpoolid]];
+  if (!poolpolicy->sameCode(_conf->_ecPolicyMap[ecid]))
+  {
+    cout << "Coordinator::migratePool " << ecid << " is not the code of " << ecpoolid << endl;
+    return;
+  }
+  cout << "Coordinator::migratePool " << ecpoolid << " to " << ecid << endl;
+  _migrator->start(ecpoolid, ecid);
+}
+
+bool Coordinator::admitRepair(string stripename, unordered_map<int, pair<string, unsigned int>> &objlist,
+                              unordered_map<string, double> demand, int &linkid)
+{
+  _stripeStore->unlockStripe(stripename);
+  linkid = _linkScheduler->reserveRepair(demand);
+  _stripeStore->lockStripe(stripename);
+
+  if (!planValid(stripename, objlist))
+  {
+    _linkScheduler->release(linkid);
+    linkid = -1;
+    return false;
+  }
+  return true;
+}
+
+bool Coordinator::planValid(string stripename, unordered_map<int, pair<string, unsigned int>> &objlist)
+{
+  // a block that is read or written by the plan has moved, e.g., by a migration
+  for (auto item : objlist)
+  {
+    string objname = item.second.first;
+    unsigned int loc = item.second.second;
+    if (loc == 0)
+      continue;
+    SSEntry *ssentry = _stripeStore->getEntryFromObj(objname);
+    if (ssentry == NULL || ssentry->getLocOfObj(objname) != loc)
+    {
+      cout << "Coordinator::planValid " << stripename << " changed while waiting for the links" << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Coordinator::useMaintenance(ECPolicy *ecpolicy, int lostidx, unsigned int lostloc)
+{
+  // pools of a maintenance policy keep decoding the way they are configured
+  if (ecpolicy->isMaintenance())
+    return true;
+  if (ecpolicy->getApproachIdx() < 0 || lostidx >= ecpolicy->getK())
+    return false;
+  unordered_map<unsigned int, string>::iterator it = _conf->_ip2Rack.find(lostloc);
+  if (it == _conf->_ip2Rack.end())
+    return false;
+  return _stripeStore->isRackInMaintenance(it->second);
+}
+
+void Coordinator::excludeLostGroup(ECBase *ec, int lostidx, int ecn, int ecw, vector<int> &integrity, vector<int> &availcidx)
+{
+  vector<vector<int>> group;
+  ec->Place(group);
+
+  // get failed group id
+  int failed_gp_id = -1;
+  for (int gp_id = 0; gp_id < group.size() && failed_gp_id == -1; gp_id++)
+  {
+    if (find(group[gp_id].begin(), group[gp_id].end(), lostidx) != group[gp_id].end())
+      failed_gp_id = gp_id;
+  }
+  if (failed_gp_id == -1)
+    return;
+
+  // update integrity and availcidx
+  integrity.clear();
+  availcidx.clear();
+  for (int i = 0; i < ecn; i++)
+  {
+    // blocks in the failed group are treated as lost
+    if (i == lostidx || find(group[failed_gp_id].begin(), group[failed_gp_id].end(), i) != group[failed_gp_id].end())
+    {
+      integrity.push_back(0);
+    }
+    else
+    {
+      integrity.push_back(1);
+      for (int j = 0; j < ecw; j++)
+        availcidx.push_back(i * ecw + j);
+    }
+  }
 }
 
 void Coordinator::coorBenchmark(CoorCommand *coorCmd)
@@ -2727,16 +3375,19 @@ void Coordinator::offlineDegradedET(CoorCommand *coorCmd)
   SSEntry *ssentry = _stripeStore->getEntryFromObj(lostobj);
   string ecpoolid = ssentry->getEcidpool();
   OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
-  ecpool->lock();
+  ecpool->lockShared();
   ECPolicy *ecpolicy = ecpool->getEcpolicy();
-  int opt = ecpolicy->getOpt();
-
-  // 0, create ec instance
-  ECBase *ec = ecpolicy->createECClass();
 
   // 1, get stripeobjs for lostobj to figure out lostidx
   string stripename = ecpool->getStripeForObj(lostobj);
   vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
+  ecpool->unlockShared();
+  _stripeStore->lockStripe(stripename);
+  ecpolicy = _stripeStore->getStripePolicy(stripename, ecpolicy);
+  int opt = ecpolicy->getOpt();
+
+  // 0, create ec instance
+  ECBase *ec = ecpolicy->createECClass();
   int lostidx;
   vector<int> integrity;
   for (int i = 0; i < stripeobjs.size(); i++)
@@ -2870,5 +3521,5 @@ void Coordinator::offlineDegradedET(CoorCommand *coorCmd)
   //  delete ec;
   //  free(instruction);
 
-  ecpool->unlock();
+  _stripeStore->unlockStripe(stripename);
 }
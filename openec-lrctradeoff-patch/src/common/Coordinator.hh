@@ -2,14 +2,20 @@
 #define _COORDINATOR_HH_
 
 // #include "AGCommand.hh"
+#include "BlockingQueue.hh"
 #include "Config.hh"
 #include "FSObjInputStream.hh"
+#include "LinkScheduler.hh"
+#include "PlacementMigrator.hh"
+#include "PlanCache.hh"
+#include "RepairLoad.hh"
 // #include "RedisUtil.hh"
 #include "StripeStore.hh"
 // #include "SSEntry.hh"
 // #include "UnderFile.hh"
 // #include "Util/hdfs.h"
 
+#include "../ec/Computation.hh"
 #include "../ec/ECDAG.hh"
 #include "../ec/OfflineECPool.hh"
 #include "../fs/FSUtil.hh"
@@ -27,11 +33,53 @@ private:
   redisContext *_localCtx;
   StripeStore *_stripeStore;
   UnderFS *_underfs;
+  PlanCache *_planCache;
+  // repairs wait for room on the cross-rack links, degraded reads do not
+  LinkScheduler *_linkScheduler;
+  // moves the stripes of pools to another placement in the background
+  PlacementMigrator *_migrator;
+
+  // requests received from coor_request with their arrival time, taken by
+  // oec.controller.thread.num workers
+  BlockingQueue<pair<CoorCommand *, struct timeval>> _requestQueue;
+  // encodings, repairs and migrations, which hold a worker until their blocks are
+  // written, so they never take the workers of degraded reads and metadata requests
+  BlockingQueue<pair<CoorCommand *, struct timeval>> _backgroundQueue;
+  vector<thread> _workers;
+
+  // time requests wait in either queue for a worker
+  mutex _lockDelay;
+  long _delayNum;
+  double _delaySum;
+  double _delayMax;
+
+  void workerLoop(BlockingQueue<pair<CoorCommand *, struct timeval>> *queue);
+  // the requests that go to _backgroundQueue
+  bool isBackground(int type);
+  void handleCommand(CoorCommand *coorCmd);
+  void recordDelay(double delay);
+  // maintenance decoding for the lost block at lostidx, stored at lostloc: set by the approach param of the policy,
+  // or by an open maintenance window on the rack of the block, for the data blocks that the codes support
+  bool useMaintenance(ECPolicy *ecpolicy, int lostidx, unsigned int lostloc);
+  // wait until the links admit a repair planned under the lock of stripename, with the stripe
+  // unlocked meanwhile; false, with nothing reserved, if blocks in objlist moved meanwhile
+  bool admitRepair(string stripename, unordered_map<int, pair<string, unsigned int>> &objlist,
+                   unordered_map<string, double> demand, int &linkid);
+  // whether the blocks in objlist are still where the plan of stripename read or write them, under its lock
+  bool planValid(string stripename, unordered_map<int, pair<string, unsigned int>> &objlist);
+  // maintenance decoding reads none of the group of the lost block
+  void excludeLostGroup(ECBase *ec, int lostidx, int ecn, int ecw, vector<int> &integrity, vector<int> &availcidx);
+  // plan the repair of the lost blocks of a stripe for batchRecovery, false if it cannot be repaired
+  bool planBatchStripe(string stripename, OfflineECPool *ecpool, vector<string> lostobjs,
+                       vector<unsigned int> failedIps, vector<unsigned int> aliveIps, RepairLoad &load,
+                       unordered_map<int, AGCommand *> &agCmds, vector<AGCommand *> &persistCmds, long &subBlockBytes,
+                       unordered_map<int, pair<string, unsigned int>> &objlist);
 
 public:
   Coordinator(Config *conf, StripeStore *ss);
   ~Coordinator();
 
+  // receive requests and hand them to the workers, planning for a stripe holds its lock in StripeStore
   void doProcess();
 
   void registerFile(CoorCommand *coorCmd);
@@ -64,6 +112,13 @@ public:
   // hard-code ip
   void recoveryOnlineHCIP(string filename);
   void recoveryOfflineHCIP(string filename);
+
+  // repair all the blocks of a failed node or rack, co-planning ec.concurrent.num stripes at a time
+  void batchRecovery(CoorCommand *coorCmd);
+  // open or close a maintenance window on a rack
+  void setMaintenance(CoorCommand *coorCmd);
+  // migrate a pool to the placement of another policy of the same code
+  void migratePool(CoorCommand *coorCmd);
 };
 
 #endif
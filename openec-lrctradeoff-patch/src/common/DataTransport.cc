@@ -0,0 +1,136 @@
+#include "DataTransport.hh"
+#include "TcpTransport.hh"
+
+// RPUSH replies a redis sender may leave unread
+#define REDISSENDER_WINDOW 32
+
+DataTransport *DataTransport::_transport = NULL;
+once_flag DataTransport::_initFlag;
+
+DataTransport *DataTransport::getTransport(Config *conf)
+{
+  call_once(_initFlag, [conf]
+            {
+    if (conf->_dataTransport == "tcp")
+    {
+      TcpTransport *tcp = new TcpTransport(conf->_localIp, conf->_dataPort, conf->_dataCredit, conf->_dataStoreMB);
+      if (!tcp->isListening())
+      {
+        // peers on tcp never fetch from Redis, so an agent that cannot serve on tcp cannot run
+        cerr << "DataTransport::getTransport: tcp cannot listen on " << RedisUtil::ip2Str(conf->_localIp) << ":" << conf->_dataPort << endl;
+        exit(1);
+      }
+      _transport = tcp;
+    }
+    else
+    {
+      _transport = new RedisTransport(conf->_localIp);
+    }
+    cout << "DataTransport::getTransport: " << conf->_dataTransport << endl; });
+  return _transport;
+}
+
+RedisSender::RedisSender(unsigned int ip)
+{
+  _ctx = RedisUtil::createContext(ip);
+  _count = 0;
+  _replied = 0;
+}
+
+RedisSender::~RedisSender()
+{
+  flush();
+  redisFree(_ctx);
+}
+
+void RedisSender::put(string key, OECDataPacket *pkt, int refs)
+{
+  int len = pkt->getDatalen();
+  if (!pkt->isView())
+  {
+    for (int k = 0; k < refs; k++)
+      redisAppendCommand(_ctx, "RPUSH %s %b", key.c_str(), pkt->getRaw(), len + 4);
+  }
+  else
+  {
+    // the header of a view is not in front of its data, so we format the command
+    // ourselves, with the header and the data written into it directly
+    string prefix = "*3\r\n$5\r\nRPUSH\r\n$" + to_string(key.size()) + "\r\n" + key + "\r\n$" + to_string(len + 4) + "\r\n";
+    int cmdlen = prefix.size() + 4 + len + 2;
+    char *cmd = (char *)malloc(cmdlen);
+    memcpy(cmd, prefix.c_str(), prefix.size());
+    pkt->getHeader(cmd + prefix.size());
+    memcpy(cmd + prefix.size() + 4, pkt->getData(), len);
+    memcpy(cmd + cmdlen - 2, "\r\n", 2);
+    for (int k = 0; k < refs; k++)
+      redisAppendFormattedCommand(_ctx, cmd, cmdlen);
+    free(cmd);
+  }
+  _count += refs;
+  delete pkt;
+
+  redisReply *rReply;
+  while (_count - _replied > REDISSENDER_WINDOW)
+  {
+    redisGetReply(_ctx, (void **)&rReply);
+    freeReplyObject(rReply);
+    _replied++;
+  }
+}
+
+void RedisSender::flush()
+{
+  redisReply *rReply;
+  while (_replied < _count)
+  {
+    redisGetReply(_ctx, (void **)&rReply);
+    freeReplyObject(rReply);
+    _replied++;
+  }
+}
+
+RedisTransport::RedisTransport(unsigned int localIp)
+{
+  _localIp = localIp;
+}
+
+DataSender *RedisTransport::createSender()
+{
+  return new RedisSender(_localIp);
+}
+
+bool RedisTransport::fetch(unsigned int ip, string keybase, string /* fetchid */, int start, int num, function<void(OECDataPacket *)> deliver)
+{
+  redisReply *rReply;
+  redisContext *fetchCtx;
+  try
+  {
+    fetchCtx = RedisUtil::createContext(ip);
+  }
+  catch (int e)
+  {
+    cerr << "RedisTransport::fetch cannot connect to " << RedisUtil::ip2Str(ip) << " for " << keybase << endl;
+    return false;
+  }
+
+  for (int i = start; i < num; i++)
+  {
+    string key = keybase + ":" + to_string(i);
+    redisAppendCommand(fetchCtx, "blpop %s 0", key.c_str());
+  }
+
+  for (int i = start; i < num; i++)
+  {
+    if (redisGetReply(fetchCtx, (void **)&rReply) != REDIS_OK)
+    {
+      cerr << "RedisTransport::fetch connection to " << RedisUtil::ip2Str(ip) << " broken for " << keybase << endl;
+      redisFree(fetchCtx);
+      return false;
+    }
+    char *content = rReply->element[1]->str;
+    deliver(new OECDataPacket(content));
+    freeReplyObject(rReply);
+  }
+  redisFree(fetchCtx);
+  return true;
+}
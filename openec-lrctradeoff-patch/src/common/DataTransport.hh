@@ -0,0 +1,84 @@
+#ifndef _DATATRANSPORT_HH_
+#define _DATATRANSPORT_HH_
+
+#include "Config.hh"
+#include "OECDataPacket.hh"
+
+#include "../inc/include.hh"
+#include "../util/RedisUtil.hh"
+
+#include <functional>
+
+using namespace std;
+
+/**
+ * Publishes packets of one producer thread, i.e., the cacheWorker role.
+ * Each packet is published under a key for refs fetches.
+ */
+class DataSender
+{
+public:
+  virtual ~DataSender() {}
+  // publish pkt under key for refs fetches, pkt is owned by the sender afterwards
+  virtual void put(string key, OECDataPacket *pkt, int refs) = 0;
+  // wait until all published packets are accepted
+  virtual void flush() = 0;
+};
+
+/**
+ * Data plane between agents. A packet published under a key by the agent at
+ * ip is fetched by other agents from ip with the same key, so each stage of a
+ * command maps onto it as before: readDisk and the cache workers publish, and
+ * the fetch workers fetch keybase:0 to keybase:num-1 in order.
+ *
+ * Only packets between agents go through the transport; the keys read and
+ * written by clients stay in the local Redis.
+ */
+class DataTransport
+{
+private:
+  static DataTransport *_transport;
+  static once_flag _initFlag;
+
+public:
+  virtual ~DataTransport() {}
+
+  // process-wide transport selected by oec.data.transport
+  static DataTransport *getTransport(Config *conf);
+
+  // a sender for the calling thread, deleted by the caller
+  virtual DataSender *createSender() = 0;
+  // fetch keybase:start to keybase:num-1 from the agent at ip, and hand each
+  // packet to deliver in order; false if the peer cannot be reached, after
+  // the packets delivered so far. fetchid names the fetch uniquely and is
+  // passed again when it resumes at the first packet not delivered
+  virtual bool fetch(unsigned int ip, string keybase, string fetchid, int start, int num, function<void(OECDataPacket *)> deliver) = 0;
+};
+
+class RedisSender : public DataSender
+{
+private:
+  redisContext *_ctx;
+  int _count;
+  int _replied;
+
+public:
+  RedisSender(unsigned int ip);
+  ~RedisSender();
+  void put(string key, OECDataPacket *pkt, int refs);
+  void flush();
+};
+
+// RPUSH to the local Redis, BLPOP from the Redis of the peer
+class RedisTransport : public DataTransport
+{
+private:
+  unsigned int _localIp;
+
+public:
+  RedisTransport(unsigned int localIp);
+  DataSender *createSender();
+  bool fetch(unsigned int ip, string keybase, string fetchid, int start, int num, function<void(OECDataPacket *)> deliver);
+};
+
+#endif
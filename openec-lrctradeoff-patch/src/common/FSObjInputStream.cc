@@ -6,7 +6,7 @@ FSObjInputStream::FSObjInputStream(Config *conf, string objname, UnderFS *fs)
   gettimeofday(&time1, NULL);
   _conf = conf;
   _objname = objname;
-  _queue = new BlockingQueue<OECDataPacket *>();
+  _queue = new SpscQueue<OECDataPacket *>(conf->_readQueueDepth, "read");
   _dataPktNum = 0;
 
   _underfs = fs;
@@ -59,31 +59,28 @@ void FSObjInputStream::readObj(int slicesize)
   while (true)
   {
     int hasread = 0;
-    char *buf = (char *)calloc(slicesize + 4, sizeof(char));
-    if (!buf)
-    {
-      cout << "FSObjInputStream::readObj.malloc buffer fail" << endl;
-      return;
-    }
+    OECDataPacket *curPkt = new OECDataPacket(slicesize, false);
+    char *buf = curPkt->getData();
     while (hasread < slicesize)
     {
-      int len = _underfs->readFile(_underfile, buf + 4 + hasread, slicesize - hasread);
+      int len = _underfs->readFile(_underfile, buf + hasread, slicesize - hasread);
       if (len == 0)
         break;
       hasread += len;
     }
 
-    // set hasread in the first 4 bytes of buf
-    int tmplen = htonl(hasread);
-    memcpy(buf, (char *)&tmplen, 4);
-
     if (hasread)
     {
-      OECDataPacket *curPkt = new OECDataPacket();
-      curPkt->setRaw(buf);
+      // zero the remaining bytes of a short read
+      memset(buf + hasread, 0, slicesize - hasread);
+      curPkt->setDatalen(hasread);
       _queue->push(curPkt);
       _dataPktNum++;
     }
+    else
+    {
+      delete curPkt;
+    }
     if (hasread <= 0)
       break;
   }
@@ -106,31 +103,28 @@ void FSObjInputStream::readObj()
   while (true)
   {
     int hasread = 0;
-    char *buf = (char *)calloc(_conf->_pktSize + 4, sizeof(char));
-    if (!buf)
-    {
-      cout << "FSObjInputStream::readObj.malloc buffer fail" << endl;
-      return;
-    }
+    OECDataPacket *curPkt = new OECDataPacket(_conf->_pktSize, false);
+    char *buf = curPkt->getData();
     while (hasread < _conf->_pktSize)
     {
-      int len = _underfs->readFile(_underfile, buf + 4 + hasread, _conf->_pktSize - hasread);
+      int len = _underfs->readFile(_underfile, buf + hasread, _conf->_pktSize - hasread);
       if (len == 0)
         break;
       hasread += len;
     }
 
-    // set hasread in the first 4 bytes of buf
-    int tmplen = htonl(hasread);
-    memcpy(buf, (char *)&tmplen, 4);
-
     if (hasread)
     {
-      OECDataPacket *curPkt = new OECDataPacket();
-      curPkt->setRaw(buf);
+      // zero the remaining bytes of a short read
+      memset(buf + hasread, 0, _conf->_pktSize - hasread);
+      curPkt->setDatalen(hasread);
       _queue->push(curPkt);
       _dataPktNum++;
     }
+    else
+    {
+      delete curPkt;
+    }
     if (hasread <= 0)
       break;
   }
@@ -170,32 +164,16 @@ void FSObjInputStream::readObj(int w, vector<int> list, int slicesize)
   while (stripeid < stripenum)
   {
     int start = stripeid * pktsize;
-    for (int i = 0; i < offsetlist.size(); i++)
+    // slices with consecutive offsets are read together and enqueued as views
+    int i = 0;
+    while (i < offsetlist.size())
     {
-      int offidx = offsetlist[i];
-      int slicestart = start + offidx * slicesize;
-      char *buf = (char *)calloc(slicesize + 4, sizeof(char));
-
-      int hasread = 0;
-      while (hasread < slicesize)
-      {
-        int len = _underfs->pReadFile(_underfile, slicestart + hasread, buf + 4 + hasread, slicesize - hasread);
-        if (len == 0)
-          break;
-        hasread += len;
-      }
-
-      // set hasread in the first 4 bytes of buf
-      int tmplen = htonl(hasread);
-      memcpy(buf, (char *)&tmplen, 4);
-
-      if (hasread)
-      {
-        OECDataPacket *curPkt = new OECDataPacket();
-        curPkt->setRaw(buf);
-        _queue->push(curPkt);
-        slicenum++;
-      }
+      int j = i + 1;
+      while (j < offsetlist.size() && offsetlist[j] == offsetlist[j - 1] + 1)
+        j++;
+      long slicestart = start + (long)offsetlist[i] * slicesize;
+      slicenum += readConsSlices(slicestart, j - i, slicesize, false);
+      i = j;
     }
     stripeid++;
   }
@@ -210,6 +188,40 @@ void FSObjInputStream::readObj(int w, vector<int> list, int slicesize)
   cout << "FSObjInputStream.readObj.duration = " << RedisUtil::duration(time1, time2) << " for " << _objname << ", totally " << slicenum << "slices" << endl;
 }
 
+int FSObjInputStream::readConsSlices(long slicestart, int num, int slicesize, bool sequential)
+{
+  int read_size = num * slicesize;
+  shared_ptr<char> read_cons_buf = OECDataPacket::allocShared(read_size, false);
+  char *buf = read_cons_buf.get();
+
+  int bytes_read = 0;
+  while (bytes_read < read_size)
+  {
+    int len = 0;
+    if (sequential)
+      len = _underfs->readFile(_underfile, buf + bytes_read, read_size - bytes_read);
+    else
+      len = _underfs->pReadFile(_underfile, slicestart + bytes_read, buf + bytes_read, read_size - bytes_read);
+    if (len == 0)
+      break;
+    bytes_read += len;
+  }
+
+  // zero the remaining bytes of a short read, the views of all slices share them
+  memset(buf + bytes_read, 0, read_size - bytes_read);
+  vector<OECDataPacket *> slices;
+  for (int i = 0; i < num; i++)
+  {
+    int curlen = min(slicesize, bytes_read - i * slicesize);
+    if (curlen <= 0)
+      break;
+    slices.push_back(new OECDataPacket(read_cons_buf, i * slicesize, curlen));
+  }
+  // the consumer is woken once for the slices of this read
+  _queue->pushBatch(slices.data(), slices.size());
+  return slices.size();
+}
+
 void FSObjInputStream::readObjOptimized(int w, vector<int> list, int slicesize)
 {
   if (w == 1)
@@ -284,59 +296,10 @@ void FSObjInputStream::readObjOptimized(int w, vector<int> list, int slicesize)
     for (auto cons_list : cons_read_list)
     {
       int offset_start = cons_list[0];
-      int slice_start = stripe_start + offset_start * slicesize;
+      long slice_start = stripe_start + (long)offset_start * slicesize;
       int num_cons_read_packets = cons_list.size();
-      int read_size = num_cons_read_packets * slicesize;
-      char *read_cons_buf = (char *)calloc(read_size, sizeof(char));
-
-      int bytes_read = 0;
-      while (bytes_read < read_size)
-      {
-        int len = 0;
-        if (num_cons_read_packets == w)
-        {
-          // if read the whole packet, resort to sequential instead
-          len = _underfs->readFile(_underfile, read_cons_buf + bytes_read, read_size - bytes_read);
-        }
-        else
-        {
-          // partial read
-          len = _underfs->pReadFile(_underfile, slice_start + bytes_read, read_cons_buf + bytes_read, read_size - bytes_read);
-        }
-
-        if (len == 0)
-          break;
-        bytes_read += len;
-      }
-
-      if (bytes_read % num_cons_read_packets != 0)
-      {
-        printf("error: undevisible sub-packets read, bytes_read: %d, num_cons_read_packets: %d\n", bytes_read, num_cons_read_packets);
-      }
-
-      int read_pkt_size = bytes_read / num_cons_read_packets;
-      if (read_pkt_size <= 0)
-      {
-        free(read_cons_buf);
-        continue;
-      }
-
-      for (int i = 0; i < num_cons_read_packets; i++)
-      {
-        char *pkt_buf = (char *)calloc(4 + slicesize, sizeof(char));
-        // set read_pkt_size in the first 4 bytes of pkt_buf
-        int tmplen = htonl(read_pkt_size);
-        memcpy(pkt_buf, (char *)&tmplen, 4);
-
-        // copy data to pkt_buf from read_cons_buf
-        memcpy(pkt_buf + 4, read_cons_buf + i * read_pkt_size, read_pkt_size * sizeof(char));
-
-        OECDataPacket *curPkt = new OECDataPacket();
-        curPkt->setRaw(pkt_buf);
-        _queue->push(curPkt);
-        slicenum++;
-      }
-      free(read_cons_buf);
+      // if read the whole packet, resort to sequential instead
+      slicenum += readConsSlices(slice_start, num_cons_read_packets, slicesize, num_cons_read_packets == w);
     }
     stripeid++;
   }
@@ -368,32 +331,29 @@ void FSObjInputStream::readObj(int slicesize, int unitIdx)
     int hasread = 0;
     long objoffset = pktnum * _conf->_pktSize + unitIdx * slicesize;
 
-    char *buf = (char *)calloc(slicesize + 4, sizeof(char));
-    if (!buf)
-    {
-      cout << "FSObjInputStream::readObj.malloc buffer fail" << endl;
-      return;
-    }
+    OECDataPacket *curPkt = new OECDataPacket(slicesize, false);
+    char *buf = curPkt->getData();
 
     while (hasread < slicesize)
     {
-      int len = _underfs->pReadFile(_underfile, objoffset + hasread, buf + 4 + hasread, slicesize - hasread);
+      int len = _underfs->pReadFile(_underfile, objoffset + hasread, buf + hasread, slicesize - hasread);
       if (len == 0)
         break;
       hasread += len;
     }
 
-    // set hasread in the first 4 bytes of buf
-    int tmplen = htonl(hasread);
-    memcpy(buf, (char *)&tmplen, 4);
-
     if (hasread)
     {
-      OECDataPacket *curPkt = new OECDataPacket();
-      curPkt->setRaw(buf);
+      // zero the remaining bytes of a short read
+      memset(buf + hasread, 0, slicesize - hasread);
+      curPkt->setDatalen(hasread);
       _queue->push(curPkt);
       pktnum++;
     }
+    else
+    {
+      delete curPkt;
+    }
 
     if (hasread <= 0)
       break;
@@ -438,7 +398,7 @@ int FSObjInputStream::pread(long objoffset, char *buffer, int buflen)
   return hasread;
 }
 
-BlockingQueue<OECDataPacket *> *FSObjInputStream::getQueue()
+SpscQueue<OECDataPacket *> *FSObjInputStream::getQueue()
 {
   return _queue;
 }
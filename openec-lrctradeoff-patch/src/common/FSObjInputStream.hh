@@ -2,7 +2,7 @@
 #define _FSOBJINPUTSTREAM_HH_
 
 #include <iomanip>
-#include "BlockingQueue.hh"
+#include "SpscQueue.hh"
 #include "OECDataPacket.hh"
 
 #include "../fs/UnderFS.hh"
@@ -14,7 +14,7 @@ class FSObjInputStream
 private:
   Config *_conf;
   string _objname;
-  BlockingQueue<OECDataPacket *> *_queue;
+  SpscQueue<OECDataPacket *> *_queue;
   int _dataPktNum;
   bool _exist;
   int _objbytes;
@@ -23,6 +23,10 @@ private:
   UnderFS *_underfs;
   UnderFile *_underfile;
 
+  // read num consecutive slices starting at slicestart into one shared buffer,
+  // and enqueue a view for each slice that has data, returns the slices enqueued
+  int readConsSlices(long slicestart, int num, int slicesize, bool sequential);
+
 public:
   FSObjInputStream(Config *conf, string objname, UnderFS *fs);
   ~FSObjInputStream();
@@ -35,7 +39,7 @@ public:
   bool exist();
   bool hasNext();
   int pread(long objoffset, char *buffer, int buflen);
-  BlockingQueue<OECDataPacket *> *getQueue();
+  SpscQueue<OECDataPacket *> *getQueue();
 };
 
 #endif
@@ -0,0 +1,119 @@
+#ifndef _INDEXEDHEAP_HH_
+#define _INDEXEDHEAP_HH_
+
+#include "../inc/include.hh"
+
+using namespace std;
+
+/**
+ * Binary max-heap of keys with a priority each, indexed by key.
+ *
+ * The position of every key in the heap is kept in a hash map, so that the
+ * priority of a key already in the heap is changed, and any key is removed,
+ * in O(log n) instead of a linear search. Keys of equal priority come out in
+ * no particular order, put a sequence number in the priority to break ties.
+ * The heap is not synchronized, the owner holds its own lock.
+ */
+template <class K, class P>
+class IndexedHeap {
+  private:
+    vector<pair<K, P>> _heap;
+    unordered_map<K, int> _pos;
+
+    void place(int i) {
+      _pos[_heap[i].first] = i;
+    }
+
+    void swapAt(int i, int j) {
+      swap(_heap[i], _heap[j]);
+      place(i);
+      place(j);
+    }
+
+    void siftUp(int i) {
+      while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!(_heap[parent].second < _heap[i].second)) break;
+        swapAt(i, parent);
+        i = parent;
+      }
+    }
+
+    void siftDown(int i) {
+      int size = _heap.size();
+      while (true) {
+        int largest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < size && _heap[largest].second < _heap[left].second) largest = left;
+        if (right < size && _heap[largest].second < _heap[right].second) largest = right;
+        if (largest == i) break;
+        swapAt(i, largest);
+        i = largest;
+      }
+    }
+
+  public:
+    bool empty() {
+      return _heap.empty();
+    }
+
+    int size() {
+      return _heap.size();
+    }
+
+    bool contains(K key) {
+      return _pos.find(key) != _pos.end();
+    }
+
+    // insert key, or move it to its new priority if it is in the heap
+    void push(K key, P priority) {
+      typename unordered_map<K, int>::iterator it = _pos.find(key);
+      if (it == _pos.end()) {
+        _heap.push_back(make_pair(key, priority));
+        place(_heap.size() - 1);
+        siftUp(_heap.size() - 1);
+        return;
+      }
+      int i = it->second;
+      _heap[i].second = priority;
+      siftUp(i);
+      siftDown(_pos[key]);
+    }
+
+    K top() {
+      return _heap[0].first;
+    }
+
+    P topPriority() {
+      return _heap[0].second;
+    }
+
+    K pop() {
+      K key = _heap[0].first;
+      erase(key);
+      return key;
+    }
+
+    void erase(K key) {
+      typename unordered_map<K, int>::iterator it = _pos.find(key);
+      if (it == _pos.end()) return;
+      int i = it->second;
+      int last = _heap.size() - 1;
+      if (i != last) swapAt(i, last);
+      _heap.pop_back();
+      _pos.erase(key);
+      if (i < _heap.size()) {
+        K moved = _heap[i].first;
+        siftUp(i);
+        siftDown(_pos[moved]);
+      }
+    }
+
+    void clear() {
+      _heap.clear();
+      _pos.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "LinkScheduler.hh"
+
+LinkScheduler::LinkScheduler(Config *conf)
+{
+  _conf = conf;
+  _bandwidth = 0;
+  if (_conf->_crossRackMbps > 0 && _conf->_linkWindowMs > 0)
+    _bandwidth = (double)_conf->_crossRackMbps * 1000000 / 8;
+  _window = (double)_conf->_linkWindowMs / 1000;
+  _nextId = 0;
+  _admitted = 0;
+  _delayed = 0;
+  _delaySum = 0;
+}
+
+unordered_map<string, double> LinkScheduler::demand(RepairLoad &load, long subBlockBytes)
+{
+  unordered_map<string, double> toret;
+  if (_bandwidth == 0)
+    return toret;
+  // a link is named by its rack, followed by > on the way out and preceded by > on the way in
+  for (auto item : load.getRackOut())
+    toret[item.first + ">"] += item.second * subBlockBytes / _bandwidth;
+  for (auto item : load.getRackIn())
+    toret[">" + item.first] += item.second * subBlockBytes / _bandwidth;
+  return toret;
+}
+
+unordered_map<string, double> LinkScheduler::demand(unordered_map<int, AGCommand *> agCmds, vector<AGCommand *> persistCmds, long subBlockBytes)
+{
+  RepairLoad load(_conf);
+  load.add(agCmds, persistCmds);
+  return demand(load, subBlockBytes);
+}
+
+void LinkScheduler::add(int id, unordered_map<string, double> demand)
+{
+  for (auto item : demand)
+    _reserved[item.first] += item.second;
+  _reservations.insert(make_pair(id, demand));
+}
+
+void LinkScheduler::remove(int id)
+{
+  auto it = _reservations.find(id);
+  if (it == _reservations.end())
+    return;
+  for (auto item : it->second)
+  {
+    _reserved[item.first] -= item.second;
+    // drop the rounding left over by the last reservation of a link
+    if (_reserved[item.first] < 1e-9)
+      _reserved.erase(item.first);
+  }
+  _reservations.erase(it);
+}
+
+void LinkScheduler::expire()
+{
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  for (auto it = _expiry.begin(); it != _expiry.end();)
+  {
+    if (it->second <= now)
+    {
+      remove(it->first);
+      it = _expiry.erase(it);
+    }
+    else
+    {
+      it++;
+    }
+  }
+}
+
+bool LinkScheduler::admissible(int id, unordered_map<string, double> demand)
+{
+  // an idle link admits a repair of any size, so that no repair waits forever
+  for (auto item : demand)
+  {
+    auto it = _reserved.find(item.first);
+    if (it != _reserved.end() && it->second + item.second > _window)
+      return false;
+  }
+  // a repair does not pass an earlier one that waits for a link it crosses
+  for (auto &waiter : _waiting)
+  {
+    if (waiter.first == id)
+      break;
+    for (auto item : demand)
+    {
+      if (waiter.second.find(item.first) != waiter.second.end())
+        return false;
+    }
+  }
+  return true;
+}
+
+int LinkScheduler::reserveRepair(unordered_map<string, double> demand)
+{
+  if (_bandwidth == 0 || demand.empty())
+    return -1;
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  unique_lock<mutex> lck(_lock);
+  int id = _nextId++;
+  _waiting.push_back(make_pair(id, demand));
+  bool delayed = false;
+  while (true)
+  {
+    expire();
+    if (admissible(id, demand))
+      break;
+    delayed = true;
+    // wake up when a reservation is released or the next degraded read expires
+    if (_expiry.empty())
+    {
+      _cond.wait(lck);
+    }
+    else
+    {
+      chrono::steady_clock::time_point next = _expiry.begin()->second;
+      for (auto item : _expiry)
+        next = min(next, item.second);
+      _cond.wait_until(lck, next);
+    }
+  }
+  for (auto it = _waiting.begin(); it != _waiting.end(); it++)
+  {
+    if (it->first == id)
+    {
+      _waiting.erase(it);
+      break;
+    }
+  }
+  add(id, demand);
+  gettimeofday(&time2, NULL);
+  _admitted++;
+  if (delayed)
+  {
+    _delayed++;
+    _delaySum += RedisUtil::duration(time1, time2);
+  }
+  // the repairs behind this one may cross other links
+  _cond.notify_all();
+  return id;
+}
+
+void LinkScheduler::reserveRead(unordered_map<string, double> demand)
+{
+  if (_bandwidth == 0 || demand.empty())
+    return;
+  double duration = 0;
+  for (auto item : demand)
+    duration = max(duration, item.second);
+  {
+    lock_guard<mutex> lck(_lock);
+    expire();
+    int id = _nextId++;
+    add(id, demand);
+    _expiry.insert(make_pair(id, chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(duration))));
+  }
+  // the waiting repairs wait for this read to expire too
+  _cond.notify_all();
+}
+
+void LinkScheduler::release(int id)
+{
+  if (id < 0)
+    return;
+  {
+    lock_guard<mutex> lck(_lock);
+    remove(id);
+  }
+  _cond.notify_all();
+}
+
+void LinkScheduler::dump()
+{
+  lock_guard<mutex> lck(_lock);
+  double maxReserved = 0;
+  string hotLink;
+  for (auto item : _reserved)
+  {
+    if (item.second > maxReserved)
+    {
+      maxReserved = item.second;
+      hotLink = item.first;
+    }
+  }
+  cout << "LinkScheduler::admitted = " << _admitted << ", delayed = " << _delayed
+       << ", delay.avg = " << (_delayed ? _delaySum / _delayed : 0)
+       << ", waiting = " << _waiting.size() << ", busiest link " << hotLink << " = " << maxReserved << " s" << endl;
+}
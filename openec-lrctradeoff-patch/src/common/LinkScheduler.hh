@@ -0,0 +1,81 @@
+#ifndef _LINKSCHEDULER_HH_
+#define _LINKSCHEDULER_HH_
+
+#include "Config.hh"
+#include "RepairLoad.hh"
+
+#include "../inc/include.hh"
+#include "../protocol/AGCommand.hh"
+#include "../util/RedisUtil.hh"
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+
+using namespace std;
+
+/**
+ * Reservations of the cross-rack links by the plans of the coordinator.
+ *
+ * Each rack has a link to the network core in each direction, with
+ * oec.link.crossrack.mbps of bandwidth. A plan reserves on every link it
+ * crosses the time its transfer takes there at full bandwidth, taken from
+ * the sub-blocks that its parsed commands move between racks. A repair is
+ * admitted while the links it crosses have at most oec.link.window.ms of
+ * transfer reserved with it, or when they are idle, and waits otherwise
+ * until the reservations that hold it back are released.
+ *
+ * A repair does not pass an earlier one that waits for a link it crosses.
+ *
+ * Degraded reads are in the foreground: they are admitted at once, even
+ * over the window, and their reservations hold back the repairs that wait.
+ * As the coordinator does not see a read finish, its reservation expires
+ * after its transfer time instead of being released.
+ */
+class LinkScheduler
+{
+private:
+  Config *_conf;
+  // bytes per second of a link, 0 disables the scheduling
+  double _bandwidth;
+  double _window;
+
+  mutex _lock;
+  condition_variable _cond;
+  int _nextId;
+  // seconds of transfer on each link, keyed by rack and direction
+  unordered_map<string, double> _reserved;
+  unordered_map<int, unordered_map<string, double>> _reservations;
+  // foreground reservations expire instead of being released
+  unordered_map<int, chrono::steady_clock::time_point> _expiry;
+  // repairs waiting for admission with their demand, in arrival order
+  list<pair<int, unordered_map<string, double>>> _waiting;
+
+  long _admitted;
+  long _delayed;
+  double _delaySum;
+
+  // the methods below are called with _lock held
+  void add(int id, unordered_map<string, double> demand);
+  void remove(int id);
+  // drop the expired foreground reservations
+  void expire();
+  bool admissible(int id, unordered_map<string, double> demand);
+
+public:
+  LinkScheduler(Config *conf);
+
+  // seconds of transfer the commands of a plan put on each link, with subBlockBytes in a sub-block
+  unordered_map<string, double> demand(unordered_map<int, AGCommand *> agCmds, vector<AGCommand *> persistCmds, long subBlockBytes);
+  unordered_map<string, double> demand(RepairLoad &load, long subBlockBytes);
+
+  // wait until a background repair is admitted, the id is released when the repair finishes
+  int reserveRepair(unordered_map<string, double> demand);
+  // admit a foreground degraded read at once
+  void reserveRead(unordered_map<string, double> demand);
+  void release(int id);
+
+  void dump();
+};
+
+#endif
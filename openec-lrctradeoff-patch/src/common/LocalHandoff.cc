@@ -0,0 +1,81 @@
+#include "LocalHandoff.hh"
+#include "TaskPool.hh"
+
+LocalHandoff *LocalHandoff::_handoff = NULL;
+once_flag LocalHandoff::_initFlag;
+
+LocalHandoff::LocalHandoff()
+{
+  _handed = 0;
+}
+
+LocalHandoff *LocalHandoff::getHandoff()
+{
+  call_once(_initFlag, []
+            { _handoff = new LocalHandoff(); });
+  return _handoff;
+}
+
+OECDataPacket *LocalHandoff::copy(OECDataPacket *pkt)
+{
+  int len = pkt->getDatalen();
+  OECDataPacket *curpkt = new OECDataPacket(len, false);
+  memcpy(curpkt->getData(), pkt->getData(), len);
+  return curpkt;
+}
+
+void LocalHandoff::put(string key, OECDataPacket *pkt, int refs)
+{
+  if (refs <= 0)
+  {
+    delete pkt;
+    return;
+  }
+  // the copies are made out of the lock
+  vector<OECDataPacket *> pktlist = {pkt};
+  for (int i = 1; i < refs; i++)
+    pktlist.push_back(copy(pkt));
+  {
+    lock_guard<mutex> lck(_lock);
+    deque<OECDataPacket *> &keylist = _store[key];
+    for (auto curpkt : pktlist)
+      keylist.push_back(curpkt);
+    _handed += refs;
+  }
+  _cond.notify_all();
+}
+
+OECDataPacket *LocalHandoff::take(string key)
+{
+  unique_lock<mutex> lck(_lock);
+  while (_store.find(key) == _store.end())
+  {
+    // let another worker of the pool run while we wait for the producer
+    lck.unlock();
+    TaskPool::beginBlocking();
+    lck.lock();
+    _cond.wait(lck, [&]
+               { return _store.find(key) != _store.end(); });
+    lck.unlock();
+    TaskPool::endBlocking();
+    lck.lock();
+  }
+  auto it = _store.find(key);
+  OECDataPacket *pkt = it->second.front();
+  it->second.pop_front();
+  if (it->second.empty())
+    _store.erase(it);
+  return pkt;
+}
+
+void LocalHandoff::fetch(string keybase, int num, function<void(OECDataPacket *)> deliver)
+{
+  for (int i = 0; i < num; i++)
+    deliver(take(keybase + ":" + to_string(i)));
+}
+
+void LocalHandoff::dump()
+{
+  lock_guard<mutex> lck(_lock);
+  cout << "LocalHandoff::handed = " << _handed << ", pending keys = " << _store.size() << endl;
+}
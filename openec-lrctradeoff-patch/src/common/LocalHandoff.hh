@@ -0,0 +1,55 @@
+#ifndef _LOCALHANDOFF_HH_
+#define _LOCALHANDOFF_HH_
+
+#include "OECDataPacket.hh"
+
+#include "../inc/include.hh"
+
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/**
+ * Process-wide handoff of packets between tasks of the same agent.
+ *
+ * When the coordinator places a task and the task that consumes its output
+ * on the same agent, the consumer has 0 as the location of that input, and
+ * the producer hands the packets over here instead of publishing them
+ * through the data transport. A packet published under a key for refs
+ * fetches is passed as is to the first fetch and copied for the others, so
+ * a single consumer takes the pointer the producer made, without a copy.
+ *
+ * Like the lists of the local Redis, a key holds packets until they are
+ * fetched, so the producer is not held back by a slow consumer.
+ */
+class LocalHandoff
+{
+private:
+  unordered_map<string, deque<OECDataPacket *>> _store;
+  mutex _lock;
+  condition_variable _cond;
+  long _handed;
+
+  static LocalHandoff *_handoff;
+  static once_flag _initFlag;
+
+  // wait until a packet is published under key and take it
+  OECDataPacket *take(string key);
+
+public:
+  LocalHandoff();
+
+  static LocalHandoff *getHandoff();
+  // a copy of pkt in a buffer of the packet pool
+  static OECDataPacket *copy(OECDataPacket *pkt);
+
+  // publish pkt under key for refs fetches, pkt is owned by the handoff afterwards
+  void put(string key, OECDataPacket *pkt, int refs);
+  // take keybase:0 to keybase:num-1 and hand each packet to deliver in order
+  void fetch(string keybase, int num, function<void(OECDataPacket *)> deliver);
+
+  void dump();
+};
+
+#endif
@@ -0,0 +1,410 @@
+#include "MetaLog.hh"
+
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// |crc|type|keylen|vallen|
+#define METALOG_RECORD_HEADER 16
+#define METALOG_FILE_HEADER 8
+
+MetaLog::MetaLog(Config *conf, string logPath, string snapshotPath)
+{
+  _conf = conf;
+  _logPath = logPath;
+  _snapshotPath = snapshotPath;
+  _appendedSeq = 0;
+  _committedSeq = 0;
+  _nextOrder = 0;
+  _resident = true;
+  _failed = false;
+  _stop = false;
+  _groups = 0;
+  _snapshots = 0;
+
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  load(_snapshotPath);
+  long valid = load(_logPath);
+
+  _fd = open(_logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (_fd < 0)
+  {
+    cerr << "MetaLog::open " << _logPath << " error " << strerror(errno) << endl;
+    exit(1);
+  }
+  int ret = 0;
+  if (valid < 0)
+  {
+    // a new log, or one without even a header
+    string header;
+    encodeHeader(header);
+    ret = ftruncate(_fd, 0);
+    if (ret == 0 && !writeAll(_fd, header))
+      ret = -1;
+    valid = header.size();
+  }
+  else
+  {
+    // cut off a record torn by a crash
+    struct stat st;
+    fstat(_fd, &st);
+    if (st.st_size > valid)
+    {
+      cout << "MetaLog::cut " << st.st_size - valid << " bytes off " << _logPath << endl;
+      ret = ftruncate(_fd, valid);
+    }
+  }
+  if (ret != 0)
+  {
+    cerr << "MetaLog::prepare " << _logPath << " error " << strerror(errno) << endl;
+    exit(1);
+  }
+  _logSize = valid;
+  gettimeofday(&time2, NULL);
+  cout << "MetaLog::load " << _state[METALOG_ENTRY].size() << " entries, " << _state[METALOG_STRIPE].size()
+       << " stripes, duration = " << RedisUtil::duration(time1, time2) << endl;
+
+  _flusher = thread([=]
+                    { flushLoop(); });
+}
+
+MetaLog::~MetaLog()
+{
+  {
+    lock_guard<mutex> lck(_lock);
+    _stop = true;
+  }
+  _pendingCond.notify_all();
+  _flusher.join();
+  close(_fd);
+}
+
+uint32_t MetaLog::crc32(const char *data, long len)
+{
+  static uint32_t table[256];
+  static once_flag tableFlag;
+  call_once(tableFlag, []
+            {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+      for (int j = 0; j < 8; j++)
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    } });
+  uint32_t crc = 0xffffffff;
+  for (long i = 0; i < len; i++)
+    crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffffffff;
+}
+
+void MetaLog::encodeHeader(string &buf)
+{
+  uint32_t header[2] = {METALOG_MAGIC, METALOG_VERSION};
+  buf.append((char *)header, METALOG_FILE_HEADER);
+}
+
+void MetaLog::encode(string &buf, int type, const string &key, const string &value)
+{
+  long offset = buf.size();
+  uint32_t header[4] = {0, (uint32_t)type, (uint32_t)key.size(), (uint32_t)value.size()};
+  buf.append((char *)header, METALOG_RECORD_HEADER);
+  buf.append(key);
+  buf.append(value);
+  uint32_t crc = crc32(&buf[offset + 4], buf.size() - offset - 4);
+  memcpy(&buf[offset], (char *)&crc, 4);
+}
+
+vector<pair<string, string>> MetaLog::ordered(const unordered_map<string, MetaValue> &state)
+{
+  vector<pair<long, const pair<const string, MetaValue> *>> items;
+  items.reserve(state.size());
+  for (auto &item : state)
+    items.push_back(make_pair(item.second._order, &item));
+  sort(items.begin(), items.end(), [](const pair<long, const pair<const string, MetaValue> *> &a, const pair<long, const pair<const string, MetaValue> *> &b)
+       { return a.first < b.first; });
+  vector<pair<string, string>> toret;
+  toret.reserve(items.size());
+  for (auto &item : items)
+    toret.push_back(make_pair(item.second->first, item.second->second._value));
+  return toret;
+}
+
+void MetaLog::set(int type, const string &key, const string &value)
+{
+  unordered_map<string, MetaValue>::iterator it = _state[type].find(key);
+  if (it == _state[type].end())
+  {
+    MetaValue metavalue;
+    metavalue._order = _nextOrder++;
+    metavalue._value = value;
+    _state[type].insert(make_pair(key, metavalue));
+  }
+  else
+  {
+    it->second._value = value;
+  }
+}
+
+long MetaLog::load(string path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  fstat(fd, &st);
+  long size = st.st_size;
+  if (size < METALOG_FILE_HEADER)
+  {
+    close(fd);
+    return -1;
+  }
+  char *base = (char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return -1;
+  madvise(base, size, MADV_SEQUENTIAL);
+
+  uint32_t *fileHeader = (uint32_t *)base;
+  if (fileHeader[0] != METALOG_MAGIC || fileHeader[1] != METALOG_VERSION)
+  {
+    munmap(base, size);
+    return -1;
+  }
+  long offset = METALOG_FILE_HEADER;
+  while (offset + METALOG_RECORD_HEADER <= size)
+  {
+    uint32_t header[4];
+    memcpy((char *)header, base + offset, METALOG_RECORD_HEADER);
+    long keylen = header[2];
+    long vallen = header[3];
+    long reclen = METALOG_RECORD_HEADER + keylen + vallen;
+    if (header[1] >= METALOG_TYPES || offset + reclen > size)
+      break;
+    if (crc32(base + offset + 4, reclen - 4) != header[0])
+      break;
+    char *key = base + offset + METALOG_RECORD_HEADER;
+    set(header[1], string(key, keylen), string(key + keylen, vallen));
+    offset += reclen;
+  }
+  munmap(base, size);
+  return offset;
+}
+
+bool MetaLog::writeAll(int fd, const string &buf)
+{
+  long offset = 0;
+  while (offset < buf.size())
+  {
+    long len = write(fd, buf.c_str() + offset, buf.size() - offset);
+    if (len < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      cerr << "MetaLog::write error " << strerror(errno) << endl;
+      return false;
+    }
+    offset += len;
+  }
+  return true;
+}
+
+bool MetaLog::append(int type, string key, string value)
+{
+  unique_lock<mutex> lck(_lock);
+  // records appended at startup are in the state the store is rebuilt from
+  if (_resident)
+    set(type, key, value);
+  encode(_pending, type, key, value);
+  long seq = ++_appendedSeq;
+  _pendingCond.notify_one();
+  // with fsync always, return once the group of this record is synced, or fails to be
+  if (_conf->_metaLogFsync == "always")
+    _committedCond.wait(lck, [&]
+                        { return _committedSeq >= seq || _failed; });
+  return !_failed;
+}
+
+void MetaLog::flushLoop()
+{
+  string policy = _conf->_metaLogFsync;
+  chrono::milliseconds interval(_conf->_metaLogFsyncMs);
+  long snapshotBytes = (long)_conf->_metaLogSnapshotMB * 1048576;
+  bool unsynced = false;
+  while (true)
+  {
+    string group;
+    long seq;
+    {
+      unique_lock<mutex> lck(_lock);
+      while (!_stop && _pending.empty())
+      {
+        if (unsynced && policy == "interval")
+        {
+          // sync what was written once no more records come within the interval
+          if (_pendingCond.wait_for(lck, interval) == cv_status::timeout && _pending.empty())
+          {
+            lck.unlock();
+            fdatasync(_fd);
+            unsynced = false;
+            lck.lock();
+          }
+        }
+        else
+        {
+          _pendingCond.wait(lck);
+        }
+      }
+      if (_pending.empty())
+        break;
+      group.swap(_pending);
+      seq = _appendedSeq;
+    }
+
+    // the records that arrived while the previous group was written go at once
+    bool written = writeAll(_fd, group);
+    if (written && policy == "always" && fdatasync(_fd) != 0)
+    {
+      cerr << "MetaLog::sync " << _logPath << " error " << strerror(errno) << endl;
+      written = false;
+    }
+    if (!written)
+    {
+      // cut the part of the group that made it, so that the records written after it can be read back
+      if (ftruncate(_fd, _logSize) != 0)
+        cerr << "MetaLog::cut " << _logPath << " error " << strerror(errno) << endl;
+      bool stop;
+      {
+        lock_guard<mutex> lck(_lock);
+        _pending.insert(0, group);
+        _failed = true;
+        stop = _stop;
+      }
+      _committedCond.notify_all();
+      if (stop)
+      {
+        cerr << "MetaLog::stop with " << _appendedSeq - _committedSeq << " records not written" << endl;
+        return;
+      }
+      this_thread::sleep_for(chrono::milliseconds(METALOG_RETRY_MS));
+      continue;
+    }
+    _logSize += group.size();
+    if (policy == "interval")
+      unsynced = true;
+    {
+      lock_guard<mutex> lck(_lock);
+      _committedSeq = seq;
+      _failed = false;
+      _groups++;
+    }
+    _committedCond.notify_all();
+
+    if (snapshotBytes > 0 && _logSize >= snapshotBytes)
+      snapshot();
+  }
+  if (policy != "none")
+    fdatasync(_fd);
+}
+
+void MetaLog::snapshot()
+{
+  // the flusher does not write to the log meanwhile, so the log holds nothing that the snapshot misses
+  MetaLogSource source;
+  {
+    lock_guard<mutex> lck(_lock);
+    source = _source;
+  }
+  if (!source)
+    return;
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  string tmpPath = _snapshotPath + ".tmp";
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    cerr << "MetaLog::open " << tmpPath << " error " << strerror(errno) << endl;
+    return;
+  }
+  // stream the records of the source, a chunk at a time, so that no copy of the metadata is held
+  string buf;
+  encodeHeader(buf);
+  long bytes = 0;
+  bool written = true;
+  source([&](int type, const string &key, const string &value)
+         {
+    if (!written)
+      return;
+    encode(buf, type, key, value);
+    if (buf.size() >= METALOG_SNAPSHOT_CHUNK)
+    {
+      written = writeAll(fd, buf);
+      bytes += buf.size();
+      buf.clear();
+    } });
+  if (written)
+  {
+    written = writeAll(fd, buf);
+    bytes += buf.size();
+  }
+  if (!written || fdatasync(fd) != 0)
+  {
+    cerr << "MetaLog::snapshot to " << tmpPath << " fails" << endl;
+    close(fd);
+    return;
+  }
+  close(fd);
+  if (rename(tmpPath.c_str(), _snapshotPath.c_str()) != 0)
+  {
+    cerr << "MetaLog::rename " << tmpPath << " error " << strerror(errno) << endl;
+    return;
+  }
+  // the rename is durable once its directory is synced, only then the log may be cut
+  size_t slash = _snapshotPath.rfind('/');
+  string dir = slash == string::npos ? "." : (slash == 0 ? "/" : _snapshotPath.substr(0, slash));
+  int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dirfd < 0 || fsync(dirfd) != 0)
+  {
+    cerr << "MetaLog::sync " << dir << " error " << strerror(errno) << endl;
+    if (dirfd >= 0)
+      close(dirfd);
+    return;
+  }
+  close(dirfd);
+
+  // records of the log are in the snapshot now, a crash before the cut replays them again
+  if (ftruncate(_fd, METALOG_FILE_HEADER) != 0)
+  {
+    cerr << "MetaLog::cut " << _logPath << " error " << strerror(errno) << endl;
+    return;
+  }
+  fdatasync(_fd);
+  _logSize = METALOG_FILE_HEADER;
+  _snapshots++;
+  gettimeofday(&time2, NULL);
+  cout << "MetaLog::snapshot of " << bytes << " bytes, duration = " << RedisUtil::duration(time1, time2) << endl;
+}
+
+vector<pair<string, string>> MetaLog::getState(int type)
+{
+  lock_guard<mutex> lck(_lock);
+  return ordered(_state[type]);
+}
+
+void MetaLog::setSource(MetaLogSource source)
+{
+  lock_guard<mutex> lck(_lock);
+  for (int type = 0; type < METALOG_TYPES; type++)
+    unordered_map<string, MetaValue>().swap(_state[type]);
+  _resident = false;
+  _source = source;
+}
+
+void MetaLog::dump()
+{
+  lock_guard<mutex> lck(_lock);
+  cout << "MetaLog::records = " << _committedSeq << ", groups = " << _groups << ", snapshots = " << _snapshots
+       << ", log size = " << _logSize << (_failed ? ", failing" : "") << endl;
+}
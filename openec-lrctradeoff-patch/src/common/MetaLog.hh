@@ -0,0 +1,121 @@
+#ifndef _METALOG_HH_
+#define _METALOG_HH_
+
+#include "Config.hh"
+
+#include "../inc/include.hh"
+#include "../util/RedisUtil.hh"
+
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+#define METALOG_MAGIC 0x4f45434d
+#define METALOG_VERSION 1
+
+// record types, the key of each type is given with it
+#define METALOG_ENTRY 1  // filename, SSEntry::toString
+#define METALOG_STRIPE 2 // "ecpoolid stripename", OfflineECPool::stripe2String
+#define METALOG_HDFS 3   // hdfs file, block name
+#define METALOG_PLACEMENT 4 // "ecpoolid stripename", ecid of the placement the stripe is migrated to
+#define METALOG_MIGRATION 5 // ecpoolid, ecid of the placement the pool is migrating to, empty once done
+#define METALOG_TYPES 6
+
+// wait before the flusher writes a group again after a write fails
+#define METALOG_RETRY_MS 1000
+// bytes of a snapshot encoded before they are written out
+#define METALOG_SNAPSHOT_CHUNK 4194304
+
+// takes a record of the current metadata, type, key and value
+typedef function<void(int, const string &, const string &)> MetaLogEmit;
+// gives every record of the current metadata to an emit
+typedef function<void(const MetaLogEmit &)> MetaLogSource;
+
+/**
+ * Write-ahead log of the metadata of the stripe store.
+ *
+ * Records are binary, |crc|type|keylen|vallen|key|value|, with the crc over
+ * the rest of the record, after a |magic|version| file header. A record sets
+ * the value of a key and the last record of a key wins. Appends are queued
+ * and written by a flusher thread, one write per group of the records that
+ * arrived while the previous group was written, and synced according to
+ * oec.metalog.fsync: "always" syncs every group before the appenders of the
+ * group return, "interval" syncs at most every oec.metalog.fsync.ms, and
+ * "none" leaves it to the OS. A group that fails to be written or synced is
+ * cut off the log and written again later, and the appends fail meanwhile.
+ *
+ * At startup the snapshot and then the log are read through mmap, up to the
+ * first torn or corrupt record, which is cut off the log, into the latest
+ * value of every key, in the order the keys were first set, so that the
+ * stripes of a pool come back in order. Those values are only kept until the
+ * stripe store is rebuilt from them and hands over its source. When the log
+ * grows over oec.metalog.snapshot.mb, the flusher streams the records of the
+ * source into a new snapshot, renames it over the old one and truncates the
+ * log. The store changes its metadata before it appends the record of the
+ * change, so a record in the log is never newer than the source.
+ */
+class MetaLog
+{
+private:
+  Config *_conf;
+  string _logPath;
+  string _snapshotPath;
+  int _fd;
+  long _logSize;
+
+  struct MetaValue
+  {
+    // keys are given back in the order of their first value
+    long _order;
+    string _value;
+  };
+  // latest value of each key, by record type, until setSource
+  unordered_map<string, MetaValue> _state[METALOG_TYPES];
+  long _nextOrder;
+  bool _resident;
+  // the records of snapshots, from setSource on
+  MetaLogSource _source;
+
+  mutex _lock;
+  condition_variable _pendingCond;
+  condition_variable _committedCond;
+  // encoded records that wait for the flusher
+  string _pending;
+  long _appendedSeq;
+  long _committedSeq;
+  // the last group failed to be written, it waits in _pending
+  bool _failed;
+  bool _stop;
+  thread _flusher;
+
+  long _groups;
+  long _snapshots;
+
+  static uint32_t crc32(const char *data, long len);
+  static void encodeHeader(string &buf);
+  static void encode(string &buf, int type, const string &key, const string &value);
+  static vector<pair<string, string>> ordered(const unordered_map<string, MetaValue> &state);
+  // called with _lock held, or before the flusher starts
+  void set(int type, const string &key, const string &value);
+  // apply the valid records of path to _state, the length of the valid prefix or -1 without a valid header
+  long load(string path);
+  bool writeAll(int fd, const string &buf);
+  void flushLoop();
+  void snapshot();
+
+public:
+  MetaLog(Config *conf, string logPath, string snapshotPath);
+  ~MetaLog();
+
+  // false if the log cannot be written at the moment, the record is kept and written once it can
+  bool append(int type, string key, string value);
+  // the latest values in the order their keys were first set, to rebuild the store at startup
+  vector<pair<string, string>> getState(int type);
+  // drop the values loaded at startup, snapshots are taken from source from then on
+  void setSource(MetaLogSource source);
+
+  void dump();
+};
+
+#endif
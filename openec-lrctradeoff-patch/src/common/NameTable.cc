@@ -0,0 +1,94 @@
+#include "NameTable.hh"
+
+NameTable::NameTable()
+{
+  _slots.assign(1024, NAMETABLE_NONE);
+}
+
+uint32_t NameTable::hashOf(const char *data, long len)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (long i = 0; i < len; i++)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool NameTable::equals(uint32_t id, const char *data, long len)
+{
+  uint64_t begin = id == 0 ? 0 : _ends[id - 1];
+  return _ends[id] - begin == len && memcmp(&_chars[begin], data, len) == 0;
+}
+
+uint64_t NameTable::probe(const char *data, long len, uint32_t hash)
+{
+  uint64_t mask = _slots.size() - 1;
+  uint64_t slot = hash & mask;
+  while (_slots[slot] != NAMETABLE_NONE)
+  {
+    uint32_t id = _slots[slot];
+    if (_hashes[id] == hash && equals(id, data, len))
+      break;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void NameTable::grow()
+{
+  vector<uint32_t> slots(_slots.size() * 2, NAMETABLE_NONE);
+  uint64_t mask = slots.size() - 1;
+  for (uint32_t id = 0; id < _hashes.size(); id++)
+  {
+    uint64_t slot = _hashes[id] & mask;
+    while (slots[slot] != NAMETABLE_NONE)
+      slot = (slot + 1) & mask;
+    slots[slot] = id;
+  }
+  _slots.swap(slots);
+}
+
+uint32_t NameTable::intern(const string &name)
+{
+  uint32_t hash = hashOf(name.c_str(), name.size());
+  uint64_t slot = probe(name.c_str(), name.size(), hash);
+  if (_slots[slot] != NAMETABLE_NONE)
+    return _slots[slot];
+
+  uint32_t id = _hashes.size();
+  assert(id != NAMETABLE_NONE);
+  _chars.insert(_chars.end(), name.begin(), name.end());
+  _ends.push_back(_chars.size());
+  _hashes.push_back(hash);
+  _slots[slot] = id;
+  // keep the load under 3/4, so that probes stay short
+  if (_hashes.size() * 4 > _slots.size() * 3)
+    grow();
+  return id;
+}
+
+uint32_t NameTable::find(const string &name)
+{
+  uint32_t hash = hashOf(name.c_str(), name.size());
+  return _slots[probe(name.c_str(), name.size(), hash)];
+}
+
+string NameTable::name(uint32_t id)
+{
+  uint64_t begin = id == 0 ? 0 : _ends[id - 1];
+  return string(&_chars[begin], _ends[id] - begin);
+}
+
+int NameTable::size()
+{
+  return _hashes.size();
+}
+
+long NameTable::memory()
+{
+  return _chars.capacity() + _ends.capacity() * sizeof(uint64_t) + _hashes.capacity() * sizeof(uint32_t) +
+         _slots.capacity() * sizeof(uint32_t);
+}
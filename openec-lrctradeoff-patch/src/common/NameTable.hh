@@ -0,0 +1,51 @@
+#ifndef _NAMETABLE_HH_
+#define _NAMETABLE_HH_
+
+#include "../inc/include.hh"
+
+#include <cstdint>
+
+using namespace std;
+
+#define NAMETABLE_NONE 0xffffffff
+
+/**
+ * Interned names with dense 32-bit ids, given in the order names come.
+ *
+ * The characters of all names are kept back to back in one arena, with the
+ * end offset and the hash of each name, and an open-addressing table with
+ * linear probing maps a name to its id. A name costs its characters and
+ * about 18 bytes, instead of a string and a hash node per map that holds
+ * it, and the owner keeps the values of a name in flat arrays by id.
+ * Names are never removed. The table is not synchronized.
+ */
+class NameTable
+{
+private:
+  vector<char> _chars;
+  // end of name id in _chars, the name starts at the end of id - 1
+  vector<uint64_t> _ends;
+  vector<uint32_t> _hashes;
+  // ids by hash, NAMETABLE_NONE for an empty slot, the size is a power of 2
+  vector<uint32_t> _slots;
+
+  static uint32_t hashOf(const char *data, long len);
+  bool equals(uint32_t id, const char *data, long len);
+  // the slot of name, or the empty slot where it goes
+  uint64_t probe(const char *data, long len, uint32_t hash);
+  void grow();
+
+public:
+  NameTable();
+
+  // the id of name, interned if it is new
+  uint32_t intern(const string &name);
+  // the id of name, NAMETABLE_NONE if it is not interned
+  uint32_t find(const string &name);
+  string name(uint32_t id);
+  int size();
+  // bytes held by the table
+  long memory();
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "OECDataPacket.hh"
+
+OECDataPacket::OECDataPacket() {
+  _len = 0;
+  _raw = NULL;
+  _data = NULL;
+  _block = NULL;
+  _blocksize = 0;
+}
+
+OECDataPacket::OECDataPacket(char* raw) {
+  int tmplen;
+  memcpy((char*)&tmplen, raw, 4);
+  allocRaw(ntohl(tmplen), false);
+  memcpy(_data, raw + 4, _len);
+}
+
+OECDataPacket::OECDataPacket(int len, bool zero) {
+  allocRaw(len, zero);
+}
+
+OECDataPacket::OECDataPacket(shared_ptr<char> buf, int offset, int len) {
+  _len = len;
+  _raw = NULL;
+  _data = buf.get() + offset;
+  _block = NULL;
+  _blocksize = 0;
+  _shared = buf;
+}
+
+OECDataPacket::~OECDataPacket() {
+  if (_block) {
+    PacketPool::getPool()->release(_block, _blocksize);
+  } else if (_raw) {
+    free(_raw);
+  }
+}
+
+shared_ptr<char> OECDataPacket::allocShared(int len, bool zero) {
+  int blocksize = PacketPool::getBlockSize(len);
+  char* block = PacketPool::getPool()->allocate(blocksize);
+  if (block == NULL) {
+    char* buf = (char*)malloc(len);
+    if (zero) memset(buf, 0, len);
+    return shared_ptr<char>(buf, free);
+  }
+  char* buf = PacketPool::getRaw(block) + 4;
+  if (zero) memset(buf, 0, len);
+  return shared_ptr<char>(buf, [block, blocksize](char*) {
+    PacketPool::getPool()->release(block, blocksize);
+  });
+}
+
+void OECDataPacket::allocRaw(int len, bool zero) {
+  _blocksize = PacketPool::getBlockSize(len);
+  _block = PacketPool::getPool()->allocate(_blocksize);
+  if (_block == NULL) {
+    // the pool cannot get an aligned block, fall back to an unpooled buffer
+    _blocksize = 0;
+    _raw = (char*)malloc(len + 4);
+    _data = _raw + 4;
+    setDatalen(len);
+    if (zero) memset(_data, 0, len);
+    return;
+  }
+  _raw = PacketPool::getRaw(_block);
+  _data = _raw + 4;
+  setDatalen(len);
+  if (zero) memset(_data, 0, len);
+}
+
+void OECDataPacket::setRaw(char* raw) {
+  _shared.reset();
+  if (_block) {
+    PacketPool::getPool()->release(_block, _blocksize);
+    _block = NULL;
+    _blocksize = 0;
+  } else if (_raw) {
+    free(_raw);
+  }
+  int tmplen;
+  memcpy((char*)&tmplen, raw, 4);
+  _len = ntohl(tmplen);
+  _raw = raw;
+  _data = _raw + 4;
+}
+
+void OECDataPacket::setDatalen(int len) {
+  _len = len;
+  if (_raw == NULL) return;
+  int tmplen = htonl(len);
+  memcpy(_raw, (char*)&tmplen, 4);
+}
+
+int OECDataPacket::getDatalen() {
+  return _len;
+}
+
+char* OECDataPacket::getData() {
+  return _data;
+}
+
+char* OECDataPacket::getRaw() {
+  if (isView()) {
+    // materialize the view with its header in front
+    char* viewdata = _data;
+    allocRaw(_len, false);
+    memcpy(_data, viewdata, _len);
+    _shared.reset();
+  }
+  return _raw;
+}
+
+bool OECDataPacket::isView() {
+  return _raw == NULL && _shared != nullptr;
+}
+
+void OECDataPacket::getHeader(char* hdr) {
+  int tmplen = htonl(_len);
+  memcpy(hdr, (char*)&tmplen, 4);
+}
@@ -0,0 +1,63 @@
+#ifndef _OECDATAPACKET_HH_
+#define _OECDATAPACKET_HH_
+
+#include "PacketPool.hh"
+
+#include "../inc/include.hh"
+
+#include <memory>
+
+using namespace std;
+
+/**
+ * raw = |len (4 bytes, network order)|data (len bytes)|
+ *
+ * Buffers created by the packet itself come from PacketPool, with the data
+ * 64-byte aligned. A buffer passed in by setRaw is calloc-ed by the caller
+ * and freed when the packet is deleted.
+ *
+ * A view packet references len bytes of a shared buffer (see allocShared)
+ * instead of owning one. Its header is not stored in front of the data but
+ * kept in _len, and written out by getHeader. getRaw on a view copies it into
+ * an owned buffer first, so callers that need a contiguous raw still work.
+ */
+class OECDataPacket {
+  private:
+    int _len;
+    char* _raw;
+    char* _data;
+
+    // pool block that holds _raw, NULL if _raw is owned through setRaw
+    char* _block;
+    int _blocksize;
+
+    // shared buffer referenced by a view, released with its last reference
+    shared_ptr<char> _shared;
+
+    void allocRaw(int len, bool zero);
+
+  public:
+    OECDataPacket();
+    OECDataPacket(char* raw);
+    // data is zero-filled unless zero is false
+    OECDataPacket(int len, bool zero = true);
+    // view of buf[offset, offset + len)
+    OECDataPacket(shared_ptr<char> buf, int offset, int len);
+    ~OECDataPacket();
+
+    // a 64-byte aligned buffer of len bytes to be sliced into views,
+    // zero-filled unless zero is false
+    static shared_ptr<char> allocShared(int len, bool zero = true);
+
+    void setRaw(char* raw);
+    // update the length in header, len should not exceed the allocated length
+    void setDatalen(int len);
+    int getDatalen();
+    char* getData();
+    char* getRaw();
+    bool isView();
+    // write the 4-byte header of this packet into hdr
+    void getHeader(char* hdr);
+};
+
+#endif
@@ -13,11 +13,21 @@ OECInputStream::~OECInputStream() {
 }
 
 void OECInputStream::init() {
+  // offer a shared-memory ring before the request, the local agent accepts it
+  // only if it runs on the same host
+  if (_conf->_clientShm)
+    _ring = ShmRing::offer(_conf->_clientShmSlots, _conf->_pktSize + 4);
+
   AGCommand* agCmd = new AGCommand();
-  agCmd->buildType1(1, _filename);
+  agCmd->buildType1(1, _filename, _ring ? _ring->getName() : "");
   agCmd->sendTo(_conf->_localIp);
   delete agCmd;
 
+  if (_ring) {
+    if (!ShmRing::waitAccept(_localCtx, _ring->getName())) _ring = nullptr;
+    else _ring->unlink();
+  }
+
   // wait for filesize?
   string wkey = "filesize:"+_filename;
   redisReply* rReply = (redisReply*)redisCommand(_localCtx, "blpop %s 0", wkey.c_str());
@@ -42,6 +52,30 @@ void OECInputStream::readWorker(BlockingQueue<OECDataPacket*>* readQueue, string
   redisReply* rReply;
   redisContext* readCtx = _localCtx;
 
+  if (_ring) {
+    // packets are used in place, and each slot is released with its packet
+    shared_ptr<ShmRing> ring = _ring;
+    for (int i=0; i<pktnum; i++) {
+      char* raw = ring->take(i);
+      if (ShmRing::isRedirect(raw)) {
+        // too large for a slot, the agent put it in redis
+        ring->release(i);
+        string key = keybase + ":" + to_string(i);
+        rReply = (redisReply*)redisCommand(readCtx, "blpop %s 0", key.c_str());
+        readQueue->push(new OECDataPacket(rReply->element[1]->str));
+        freeReplyObject(rReply);
+        continue;
+      }
+      int tmplen;
+      memcpy((char*)&tmplen, raw, 4);
+      shared_ptr<char> slot(raw, [ring, i](char*) { ring->release(i); });
+      readQueue->push(new OECDataPacket(slot, 4, ntohl(tmplen)));
+    }
+    gettimeofday(&end, NULL);
+    cout << "OECInputStream::readWorker.duration: " << RedisUtil::duration(start, end) << endl;
+    return;
+  }
+
   for (int i=0; i<pktnum; i++) {
     string key = keybase + ":" + to_string(i);
     redisAppendCommand(readCtx, "blpop %s 0", key.c_str());
@@ -4,6 +4,7 @@
 #include "BlockingQueue.hh"
 #include "Config.hh"
 #include "OECDataPacket.hh"
+#include "ShmRing.hh"
 
 #include "../inc/include.hh"
 #include "../protocol/AGCommand.hh"
@@ -20,6 +21,8 @@ class OECInputStream {
     BlockingQueue<OECDataPacket*>* _readQueue;
     int _filesizeMB;
     thread _collectThread;
+    // packets come through the ring if the local agent accepts it
+    shared_ptr<ShmRing> _ring;
   public:
     OECInputStream(Config* conf, 
                    string filename);
@@ -24,15 +24,28 @@ OECOutputStream::~OECOutputStream()
 
 void OECOutputStream::init()
 {
+  // offer a shared-memory ring before the request, the local agent accepts it
+  // only if it runs on the same host
+  if (_conf->_clientShm)
+    _ring = ShmRing::offer(_conf->_clientShmSlots, _conf->_pktSize + 4);
+
   /*
    *  tell local OECAgent that I want to write a file of size
    */
   AGCommand *agCmd = new AGCommand();
-  agCmd->buildType0(0, _filename, _ecidpool, _mode, _filesizeMB);
+  agCmd->buildType0(0, _filename, _ecidpool, _mode, _filesizeMB, _ring ? _ring->getName() : "");
   agCmd->sendTo(_conf->_localIp);
 
   // free
   delete agCmd;
+
+  if (_ring)
+  {
+    if (!ShmRing::waitAccept(_localCtx, _ring->getName()))
+      _ring = nullptr;
+    else
+      _ring->unlink();
+  }
 }
 
 void OECOutputStream::write(char *buf, int len)
@@ -41,8 +54,17 @@ void OECOutputStream::write(char *buf, int len)
    * OECOutputStream write packet to local redis in this format
    * |key = filename|
    * |value = |datalen|data|
+   * or into the next slot of the shared-memory ring, when it fits
    */
-  string key = _filename + ":" + to_string(_pktid++);
+  if (_ring && len <= _ring->getRawLen())
+  {
+    memcpy(_ring->acquire(_pktid), buf, len);
+    _ring->publish(_pktid++);
+    return;
+  }
+
+  int pktid = _pktid++;
+  string key = _filename + ":" + to_string(pktid);
   // pipelining
   redisAppendCommand(_localCtx, "RPUSH %s %b", key.c_str(), buf, len);
 
@@ -50,6 +72,10 @@ void OECOutputStream::write(char *buf, int len)
   redisReply *rReply;
   redisGetReply(_localCtx, (void **)&rReply);
   freeReplyObject(rReply);
+
+  // the agent reads the ring in order, point it to redis for this packet
+  if (_ring)
+    _ring->redirect(pktid);
 }
 
 void OECOutputStream::close()
@@ -2,6 +2,7 @@
 #define _OECOUTPUTSTREAM_HH_
 
 #include "Config.hh"
+#include "ShmRing.hh"
 
 #include "../inc/include.hh"
 #include "../protocol/AGCommand.hh"
@@ -19,6 +20,8 @@ class OECOutputStream {
     redisContext* _localCtx;
     int _pktid;
     int _replyid;
+    // packets go through the ring if the local agent accepts it
+    shared_ptr<ShmRing> _ring;
   public:
     OECOutputStream(Config* conf, string filename, string ecidpool, string mode, int filesizeMB);
     ~OECOutputStream();
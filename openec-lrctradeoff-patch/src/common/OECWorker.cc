@@ -1,5 +1,10 @@
 #include "OECWorker.hh"
 
+#include <unistd.h>
+
+once_flag OECWorker::_statsFlag;
+atomic<long> OECWorker::_fetchSeq(0);
+
 OECWorker::OECWorker(Config *conf) : _conf(conf)
 {
   // create local context
@@ -17,6 +22,21 @@ OECWorker::OECWorker(Config *conf) : _conf(conf)
 
   _underfs = FSUtil::createFS(_conf->_fsType, _conf->_fsFactory[_conf->_fsType], _conf);
 
+  // packet buffers are shared by all workers of the agent
+  PacketPool::getPool()->configure((long)_conf->_pktPoolSizeMB * 1048576, _conf->_pktPoolHugepage);
+  // so is the data plane to other agents
+  _transport = DataTransport::getTransport(_conf);
+  // and the handoff between its own tasks
+  _handoff = LocalHandoff::getHandoff();
+  // and the threads that run the stages of commands
+  _cpuPool = TaskPool::getCpuPool(_conf);
+  _ioPool = TaskPool::getIOPool(_conf);
+  if (_conf->_statsIntervalSec > 0)
+    call_once(_statsFlag, [=]
+              { thread([=]
+                       { statsLoop(); })
+                    .detach(); });
+
   // tune performance
   FSObjOutputStream *tuneobjout = new FSObjOutputStream(_conf, "/tmptuneoecout", _underfs, 0);
   delete tuneobjout;
@@ -32,6 +52,143 @@ OECWorker::~OECWorker()
   delete _underfs;
 }
 
+void OECWorker::prepareCodingPlans(vector<ECTask *> computeTasks,
+                                   vector<vector<int>> &taskTargets,
+                                   vector<shared_ptr<CodingPlan>> &taskPlans)
+{
+  // the coefficient matrix of a compute task is the same for every stripe,
+  // so we fix the order of targets and obtain the coding plan only once
+  for (int taskid = 0; taskid < computeTasks.size(); taskid++)
+  {
+    ECTask *compute = computeTasks[taskid];
+    int col = compute->getChildren().size();
+    unordered_map<int, vector<int>> coefMap = compute->getCoefMap();
+    int row = coefMap.size();
+    vector<int> targets;
+    shared_ptr<CodingPlan> plan = nullptr;
+    if (col * row >= 1)
+    {
+      int *matrix = (int *)calloc(row * col, sizeof(int));
+      for (auto it : coefMap)
+      {
+        vector<int> curcoef = it.second;
+        for (int j = 0; j < col; j++)
+        {
+          matrix[targets.size() * col + j] = curcoef[j];
+        }
+        targets.push_back(it.first);
+      }
+      plan = CodingPlan::getPlan(matrix, row, col);
+      free(matrix);
+    }
+    taskTargets.push_back(targets);
+    taskPlans.push_back(plan);
+  }
+}
+
+void OECWorker::acceptClientRing(string filename, int minslots)
+{
+  if (_clientShm.empty())
+    return;
+  redisContext *ringCtx = RedisUtil::createContext(_conf->_localIp);
+  shared_ptr<ShmRing> ring = ShmRing::accept(ringCtx, _clientShm, minslots);
+  redisFree(ringCtx);
+  if (ring)
+  {
+    cout << "OECWorker::acceptClientRing " << ring->getName() << " for " << filename << endl;
+    lock_guard<mutex> lck(_ringLock);
+    _clientRings[_clientShm + "|" + filename] = ring;
+  }
+}
+
+shared_ptr<ShmRing> OECWorker::getClientRing(string filename)
+{
+  if (_clientShm.empty())
+    return nullptr;
+  lock_guard<mutex> lck(_ringLock);
+  auto it = _clientRings.find(_clientShm + "|" + filename);
+  if (it == _clientRings.end())
+    return nullptr;
+  return it->second;
+}
+
+void OECWorker::closeClientRing(string filename)
+{
+  // packets still in use keep the ring mapped
+  lock_guard<mutex> lck(_ringLock);
+  _clientRings.erase(_clientShm + "|" + filename);
+}
+
+bool OECWorker::ringWorker(SpscQueue<OECDataPacket *> *writeQueue,
+                           string keybase,
+                           int startidx,
+                           int step,
+                           int num,
+                           int ref)
+{
+  shared_ptr<ShmRing> ring = getClientRing(keybase);
+  if (!ring || ref < 1)
+    return false;
+
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  redisContext *writeCtx = NULL;
+  redisReply *rReply;
+  for (int i = 0; i < num; i++)
+  {
+    int pktid = startidx + i * step;
+    OECDataPacket *curpkt = writeQueue->pop();
+    int rawlen = curpkt->getDatalen() + 4;
+    bool fit = rawlen <= ring->getRawLen();
+    int rediscopies = fit ? ref - 1 : ref;
+    if (rediscopies > 0)
+    {
+      if (!writeCtx)
+        writeCtx = RedisUtil::createContext("127.0.0.1");
+      string key = keybase + ":" + to_string(pktid);
+      for (int k = 0; k < rediscopies; k++)
+        redisAppendCommand(writeCtx, "RPUSH %s %b", key.c_str(), curpkt->getRaw(), rawlen);
+      for (int k = 0; k < rediscopies; k++)
+      {
+        redisGetReply(writeCtx, (void **)&rReply);
+        freeReplyObject(rReply);
+      }
+    }
+    if (fit)
+    {
+      char *raw = ring->acquire(pktid);
+      curpkt->getHeader(raw);
+      memcpy(raw + 4, curpkt->getData(), curpkt->getDatalen());
+      ring->publish(pktid);
+    }
+    else
+    {
+      // the client reads the ring in order, point it to redis for this packet
+      ring->redirect(pktid);
+    }
+    delete curpkt;
+  }
+  if (writeCtx)
+    redisFree(writeCtx);
+  gettimeofday(&time2, NULL);
+  cout << "OECWorker::ringWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
+  return true;
+}
+
+void OECWorker::statsLoop()
+{
+  // workers live as long as the agent
+  while (true)
+  {
+    this_thread::sleep_for(chrono::seconds(_conf->_statsIntervalSec));
+    PacketPool::getPool()->dump();
+    _handoff->dump();
+    QueueStats::dump();
+    _cpuPool->dump();
+    _ioPool->dump();
+  }
+}
+
 void OECWorker::doProcess()
 {
   redisReply *rReply;
@@ -58,35 +215,7 @@ void OECWorker::doProcess()
       int type = agCmd->getType();
       cout << "OECWorker::doProcess() receive a request of type " << type << endl;
       // agCmd->dump();
-      switch (type)
-      {
-      case 0:
-        clientWrite(agCmd);
-        break;
-      case 1:
-        clientRead(agCmd);
-        break;
-      case 2:
-        readDisk(agCmd);
-        break;
-      case 3:
-        fetchCompute(agCmd);
-        break;
-      case 5:
-        persist(agCmd);
-        break;
-        //        case 6: readDiskList(agCmd); break;
-      case 7:
-        readFetchCompute(agCmd);
-        break;
-
-      // for Shortening
-      case 12:
-        readDiskForShortening(agCmd);
-        break;
-      default:
-        break;
-      }
+      handleCommand(agCmd);
       //      gettimeofday(&time2, NULL);
       //      cout << "OECWorker::doProcess().duration = " << RedisUtil::duration(time1, time2) << endl;
       // delete agCmd
@@ -97,6 +226,63 @@ void OECWorker::doProcess()
   }
 }
 
+void OECWorker::handleCommand(AGCommand *agCmd)
+{
+  switch (agCmd->getType())
+  {
+  case 0:
+    clientWrite(agCmd);
+    break;
+  case 1:
+    clientRead(agCmd);
+    break;
+  case 2:
+    readDisk(agCmd);
+    break;
+  case 3:
+    fetchCompute(agCmd);
+    break;
+  case 5:
+    persist(agCmd);
+    break;
+    //        case 6: readDiskList(agCmd); break;
+  case 7:
+    readFetchCompute(agCmd);
+    break;
+
+  // for Shortening
+  case 12:
+    readDiskForShortening(agCmd);
+    break;
+  case 13:
+    runBatch(agCmd);
+    break;
+  default:
+    break;
+  }
+}
+
+void OECWorker::runBatch(AGCommand *agCmd)
+{
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+
+  // the tasks feed each other, so they all run at once as they would on separate workers
+  vector<AGCommand *> subCmds = agCmd->getSubCmds();
+  vector<TaskHandle> taskThreads = vector<TaskHandle>(subCmds.size());
+  for (int i = 0; i < subCmds.size(); i++)
+  {
+    AGCommand *subCmd = subCmds[i];
+    taskThreads[i] = _ioPool->submit([=]
+                                     { handleCommand(subCmd); });
+  }
+  for (int i = 0; i < subCmds.size(); i++)
+    taskThreads[i].join();
+
+  gettimeofday(&time2, NULL);
+  cout << "OECWorker::runBatch.duration: " << RedisUtil::duration(time1, time2) << " for " << subCmds.size() << " tasks of " << agCmd->getStripeName() << endl;
+}
+
 void OECWorker::clientWrite(AGCommand *agcmd)
 {
   cout << "OECWorker::clientWrite" << endl;
@@ -104,10 +290,12 @@ void OECWorker::clientWrite(AGCommand *agcmd)
   string ecid = agcmd->getEcid();
   string mode = agcmd->getMode();
   int filesizeMB = agcmd->getFilesizeMB();
+  _clientShm = agcmd->getShmName();
   if (mode == "online")
     onlineWrite(filename, ecid, filesizeMB);
   else if (mode == "offline")
     offlineWrite(filename, ecid, filesizeMB);
+  _clientShm = "";
 }
 
 void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
@@ -139,6 +327,9 @@ void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
   int computen = agCmd->getComputen();
   delete agCmd;
 
+  // a stripe needs eck packets of the client at the same time
+  acceptClientRing(filename, eck);
+
   unsigned long long filesizeBytes = (unsigned long long)filesizeMB * 1048576;
   int totalNumPkt = filesizeBytes / (unsigned long long)_conf->_pktSize;
   int totalNumRounds = totalNumPkt / eck;
@@ -164,12 +355,12 @@ void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
   cout << "OECWorker::onlineWrite.registerFile.duraiton = " << RedisUtil::duration(time1, time2) << endl;
 
   // 2. create threads for Load tasks to load data from local redis
-  BlockingQueue<OECDataPacket *> **loadQueue = (BlockingQueue<OECDataPacket *> **)calloc(eck, sizeof(BlockingQueue<OECDataPacket *> *));
+  SpscQueue<OECDataPacket *> **loadQueue = (SpscQueue<OECDataPacket *> **)calloc(eck, sizeof(SpscQueue<OECDataPacket *> *));
   for (int i = 0; i < eck; i++)
   {
-    loadQueue[i] = new BlockingQueue<OECDataPacket *>();
+    loadQueue[i] = new SpscQueue<OECDataPacket *>(_conf->_loadQueueDepth, "load");
   }
-  vector<thread> loadThreads = vector<thread>(eck);
+  vector<TaskHandle> loadThreads = vector<TaskHandle>(eck);
   for (int i = 0; i < eck; i++)
   {
     int curnum = totalNumRounds;
@@ -178,13 +369,13 @@ void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
       curnum = curnum + 1;
     if (lastNum > 0 && i >= lastNum)
       curzero = true;
-    loadThreads[i] = thread([=]
-                            { loadWorker(loadQueue[i], filename, i, eck, curnum, curzero); });
+    loadThreads[i] = _ioPool->submit([=]
+                                     { loadWorker(loadQueue[i], filename, i, eck, curnum, curzero); });
   }
 
   // 3. create threads for Persist tasks to persist data to DSS
   FSObjOutputStream **objstreams = (FSObjOutputStream **)calloc(ecn, sizeof(FSObjOutputStream *));
-  vector<thread> createThreads = vector<thread>(ecn);
+  vector<TaskHandle> createThreads = vector<TaskHandle>(ecn);
   for (int i = 0; i < ecn; i++)
   {
     // figure out number of pkts to persist for this stream
@@ -194,26 +385,26 @@ void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
     if (lastNum > 0 && i >= eck)
       curnum = curnum + 1;
     string objname = filename + "_oecobj_" + to_string(i);
-    createThreads[i] = thread([=]
-                              { objstreams[i] = new FSObjOutputStream(_conf, objname, _underfs, curnum); });
+    createThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i] = new FSObjOutputStream(_conf, objname, _underfs, curnum); });
   }
   // join create thread
   for (int i = 0; i < ecn; i++)
     createThreads[i].join();
 
-  vector<thread> persistThreads = vector<thread>(ecn);
+  vector<TaskHandle> persistThreads = vector<TaskHandle>(ecn);
   for (int i = 0; i < ecn; i++)
   {
-    persistThreads[i] = thread([=]
-                               { objstreams[i]->writeObj(); });
+    persistThreads[i] = _ioPool->submit([=]
+                                        { objstreams[i]->writeObj(); });
   }
 
   // 4. create thread to do calculation in iterations
   int stripenum = totalNumRounds;
   if (lastNum > 0)
     stripenum = totalNumRounds + 1;
-  thread computeThread([=]
-                       { computeWorker(computeTasks, loadQueue, objstreams, stripenum, ecn, eck, ecw); });
+  TaskHandle computeThread = _cpuPool->submit([=]
+                                              { computeWorker(computeTasks, loadQueue, objstreams, stripenum, ecn, eck, ecw); });
 
   // join
   for (int i = 0; i < eck; i++)
@@ -257,6 +448,7 @@ void OECWorker::onlineWrite(string filename, string ecid, int filesizeMB)
   free(objstreams);
   for (auto compute : computeTasks)
     delete compute;
+  closeClientRing(filename);
 
   // finalize writing offline-encoded file
   CoorCommand *coorCmd1 = new CoorCommand();
@@ -269,6 +461,8 @@ void OECWorker::offlineWrite(string filename, string ecpoolid, int filesizeMB)
 {
   struct timeval time1, time2, time3, time4;
 
+  acceptClientRing(filename, 1);
+
   // 0. send request to coordinator that I want to write a file with offline erasure coding
   //    wait for responses from coordinator with a set of tasks
   gettimeofday(&time1, NULL);
@@ -312,14 +506,14 @@ void OECWorker::offlineWrite(string filename, string ecpoolid, int filesizeMB)
   }
   // 2. create outputstream for each obj
   FSObjOutputStream **objstreams = (FSObjOutputStream **)calloc(objnum, sizeof(FSObjOutputStream *));
-  vector<thread> createThreads = vector<thread>(objnum);
+  vector<TaskHandle> createThreads = vector<TaskHandle>(objnum);
   for (int i = 0; i < objnum; i++)
   {
     // figure out number of pkts to persist for this stream
     int curnum = pktnums[i];
     string objname = filename + "_oecobj_" + to_string(i);
-    createThreads[i] = thread([=]
-                              { objstreams[i] = new FSObjOutputStream(_conf, objname, _underfs, curnum); });
+    createThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i] = new FSObjOutputStream(_conf, objname, _underfs, curnum); });
   }
   for (int i = 0; i < objnum; i++)
     createThreads[i].join();
@@ -331,22 +525,22 @@ void OECWorker::offlineWrite(string filename, string ecpoolid, int filesizeMB)
   }
 
   // 3. create loadThreads
-  vector<thread> loadThreads = vector<thread>(objnum);
+  vector<TaskHandle> loadThreads = vector<TaskHandle>(objnum);
   int startid = 0;
   for (int i = 0; i < objnum; i++)
   {
     int curnum = pktnums[i];
-    loadThreads[i] = thread([=]
-                            { loadWorker(loadQueue[i], filename, startid, 1, curnum, false); });
+    loadThreads[i] = _ioPool->submit([=]
+                                     { loadWorker(loadQueue[i], filename, startid, 1, curnum, false); });
     startid += curnum;
   }
 
   // 4. create persistThreads
-  vector<thread> persistThreads = vector<thread>(objnum);
+  vector<TaskHandle> persistThreads = vector<TaskHandle>(objnum);
   for (int i = 0; i < objnum; i++)
   {
-    persistThreads[i] = thread([=]
-                               { objstreams[i]->writeObj(); });
+    persistThreads[i] = _ioPool->submit([=]
+                                        { objstreams[i]->writeObj(); });
   }
 
   // join
@@ -385,6 +579,7 @@ void OECWorker::offlineWrite(string filename, string ecpoolid, int filesizeMB)
     delete objstreams[i];
   free(objstreams);
   free(loadQueue);
+  closeClientRing(filename);
 
   // finalize writing offline-encoded file
   CoorCommand *coorCmd1 = new CoorCommand();
@@ -393,7 +588,8 @@ void OECWorker::offlineWrite(string filename, string ecpoolid, int filesizeMB)
   delete coorCmd1;
 }
 
-void OECWorker::loadWorker(BlockingQueue<OECDataPacket *> *readQueue,
+template <class Queue>
+void OECWorker::loadWorker(Queue *readQueue,
                            string keybase,
                            int startid,
                            int step,
@@ -407,6 +603,38 @@ void OECWorker::loadWorker(BlockingQueue<OECDataPacket *> *readQueue,
   cout << ", zeropadding = " << zeropadding << endl;
   struct timeval time1, time2, time3;
   gettimeofday(&time1, NULL);
+  shared_ptr<ShmRing> ring = getClientRing(keybase);
+  if (ring)
+  {
+    // use packets in the ring in place, each slot is released with its packet
+    for (int i = 0; i < round; i++)
+    {
+      int curidx = startid + i * step;
+      char *raw = ring->take(curidx);
+      if (ShmRing::isRedirect(raw))
+      {
+        // too large for a slot, the client put it in redis
+        ring->release(curidx);
+        redisContext *readCtx = RedisUtil::createContext(_conf->_localIp);
+        string key = keybase + ":" + to_string(curidx);
+        redisReply *rReply = (redisReply *)redisCommand(readCtx, "blpop %s 0", key.c_str());
+        readQueue->push(new OECDataPacket(rReply->element[1]->str));
+        freeReplyObject(rReply);
+        redisFree(readCtx);
+        continue;
+      }
+      int tmplen;
+      memcpy((char *)&tmplen, raw, 4);
+      shared_ptr<char> slot(raw, [ring, curidx](char *)
+                            { ring->release(curidx); });
+      readQueue->push(new OECDataPacket(slot, 4, ntohl(tmplen)));
+    }
+    if (zeropadding)
+      readQueue->push(new OECDataPacket(_conf->_pktSize));
+    gettimeofday(&time2, NULL);
+    cout << "OECWorker::loadWorker.from client ring.duration = " << RedisUtil::duration(time1, time2) << endl;
+    return;
+  }
   // read from redis
   redisContext *readCtx = RedisUtil::createContext(_conf->_localIp);
   int startidx = startid;
@@ -429,13 +657,8 @@ void OECWorker::loadWorker(BlockingQueue<OECDataPacket *> *readQueue,
   if (zeropadding)
   {
     // create a packet that contains all zero
-    char *content = (char *)calloc(_conf->_pktSize + 4, sizeof(char));
-    memset(content, 0, _conf->_pktSize + 4);
-    int tmplen = htonl(_conf->_pktSize);
-    memcpy(content, (char *)&tmplen, 4);
-    OECDataPacket *pkt = new OECDataPacket(content);
+    OECDataPacket *pkt = new OECDataPacket(_conf->_pktSize);
     readQueue->push(pkt);
-    free(content);
   }
   redisFree(readCtx);
   gettimeofday(&time2, NULL);
@@ -445,7 +668,7 @@ void OECWorker::loadWorker(BlockingQueue<OECDataPacket *> *readQueue,
 void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
                                              vector<int> idlist,
                                              unordered_map<int, vector<int>> sid2Cids,
-                                             BlockingQueue<OECDataPacket *> *writeQueue,
+                                             SpscQueue<OECDataPacket *> *writeQueue,
                                              int lostidx,
                                              vector<ECTask *> computeTasks,
                                              int stripenum,
@@ -478,6 +701,11 @@ void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
     cout << endl;
   }
 
+  // coding plans are fixed for all stripes
+  vector<vector<int>> taskTargets;
+  vector<shared_ptr<CodingPlan>> taskPlans;
+  prepareCodingPlans(computeTasks, taskTargets, taskPlans);
+
   gettimeofday(&start, NULL);
 
   for (int stripeid = 0; stripeid < stripenum; stripeid++)
@@ -531,14 +759,12 @@ void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
       // for (auto child : children) {
       //   printf("%d ", child);
       // }
-      unordered_map<int, vector<int>> coefMap = compute->getCoefMap();
+      vector<int> targets = taskTargets[taskid];
       int col = children.size();
-      int row = coefMap.size();
-      vector<int> targets;
+      int row = targets.size();
       // here xiaolu modify > to >=
       if (col * row >= 1)
       {
-        int *matrix = (int *)calloc(row * col, sizeof(int));
         char **data = (char **)calloc(col, sizeof(char *));
         char **code = (char **)calloc(row, sizeof(char *));
 
@@ -561,10 +787,9 @@ void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
           data[bufIdx] = bufMap[child];
         }
         // prepare the code buf
-        int codeBufIdx = 0;
-        for (auto it : coefMap)
+        for (int codeBufIdx = 0; codeBufIdx < row; codeBufIdx++)
         {
-          int target = it.first;
+          int target = targets[codeBufIdx];
           char *codebuf;
           if (bufMap.find(target) == bufMap.end())
           {
@@ -576,17 +801,9 @@ void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
             codebuf = bufMap[target];
           }
           code[codeBufIdx] = codebuf;
-          targets.push_back(target);
-          vector<int> curcoef = it.second;
-          for (int j = 0; j < col; j++)
-          {
-            matrix[codeBufIdx * col + j] = curcoef[j];
-          }
-          codeBufIdx++;
         }
         // perform compute operation
-        Computation::Multi(code, data, matrix, row, col, splitsize, "Isal");
-        free(matrix);
+        taskPlans[taskid]->encode(code, data, splitsize, _conf->_computeTileSize, _conf->_computeThreadNum);
         free(code);
         free(data);
       }
@@ -652,7 +869,7 @@ void OECWorker::computeWorkerDegradedOffline(FSObjInputStream **readStreams,
 
 void OECWorker::computeWorker(FSObjInputStream **readStreams,
                               vector<int> idlist,
-                              BlockingQueue<OECDataPacket *> *writeQueue,
+                              SpscQueue<OECDataPacket *> *writeQueue,
                               vector<ECTask *> computeTasks,
                               int stripenum,
                               int ecn,
@@ -667,6 +884,12 @@ void OECWorker::computeWorker(FSObjInputStream **readStreams,
   for (int i = 0; i < ecn; i++)
     curStripe[i] = NULL;
   int splitsize = _conf->_pktSize / ecw;
+
+  // coding plans are fixed for all stripes
+  vector<vector<int>> taskTargets;
+  vector<shared_ptr<CodingPlan>> taskPlans;
+  prepareCodingPlans(computeTasks, taskTargets, taskPlans);
+
   for (int stripeid = 0; stripeid < stripenum; stripeid++)
   {
     // cout << "computeWorker::stripeid: " << stripeid << endl;
@@ -707,14 +930,12 @@ void OECWorker::computeWorker(FSObjInputStream **readStreams,
     {
       ECTask *compute = computeTasks[taskid];
       vector<int> children = compute->getChildren();
-      unordered_map<int, vector<int>> coefMap = compute->getCoefMap();
+      vector<int> targets = taskTargets[taskid];
       int col = children.size();
-      int row = coefMap.size();
-      vector<int> targets;
+      int row = targets.size();
       // here xiaolu modify > to >=
       if (col * row >= 1)
       {
-        int *matrix = (int *)calloc(row * col, sizeof(int));
         char **data = (char **)calloc(col, sizeof(char *));
         char **code = (char **)calloc(row, sizeof(char *));
 
@@ -728,10 +949,9 @@ void OECWorker::computeWorker(FSObjInputStream **readStreams,
           data[bufIdx] = bufMap[child];
         }
         // prepare the code buf
-        int codeBufIdx = 0;
-        for (auto it : coefMap)
+        for (int codeBufIdx = 0; codeBufIdx < row; codeBufIdx++)
         {
-          int target = it.first;
+          int target = targets[codeBufIdx];
           char *codebuf;
           if (bufMap.find(target) == bufMap.end())
           {
@@ -743,16 +963,11 @@ void OECWorker::computeWorker(FSObjInputStream **readStreams,
             codebuf = bufMap[target];
           }
           code[codeBufIdx] = codebuf;
-          targets.push_back(target);
-          vector<int> curcoef = it.second;
-          for (int j = 0; j < col; j++)
-          {
-            matrix[codeBufIdx * col + j] = curcoef[j];
-          }
-          codeBufIdx++;
         }
         // perform compute operation
-        Computation::Multi(code, data, matrix, row, col, splitsize, "Isal");
+        taskPlans[taskid]->encode(code, data, splitsize, _conf->_computeTileSize, _conf->_computeThreadNum);
+        free(code);
+        free(data);
       }
       // check whether there is a need to discuss about row*col = 1
     }
@@ -793,7 +1008,7 @@ void OECWorker::computeWorker(FSObjInputStream **readStreams,
 }
 
 void OECWorker::computeWorker(vector<ECTask *> computeTasks,
-                              BlockingQueue<OECDataPacket *> **readQueue,
+                              SpscQueue<OECDataPacket *> **readQueue,
                               FSObjOutputStream **objstreams,
                               int stripenum,
                               int ecn,
@@ -817,6 +1032,11 @@ void OECWorker::computeWorker(vector<ECTask *> computeTasks,
        << ", eck: " << eck
        << ", ecw: " << ecw << endl;
 
+  // coding plans are fixed for all stripes
+  vector<vector<int>> taskTargets;
+  vector<shared_ptr<CodingPlan>> taskPlans;
+  prepareCodingPlans(computeTasks, taskTargets, taskPlans);
+
   for (int stripeid = 0; stripeid < stripenum; stripeid++)
   {
     for (int pktidx = 0; pktidx < eck; pktidx++)
@@ -862,10 +1082,9 @@ void OECWorker::computeWorker(vector<ECTask *> computeTasks,
         cout << endl;
       }
 
-      unordered_map<int, vector<int>> coefMap = compute->getCoefMap();
-
       if (stripeid == 0)
       {
+        unordered_map<int, vector<int>> coefMap = compute->getCoefMap();
         cout << "coef: " << endl;
         for (auto item : coefMap)
         {
@@ -878,13 +1097,12 @@ void OECWorker::computeWorker(vector<ECTask *> computeTasks,
         }
       }
 
+      vector<int> targets = taskTargets[taskid];
       int col = children.size();
-      int row = coefMap.size();
-      vector<int> targets;
+      int row = targets.size();
       // here xiaolu modify > to >=
       if (col * row >= 1)
       {
-        int *matrix = (int *)calloc(row * col, sizeof(int));
         char **data = (char **)calloc(col, sizeof(char *));
         char **code = (char **)calloc(row, sizeof(char *));
 
@@ -911,10 +1129,9 @@ void OECWorker::computeWorker(vector<ECTask *> computeTasks,
           }
         }
         // prepare the code buf
-        int codeBufIdx = 0;
-        for (auto it : coefMap)
+        for (int codeBufIdx = 0; codeBufIdx < row; codeBufIdx++)
         {
-          int target = it.first;
+          int target = targets[codeBufIdx];
           char *codebuf;
           if (bufMap.find(target) == bufMap.end())
           {
@@ -930,32 +1147,11 @@ void OECWorker::computeWorker(vector<ECTask *> computeTasks,
               cout << "code[" << codeBufIdx << "] = bufMap[" << target << "]" << endl;
           }
           code[codeBufIdx] = codebuf;
-
-          targets.push_back(target);
-          vector<int> curcoef = it.second;
-          for (int j = 0; j < col; j++)
-          {
-            matrix[codeBufIdx * col + j] = curcoef[j];
-          }
-          codeBufIdx++;
-        }
-        if (stripeid == 0)
-        {
-          cout << "matrix: " << endl;
-          for (int ii = 0; ii < row; ii++)
-          {
-            for (int jj = 0; jj < col; jj++)
-            {
-              cout << matrix[ii * col + jj] << " ";
-            }
-            cout << endl;
-          }
         }
         // perform compute operation
-        Computation::Multi(code, data, matrix, row, col, splitsize, "Isal");
+        taskPlans[taskid]->encode(code, data, splitsize, _conf->_computeTileSize, _conf->_computeThreadNum);
         free(code);
         free(data);
-        free(matrix);
       }
       // check whether there is a need to discuss about row*col = 1
     }
@@ -1015,6 +1211,7 @@ void OECWorker::readDisk(AGCommand *agcmd)
   vector<int> cidlist = agcmd->getReadCidList();
   sort(cidlist.begin(), cidlist.end());
   unordered_map<int, int> refs = agcmd->getCacheRefs();
+  unordered_map<int, int> localRefs = agcmd->getLocalRefs();
 
   int pktsize = _conf->_pktSize;
   int slicesize = pktsize / w;
@@ -1032,30 +1229,32 @@ void OECWorker::readDisk(AGCommand *agcmd)
   {
     // serail read
     // read data in serial from disk
-    thread readThread = thread([=]
-                               { objstream->readObj(slicesize); });
-    BlockingQueue<OECDataPacket *> *readQueue = objstream->getQueue();
+    TaskHandle readThread = _ioPool->submit([=]
+                                            { objstream->readObj(slicesize); });
+    SpscQueue<OECDataPacket *> *readQueue = objstream->getQueue();
     // cacheThread
-    thread cacheThread = thread([=]
-                                { selectCacheWorker(readQueue, num, stripename, w, cidlist, refs); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { selectCacheWorker(readQueue, num, stripename, w, cidlist, refs, localRefs); });
 
-    // join
-    readThread.join();
+    // join, and let the reader finish past the slices the cache thread takes
     cacheThread.join();
+    readQueue->release();
+    readThread.join();
   }
   else
   {
     // random read
-    thread readThread = thread([=]
-                               { objstream->readObj(w, cidlist, slicesize); });
-    BlockingQueue<OECDataPacket *> *readQueue = objstream->getQueue();
+    TaskHandle readThread = _ioPool->submit([=]
+                                            { objstream->readObj(w, cidlist, slicesize); });
+    SpscQueue<OECDataPacket *> *readQueue = objstream->getQueue();
     // cacheThrad
-    thread cacheThread = thread([=]
-                                { partialCacheWorker(readQueue, num, stripename, w, cidlist, refs); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { partialCacheWorker(readQueue, num, stripename, w, cidlist, refs, localRefs); });
 
-    // join
-    readThread.join();
+    // join, and let the reader finish past the slices the cache thread takes
     cacheThread.join();
+    readQueue->release();
+    readThread.join();
   }
 
   // delete
@@ -1074,6 +1273,7 @@ void OECWorker::readDiskForShortening(AGCommand *agcmd)
   vector<int> cidlist = agcmd->getReadCidList();
   sort(cidlist.begin(), cidlist.end());
   unordered_map<int, int> refs = agcmd->getCacheRefs();
+  unordered_map<int, int> localRefs = agcmd->getLocalRefs();
 
   int pktsize = _conf->_pktSize;
   int slicesize = pktsize / w;
@@ -1089,7 +1289,7 @@ void OECWorker::readDiskForShortening(AGCommand *agcmd)
     printf("\n");
 
     // push shortening packets to Redis
-    pushShorteningPktsToRedis(num, stripename, w, cidlist, refs);
+    pushShorteningPktsToRedis(num, stripename, w, cidlist, refs, localRefs);
     return;
   }
 
@@ -1106,30 +1306,32 @@ void OECWorker::readDiskForShortening(AGCommand *agcmd)
   {
     // serail read
     // read data in serial from disk
-    thread readThread = thread([=]
-                               { objstream->readObj(slicesize); });
-    BlockingQueue<OECDataPacket *> *readQueue = objstream->getQueue();
+    TaskHandle readThread = _ioPool->submit([=]
+                                            { objstream->readObj(slicesize); });
+    SpscQueue<OECDataPacket *> *readQueue = objstream->getQueue();
     // cacheThread
-    thread cacheThread = thread([=]
-                                { selectCacheWorker(readQueue, num, stripename, w, cidlist, refs); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { selectCacheWorker(readQueue, num, stripename, w, cidlist, refs, localRefs); });
 
-    // join
-    readThread.join();
+    // join, and let the reader finish past the slices the cache thread takes
     cacheThread.join();
+    readQueue->release();
+    readThread.join();
   }
   else
   {
     // random read
-    thread readThread = thread([=]
-                               { objstream->readObj(w, cidlist, slicesize); });
-    BlockingQueue<OECDataPacket *> *readQueue = objstream->getQueue();
+    TaskHandle readThread = _ioPool->submit([=]
+                                            { objstream->readObj(w, cidlist, slicesize); });
+    SpscQueue<OECDataPacket *> *readQueue = objstream->getQueue();
     // cacheThrad
-    thread cacheThread = thread([=]
-                                { partialCacheWorker(readQueue, num, stripename, w, cidlist, refs); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { partialCacheWorker(readQueue, num, stripename, w, cidlist, refs, localRefs); });
 
-    // join
-    readThread.join();
+    // join, and let the reader finish past the slices the cache thread takes
     cacheThread.join();
+    readQueue->release();
+    readThread.join();
   }
 
   // delete
@@ -1138,15 +1340,15 @@ void OECWorker::readDiskForShortening(AGCommand *agcmd)
   cout << "OECWorker::readDiskForShortening finishes!" << endl;
 }
 
-void OECWorker::selectCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
+void OECWorker::selectCacheWorker(SpscQueue<OECDataPacket *> *cacheQueue,
                                   int pktnum,
                                   string keybase,
                                   int w,
                                   vector<int> idxlist,
-                                  unordered_map<int, int> refs)
+                                  unordered_map<int, int> refs,
+                                  unordered_map<int, int> localRefs)
 {
-  redisContext *writeCtx = RedisUtil::createContext(_conf->_localIp);
-  redisReply *rReply;
+  DataSender *sender = _transport->createSender();
 
   vector<int> units;
   unordered_map<int, int> unit2idx;
@@ -1160,14 +1362,15 @@ void OECWorker::selectCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
   struct timeval time1, time2;
   gettimeofday(&time1, NULL);
 
-  int count = 0;
-  int replyid = 0;
-
+  // the w slices of a pkt are taken from the queue at once
+  vector<OECDataPacket *> slices(w);
   for (int i = 0; i < pktnum; i++)
   {
+    for (int got = 0; got < w;)
+      got += cacheQueue->popBatch(slices.data() + got, w - got);
     for (int j = 0; j < w; j++)
     {
-      OECDataPacket *curslice = cacheQueue->pop();
+      OECDataPacket *curslice = slices[j];
       if (find(units.begin(), units.end(), j) == units.end())
       {
         delete curslice;
@@ -1175,110 +1378,69 @@ void OECWorker::selectCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
       }
       int curidx = unit2idx[j];
       string key = keybase + ":" + to_string(curidx) + ":" + to_string(i);
-      // we write data into redis
+      // we publish data to the agents that fetch it
       int refnum = refs[curidx];
       // cout << "curidx = " << curidx << ", refnum = " << refnum << endl;
-      int len = curslice->getDatalen();
-      // cout << "len = "  << len << ", key = " << key << endl;
-      char *raw = curslice->getRaw();
-      int rawlen = len + 4;
-      for (int k = 0; k < refnum; k++)
-      {
-        redisAppendCommand(writeCtx, "RPUSH %s %b", key.c_str(), raw, rawlen);
-        count++;
-      }
-      delete curslice;
-      if (i > 1)
-      {
-        redisGetReply(writeCtx, (void **)&rReply);
-        replyid++;
-        freeReplyObject(rReply);
-      }
+      publish(sender, key, curslice, refnum, localRefs[curidx]);
     }
   }
-  for (int i = replyid; i < count; i++)
-  {
-    redisGetReply(writeCtx, (void **)&rReply);
-    replyid++;
-    freeReplyObject(rReply);
-  }
+  sender->flush();
 
   gettimeofday(&time2, NULL);
   cout << "OECWorker::selectCacheWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
-  redisFree(writeCtx);
+  delete sender;
 }
 
-void OECWorker::partialCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
+void OECWorker::partialCacheWorker(SpscQueue<OECDataPacket *> *cacheQueue,
                                    int pktnum,
                                    string keybase,
                                    int w,
                                    vector<int> idxlist,
-                                   unordered_map<int, int> refs)
+                                   unordered_map<int, int> refs,
+                                   unordered_map<int, int> localRefs)
 {
-  redisContext *writeCtx = RedisUtil::createContext(_conf->_localIp);
-  redisReply *rReply;
+  DataSender *sender = _transport->createSender();
 
   struct timeval time1, time2;
   gettimeofday(&time1, NULL);
 
-  int count = 0;
-  int replyid = 0;
-
+  // the slices of a pkt are taken from the queue at once
+  int slicenum = idxlist.size();
+  vector<OECDataPacket *> slices(slicenum);
   for (int i = 0; i < pktnum; i++)
   {
-    for (int j = 0; j < idxlist.size(); j++)
+    for (int got = 0; got < slicenum;)
+      got += cacheQueue->popBatch(slices.data() + got, slicenum - got);
+    for (int j = 0; j < slicenum; j++)
     {
-      OECDataPacket *curslice = cacheQueue->pop();
+      OECDataPacket *curslice = slices[j];
       int curidx = idxlist[j];
       string key = keybase + ":" + to_string(curidx) + ":" + to_string(i);
-      // we write data into redis
+      // we publish data to the agents that fetch it
       int refnum = refs[curidx];
       // cout << "curidx = " << curidx << ", refnum = " << refnum << endl;
-      int len = curslice->getDatalen();
-      // cout << "len = "  << len << ", key = " << key << endl;
-      char *raw = curslice->getRaw();
-      int rawlen = len + 4;
-      for (int k = 0; k < refnum; k++)
-      {
-        redisAppendCommand(writeCtx, "RPUSH %s %b", key.c_str(), raw, rawlen);
-        count++;
-      }
-      delete curslice;
-      if (i > 1)
-      {
-        redisGetReply(writeCtx, (void **)&rReply);
-        replyid++;
-        freeReplyObject(rReply);
-      }
+      publish(sender, key, curslice, refnum, localRefs[curidx]);
     }
   }
-  for (int i = replyid; i < count; i++)
-  {
-    redisGetReply(writeCtx, (void **)&rReply);
-    replyid++;
-    freeReplyObject(rReply);
-  }
+  sender->flush();
 
   gettimeofday(&time2, NULL);
   cout << "OECWorker::selectCacheWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
-  redisFree(writeCtx);
+  delete sender;
 }
 
 void OECWorker::pushShorteningPktsToRedis(int pktnum,
                                           string keybase,
                                           int w,
                                           vector<int> idxlist,
-                                          unordered_map<int, int> refs)
+                                          unordered_map<int, int> refs,
+                                          unordered_map<int, int> localRefs)
 {
-  redisContext *writeCtx = RedisUtil::createContext(_conf->_localIp);
-  redisReply *rReply;
+  DataSender *sender = _transport->createSender();
 
   struct timeval time1, time2;
   gettimeofday(&time1, NULL);
 
-  int count = 0;
-  int replyid = 0;
-
   for (int i = 0; i < pktnum; i++)
   {
     for (int j = 0; j < idxlist.size(); j++)
@@ -1287,37 +1449,17 @@ void OECWorker::pushShorteningPktsToRedis(int pktnum,
       OECDataPacket *curslice = new OECDataPacket(_conf->_pktSize / w);
       int curidx = idxlist[j];
       string key = keybase + ":" + to_string(curidx) + ":" + to_string(i);
-      // we write data into redis
+      // we publish data to the agents that fetch it
       int refnum = refs[curidx];
       // cout << "curidx = " << curidx << ", refnum = " << refnum << endl;
-      int len = curslice->getDatalen();
-      // cout << "len = "  << len << ", key = " << key << endl;
-      char *raw = curslice->getRaw();
-      int rawlen = len + 4;
-      for (int k = 0; k < refnum; k++)
-      {
-        redisAppendCommand(writeCtx, "RPUSH %s %b", key.c_str(), raw, rawlen);
-        count++;
-      }
-      delete curslice;
-      if (i > 1)
-      {
-        redisGetReply(writeCtx, (void **)&rReply);
-        replyid++;
-        freeReplyObject(rReply);
-      }
+      publish(sender, key, curslice, refnum, localRefs[curidx]);
     }
   }
-  for (int i = replyid; i < count; i++)
-  {
-    redisGetReply(writeCtx, (void **)&rReply);
-    replyid++;
-    freeReplyObject(rReply);
-  }
+  sender->flush();
 
   gettimeofday(&time2, NULL);
   cout << "OECWorker::pushShorteningPktsToRedis.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
-  redisFree(writeCtx);
+  delete sender;
 }
 
 void OECWorker::fetchCompute(AGCommand *agcmd)
@@ -1330,6 +1472,7 @@ void OECWorker::fetchCompute(AGCommand *agcmd)
   vector<unsigned int> prevlocs = agcmd->getPrevLocs();
   unordered_map<int, vector<int>> coefs = agcmd->getCoefs();
   unordered_map<int, int> refs = agcmd->getCacheRefs();
+  unordered_map<int, int> localRefs = agcmd->getLocalRefs();
 
   vector<int> computefor;
   for (auto item : coefs)
@@ -1338,40 +1481,54 @@ void OECWorker::fetchCompute(AGCommand *agcmd)
   }
 
   // create fetch queue
-  BlockingQueue<OECDataPacket *> **fetchQueue = (BlockingQueue<OECDataPacket *> **)calloc(nprevs, sizeof(BlockingQueue<OECDataPacket *> *));
-  for (int i = 0; i < nprevs; i++)
+  // all fetch threads share one queue, so that compute consumes pkts in the order they arrive
+  int depth = _conf->_fetchQueueDepth;
+  BlockingQueue<pair<int, OECDataPacket *>> *fetchQueue = new BlockingQueue<pair<int, OECDataPacket *>>(depth * nprevs, "fetch");
+
+  // a source takes a credit for each pkt and gets one back when the oldest stripe finishes,
+  // so that no source runs more than depth stripes ahead of the slowest one
+  SpscQueue<int> **credits = NULL;
+  if (depth > 0)
   {
-    fetchQueue[i] = new BlockingQueue<OECDataPacket *>();
+    credits = (SpscQueue<int> **)calloc(nprevs, sizeof(SpscQueue<int> *));
+    for (int i = 0; i < nprevs; i++)
+    {
+      credits[i] = new SpscQueue<int>();
+      for (int j = 0; j < depth; j++)
+        credits[i]->push(1);
+    }
   }
 
   // create write queue
-  BlockingQueue<OECDataPacket *> **writeQueue = (BlockingQueue<OECDataPacket *> **)calloc(coefs.size(), sizeof(BlockingQueue<OECDataPacket *> *));
+  SpscQueue<OECDataPacket *> **writeQueue = (SpscQueue<OECDataPacket *> **)calloc(coefs.size(), sizeof(SpscQueue<OECDataPacket *> *));
   for (int i = 0; i < coefs.size(); i++)
   {
-    writeQueue[i] = new BlockingQueue<OECDataPacket *>();
+    writeQueue[i] = new SpscQueue<OECDataPacket *>(_conf->_writeQueueDepth, "write");
   }
 
   // create fetch thread
-  vector<thread> fetchThreads = vector<thread>(nprevs);
+  vector<TaskHandle> fetchThreads = vector<TaskHandle>(nprevs);
   for (int i = 0; i < nprevs; i++)
   {
     string keybase = stripename + ":" + to_string(prevcids[i]);
-    fetchThreads[i] = thread([=]
-                             { fetchWorker(fetchQueue[i], keybase, prevlocs[i], num); });
+    SpscQueue<int> *curcredits = credits ? credits[i] : NULL;
+    fetchThreads[i] = _ioPool->submit([=]
+                                      { fetchWorker(fetchQueue, curcredits, i, keybase, prevlocs[i], num); });
   }
 
   // create compute thread
-  thread computeThread = thread([=]
-                                { computeWorker(fetchQueue, nprevs, num, coefs, computefor, writeQueue, _conf->_pktSize / w); });
+  TaskHandle computeThread = _cpuPool->submit([=]
+                                              { computeWorker(fetchQueue, credits, nprevs, num, coefs, computefor, writeQueue, _conf->_pktSize / w); });
 
   // create cache thread
-  vector<thread> cacheThreads = vector<thread>(computefor.size());
+  vector<TaskHandle> cacheThreads = vector<TaskHandle>(computefor.size());
   for (int i = 0; i < computefor.size(); i++)
   {
     string keybase = stripename + ":" + to_string(computefor[i]);
     int r = refs[computefor[i]];
-    cacheThreads[i] = thread([=]
-                             { cacheWorker(writeQueue[i], keybase, num, r); });
+    int lr = localRefs[computefor[i]];
+    cacheThreads[i] = _ioPool->submit([=]
+                                      { sendWorker(writeQueue[i], keybase, num, r, lr); });
   }
 
   // join
@@ -1386,11 +1543,13 @@ void OECWorker::fetchCompute(AGCommand *agcmd)
   }
 
   // delete
-  for (int i = 0; i < nprevs; i++)
+  delete fetchQueue;
+  if (credits)
   {
-    delete fetchQueue[i];
+    for (int i = 0; i < nprevs; i++)
+      delete credits[i];
+    free(credits);
   }
-  free(fetchQueue);
   for (int i = 0; i < computefor.size(); i++)
   {
     delete writeQueue[i];
@@ -1399,53 +1558,97 @@ void OECWorker::fetchCompute(AGCommand *agcmd)
   cout << "OECWorker::fetchCompute finishes!" << endl;
 }
 
-void OECWorker::fetchWorker(BlockingQueue<OECDataPacket *> *fetchQueue,
+void OECWorker::publish(DataSender *sender, string key, OECDataPacket *pkt, int refs, int localrefs)
+{
+  if (localrefs <= 0)
+  {
+    sender->put(key, pkt, refs);
+    return;
+  }
+  // the sender takes pkt, so the tasks of this agent get a copy
+  if (refs > localrefs)
+    sender->put(key, LocalHandoff::copy(pkt), refs - localrefs);
+  _handoff->put(key, pkt, localrefs);
+}
+
+void OECWorker::fetchRemote(unsigned int loc, string keybase, int num, function<void(OECDataPacket *)> deliver)
+{
+  int fetched = 0;
+  auto counted = [&](OECDataPacket *pkt)
+  {
+    fetched++;
+    deliver(pkt);
+  };
+  // the same fetch to the peer across the retries, unique across restarts of the agent
+  string fetchid = RedisUtil::ip2Str(_conf->_localIp) + ":" + to_string(getpid()) + ":" + to_string(_fetchSeq++);
+  // a peer that is down holds this command back, as a fetch from its Redis would, but not the agent
+  while (!_transport->fetch(loc, keybase, fetchid, fetched, num, counted))
+  {
+    cerr << "OECWorker::fetchRemote cannot fetch " << keybase << " from " << RedisUtil::ip2Str(loc)
+         << " after " << fetched << " / " << num << " packets, retrying" << endl;
+    this_thread::sleep_for(chrono::seconds(1));
+  }
+}
+
+void OECWorker::fetchWorker(SpscQueue<OECDataPacket *> *fetchQueue,
                             string keybase,
                             unsigned int loc,
                             int num)
 {
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
 
-  redisReply *rReply;
-  redisContext *fetchCtx = RedisUtil::createContext(loc);
+  // loc 0 is a task of this agent
+  if (loc == 0)
+    _handoff->fetch(keybase, num, [&](OECDataPacket *pkt)
+                    { fetchQueue->push(pkt); });
+  else
+    fetchRemote(loc, keybase, num, [&](OECDataPacket *pkt)
+                { fetchQueue->push(pkt); });
 
+  gettimeofday(&time2, NULL);
+  cout << "OECWorker::fetchWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
+}
+
+void OECWorker::fetchWorker(BlockingQueue<pair<int, OECDataPacket *>> *fetchQueue,
+                            SpscQueue<int> *credits,
+                            int srcidx,
+                            string keybase,
+                            unsigned int loc,
+                            int num)
+{
+  // same as fetchWorker above, but pkts are tagged with srcidx in a queue shared by all sources
   struct timeval time1, time2;
   gettimeofday(&time1, NULL);
 
-  int replyid = 0;
-  for (int i = 0; i < num; i++)
+  auto deliver = [&](OECDataPacket *pkt)
   {
-    string key = keybase + ":" + to_string(i);
-    redisAppendCommand(fetchCtx, "blpop %s 0", key.c_str());
-  }
+    if (credits)
+      credits->pop();
+    fetchQueue->push(make_pair(srcidx, pkt));
+  };
+  if (loc == 0)
+    _handoff->fetch(keybase, num, deliver);
+  else
+    fetchRemote(loc, keybase, num, deliver);
 
-  struct timeval t1, t2;
-  double t;
-  for (int i = replyid; i < num; i++)
-  {
-    string key = keybase + ":" + to_string(i);
-    gettimeofday(&t1, NULL);
-    redisGetReply(fetchCtx, (void **)&rReply);
-    gettimeofday(&t2, NULL);
-    // if (i == 0) cout << "OECWorker::fetchWorker.fetch first t = " << RedisUtil::duration(t1, t2) << endl;
-    char *content = rReply->element[1]->str;
-    OECDataPacket *pkt = new OECDataPacket(content);
-    int curDataLen = pkt->getDatalen();
-    fetchQueue->push(pkt);
-    freeReplyObject(rReply);
-  }
   gettimeofday(&time2, NULL);
   cout << "OECWorker::fetchWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
-  redisFree(fetchCtx);
 }
 
-void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
+void OECWorker::computeWorker(BlockingQueue<pair<int, OECDataPacket *>> *fetchQueue,
+                              SpscQueue<int> **credits,
                               int nprev,
                               int num,
                               unordered_map<int, vector<int>> coefs,
                               vector<int> cfor,
-                              BlockingQueue<OECDataPacket *> **writeQueue,
+                              SpscQueue<OECDataPacket *> **writeQueue,
                               int slicesize)
 {
+  // In this method, we accumulate each fetched slice into the outputs of its stripe as soon as it arrives,
+  // and free it right away. A stripe is finished when the contribution of the last source lands.
+  // As each source delivers its pkts in order, stripes finish in order.
+
   // prepare coding matrix
   int row = cfor.size();
   int col = nprev;
@@ -1471,54 +1674,73 @@ void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
   }
   cout << "-------------------" << endl;
 
-  OECDataPacket **curstripe = (OECDataPacket **)calloc(row + col, sizeof(OECDataPacket *));
-  char **data = (char **)calloc(col, sizeof(char *));
+  shared_ptr<CodingPlan> plan = CodingPlan::getPlan(matrix, row, col);
+
+  // next pktidx of each source
+  vector<int> nextPkt = vector<int>(col, 0);
+  // pktidx -> outputs of the stripe, and the number of sources that have arrived
+  unordered_map<int, OECDataPacket **> accMap;
+  unordered_map<int, int> arrivedMap;
+  int finished = 0;
+
   char **code = (char **)calloc(row, sizeof(char *));
-  while (num--)
+  for (int cnt = 0; cnt < num * col; cnt++)
   {
-    // prepare data
-    for (int i = 0; i < col; i++)
+    pair<int, OECDataPacket *> curitem = fetchQueue->pop();
+    int srcidx = curitem.first;
+    OECDataPacket *curpkt = curitem.second;
+    int pktidx = nextPkt[srcidx]++;
+
+    if (accMap.find(pktidx) == accMap.end())
     {
-      OECDataPacket *curpkt = fetchQueue[i]->pop();
-      curstripe[i] = curpkt;
-      data[i] = curpkt->getData();
+      // pkts created by OECDataPacket(int) are zero-filled, so we can accumulate on them directly
+      OECDataPacket **curstripe = (OECDataPacket **)calloc(row, sizeof(OECDataPacket *));
+      for (int i = 0; i < row; i++)
+        curstripe[i] = new OECDataPacket(slicesize);
+      accMap.insert(make_pair(pktidx, curstripe));
+      arrivedMap.insert(make_pair(pktidx, 0));
     }
+    OECDataPacket **curstripe = accMap[pktidx];
     for (int i = 0; i < row; i++)
-    {
-      curstripe[col + i] = new OECDataPacket(slicesize);
-      code[i] = curstripe[col + i]->getData();
-    }
+      code[i] = curstripe[i]->getData();
+
     // compute
-    Computation::Multi(code, data, matrix, row, col, slicesize, "Isal");
+    plan->update(code, curpkt->getData(), srcidx, slicesize, _conf->_computeTileSize, _conf->_computeThreadNum);
+    delete curpkt;
+    arrivedMap[pktidx]++;
 
-    // now we free data
-    for (int i = 0; i < col; i++)
-    {
-      delete curstripe[i];
-      curstripe[i] = nullptr;
-    }
-    // add the res to writeQueue
-    for (int i = 0; i < row; i++)
+    // add the finished stripes to writeQueue
+    while (arrivedMap.find(finished) != arrivedMap.end() && arrivedMap[finished] == col)
     {
-      writeQueue[i]->push(curstripe[col + i]);
-      curstripe[col + i] = nullptr;
+      OECDataPacket **donestripe = accMap[finished];
+      for (int i = 0; i < row; i++)
+      {
+        writeQueue[i]->push(donestripe[i]);
+      }
+      free(donestripe);
+      accMap.erase(finished);
+      arrivedMap.erase(finished);
+      finished++;
+      if (credits)
+      {
+        for (int i = 0; i < col; i++)
+          credits[i]->push(1);
+      }
     }
   }
 
   // free
   free(code);
-  free(data);
-  free(curstripe);
   free(matrix);
 }
 
-void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
+void OECWorker::computeWorker(SpscQueue<OECDataPacket *> **fetchQueue,
                               int nprev,
                               vector<int> prevCids,
                               int num,
                               unordered_map<int, vector<int>> coefs,
                               vector<int> cfor,
-                              unordered_map<int, BlockingQueue<OECDataPacket *> *> writeQueue,
+                              unordered_map<int, SpscQueue<OECDataPacket *> *> writeQueue,
                               int slicesize)
 {
   // prepare coding matrix
@@ -1546,6 +1768,8 @@ void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
   }
   cout << "-------------------" << endl;
 
+  shared_ptr<CodingPlan> plan = CodingPlan::getPlan(matrix, row, col);
+
   OECDataPacket **curstripe = (OECDataPacket **)calloc(row + col, sizeof(OECDataPacket *));
   char **data = (char **)calloc(col, sizeof(char *));
   char **code = (char **)calloc(row, sizeof(char *));
@@ -1560,17 +1784,17 @@ void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
     }
     for (int i = 0; i < row; i++)
     {
-      curstripe[col + i] = new OECDataPacket(slicesize);
+      curstripe[col + i] = new OECDataPacket(slicesize, false);
       code[i] = curstripe[col + i]->getData();
     }
     // compute
-    Computation::Multi(code, data, matrix, row, col, slicesize, "Isal");
+    plan->encode(code, data, slicesize, _conf->_computeTileSize, _conf->_computeThreadNum);
 
     // put needed data into writeQueue
     for (auto item : writeQueue)
     {
       int target = item.first;
-      BlockingQueue<OECDataPacket *> *queue = item.second;
+      SpscQueue<OECDataPacket *> *queue = item.second;
       for (int i = 0; i < nprev; i++)
       {
         if (prevCids[i] == target)
@@ -1607,12 +1831,15 @@ void OECWorker::computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
   free(matrix);
 }
 
-void OECWorker::cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+void OECWorker::cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                             string keybase,
                             int startidx,
                             int num,
                             int ref)
 {
+  if (ringWorker(writeQueue, keybase, startidx, 1, num, ref))
+    return;
+
   redisReply *rReply;
   redisContext *writeCtx = RedisUtil::createContext("127.0.0.1");
 
@@ -1652,11 +1879,14 @@ void OECWorker::cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
   redisFree(writeCtx);
 }
 
-void OECWorker::cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+void OECWorker::cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                             string keybase,
                             int num,
                             int ref)
 {
+  if (ringWorker(writeQueue, keybase, 0, 1, num, ref))
+    return;
+
   struct timeval time1, time2, time3, time4;
   gettimeofday(&time1, NULL);
 
@@ -1700,13 +1930,40 @@ void OECWorker::cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
   redisFree(writeCtx);
 }
 
-void OECWorker::cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+void OECWorker::sendWorker(SpscQueue<OECDataPacket *> *writeQueue,
+                           string keybase,
+                           int num,
+                           int ref,
+                           int localref)
+{
+  DataSender *sender = _transport->createSender();
+
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+
+  for (int i = 0; i < num; i++)
+  {
+    string key = keybase + ":" + to_string(i);
+    OECDataPacket *curpkt = writeQueue->pop();
+    publish(sender, key, curpkt, ref, localref);
+  }
+  sender->flush();
+
+  gettimeofday(&time2, NULL);
+  cout << "OECWorker::sendWorker.duration: " << RedisUtil::duration(time1, time2) << " for " << keybase << endl;
+  delete sender;
+}
+
+void OECWorker::cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                             string keybase,
                             int startidx,
                             int step,
                             int num,
                             int ref)
 {
+  if (ringWorker(writeQueue, keybase, startidx, step, num, ref))
+    return;
+
   // This cache worker fetch pkt from writeQueue and write into local redis
   // For each pkt: key = keybase:(startidx + i*step)
   // write ref times
@@ -1767,25 +2024,25 @@ void OECWorker::persist(AGCommand *agcmd)
   cout << "OECWorker::persist.write as " << objname << " with " << num << " pkts" << endl;
 
   // create fetch queue
-  BlockingQueue<OECDataPacket *> **fetchQueue = (BlockingQueue<OECDataPacket *> **)calloc(nprevs, sizeof(BlockingQueue<OECDataPacket *> *));
+  SpscQueue<OECDataPacket *> **fetchQueue = (SpscQueue<OECDataPacket *> **)calloc(nprevs, sizeof(SpscQueue<OECDataPacket *> *));
   for (int i = 0; i < nprevs; i++)
   {
-    fetchQueue[i] = new BlockingQueue<OECDataPacket *>();
+    fetchQueue[i] = new SpscQueue<OECDataPacket *>(_conf->_fetchQueueDepth, "fetch");
   }
 
   // create fetch thread
-  vector<thread> fetchThreads = vector<thread>(nprevs);
+  vector<TaskHandle> fetchThreads = vector<TaskHandle>(nprevs);
   for (int i = 0; i < nprevs; i++)
   {
     string keybase = stripename + ":" + to_string(prevcids[i]);
-    fetchThreads[i] = thread([=]
-                             { fetchWorker(fetchQueue[i], keybase, prevlocs[i], num); });
+    fetchThreads[i] = _ioPool->submit([=]
+                                      { fetchWorker(fetchQueue[i], keybase, prevlocs[i], num); });
   }
 
   // create objstream and writeThread
   FSObjOutputStream *objstream = new FSObjOutputStream(_conf, objname, _underfs, num * nprevs);
-  thread writeThread = thread([=]
-                              { objstream->writeObj(); });
+  TaskHandle writeThread = _ioPool->submit([=]
+                                           { objstream->writeObj(); });
 
   int total = num;
   while (total--)
@@ -1833,6 +2090,7 @@ void OECWorker::clientRead(AGCommand *agcmd)
   struct timeval time1, time2;
   gettimeofday(&time1, NULL);
   string filename = agcmd->getFilename();
+  _clientShm = agcmd->getShmName();
 
   // 0. send request to coordinator to get filemeta
   CoorCommand *coorCmd = new CoorCommand();
@@ -1857,7 +2115,8 @@ void OECWorker::clientRead(AGCommand *agcmd)
   metastr += 4;
   filesizeMB = ntohl(filesizeMB);
 
-  // 2. return filesizeMB to client
+  // 2. answer the ring of the client, and return filesizeMB to client
+  acceptClientRing(filename, 1);
   redisReply *rReply;
   redisContext *cliCtx = RedisUtil::createContext(_conf->_localIp);
   string skey = "filesize:" + filename;
@@ -1923,6 +2182,8 @@ void OECWorker::clientRead(AGCommand *agcmd)
 
   freeReplyObject(metareply);
   redisFree(metaCtx);
+  closeClientRing(filename);
+  _clientShm = "";
 }
 
 void OECWorker::readOffline(string filename, int filesizeMB, int objnum)
@@ -1930,13 +2191,13 @@ void OECWorker::readOffline(string filename, int filesizeMB, int objnum)
   cout << "OECWorker::readOffline.filename: " << filename << ", filesizeMB: " << filesizeMB << ", objnum: " << objnum << endl;
 
   // create inputstream
-  vector<thread> createThreads = vector<thread>(objnum);
+  vector<TaskHandle> createThreads = vector<TaskHandle>(objnum);
   FSObjInputStream **objstreams = (FSObjInputStream **)calloc(objnum, sizeof(FSObjInputStream *));
   for (int i = 0; i < objnum; i++)
   {
     string objname = filename + "_oecobj_" + to_string(i);
-    createThreads[i] = thread([=]
-                              { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
+    createThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
   }
   for (int i = 0; i < objnum; i++)
   {
@@ -1968,13 +2229,13 @@ void OECWorker::readOffline(string filename, int filesizeMB, vector<string> objl
   cout << "OECWorker::readOffline.filename: " << filename << ", filesizeMB: " << filesizeMB << ", objnum: " << objnum << endl;
 
   // create inputstream
-  vector<thread> createThreads = vector<thread>(objnum);
+  vector<TaskHandle> createThreads = vector<TaskHandle>(objnum);
   FSObjInputStream **objstreams = (FSObjInputStream **)calloc(objnum, sizeof(FSObjInputStream *));
   for (int i = 0; i < objnum; i++)
   {
     string objname = objlist[i];
-    createThreads[i] = thread([=]
-                              { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
+    createThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
   }
   for (int i = 0; i < objnum; i++)
   {
@@ -2035,15 +2296,16 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
     cout << "OECWorker::readOfflineObj. " << objname << " exists!" << endl;
     // this obj is in good health
     // 1. create read thread
-    thread readThread = thread([=]
-                               { objstream->readObj(); });
-    BlockingQueue<OECDataPacket *> *writeQueue = objstream->getQueue();
+    TaskHandle readThread = _ioPool->submit([=]
+                                            { objstream->readObj(); });
+    SpscQueue<OECDataPacket *> *writeQueue = objstream->getQueue();
     // 2. cache thread
-    thread cacheThread = thread([=]
-                                { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
-    // join
-    readThread.join();
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
+    // join, and let the reader finish past the pkts of the file in this object
     cacheThread.join();
+    writeQueue->release();
+    readThread.join();
   }
   else
   {
@@ -2213,24 +2475,27 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
 
       // 1.0 create input stream
       FSObjInputStream **readStreams = (FSObjInputStream **)calloc(loadn, sizeof(FSObjInputStream *));
-      vector<thread> createThreads = vector<thread>(loadn);
+      vector<TaskHandle> createThreads = vector<TaskHandle>(loadn);
       for (int loadi = 0; loadi < loadn; loadi++)
       {
         string loadobjname = loadobj[loadi];
-        createThreads[loadi] = thread([=]
-                                      { readStreams[loadi] = new FSObjInputStream(_conf, loadobjname, _underfs); });
+        createThreads[loadi] = _ioPool->submit([=]
+                                               { readStreams[loadi] = new FSObjInputStream(_conf, loadobjname, _underfs); });
       }
       for (int loadi = 0; loadi < loadn; loadi++)
         createThreads[loadi].join();
+      // objects are read completely before compute starts, so the read queues cannot be bounded
+      for (int loadi = 0; loadi < loadn; loadi++)
+        readStreams[loadi]->getQueue()->setCapacity(0);
 
-      vector<thread> readThreads = vector<thread>(loadn);
+      vector<TaskHandle> readThreads = vector<TaskHandle>(loadn);
       for (int loadi = 0; loadi < loadn; loadi++)
       {
         int sid = loadidx[loadi];
         vector<int> curlist = sid2Cids[sid];
         // readThreads[loadi] = thread([=]{readStreams[loadi]->readObj(ecw, curlist, _conf->_pktSize / ecw);});
-        readThreads[loadi] = thread([=]
-                                    { readStreams[loadi]->readObjOptimized(ecw, curlist, _conf->_pktSize / ecw); });
+        readThreads[loadi] = _ioPool->submit([=]
+                                             { readStreams[loadi]->readObjOptimized(ecw, curlist, _conf->_pktSize / ecw); });
       }
 
       for (int loadi = 0; loadi < loadn; loadi++)
@@ -2240,9 +2505,10 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
       cout << "OECWorker::readOfflineObj loadObj = " << RedisUtil::duration(time2, time3) << endl;
 
       // 2. computeThread
-      BlockingQueue<OECDataPacket *> *writeQueue = new BlockingQueue<OECDataPacket *>();
-      thread computeThread = thread([=]
-                                    { computeWorkerDegradedOffline(readStreams, loadidx, sid2Cids, writeQueue, lostidx, computeTasks, pktnum, ecn, eck, ecw); });
+      // the cache thread starts after compute, so the writeQueue cannot be bounded either
+      SpscQueue<OECDataPacket *> *writeQueue = new SpscQueue<OECDataPacket *>();
+      TaskHandle computeThread = _cpuPool->submit([=]
+                                                  { computeWorkerDegradedOffline(readStreams, loadidx, sid2Cids, writeQueue, lostidx, computeTasks, pktnum, ecn, eck, ecw); });
 
       computeThread.join();
 
@@ -2250,8 +2516,8 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
       cout << "OECWorker::readOfflineObj compute = " << RedisUtil::duration(time3, time4) << endl;
 
       // 3. cacheThread
-      thread cacheThread = thread([=]
-                                  { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
+      TaskHandle cacheThread = _ioPool->submit([=]
+                                               { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
 
       cacheThread.join();
 
@@ -2304,26 +2570,26 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
       }
 
       // create fetch queue
-      BlockingQueue<OECDataPacket *> **fetchQueue = (BlockingQueue<OECDataPacket *> **)calloc(num, sizeof(BlockingQueue<OECDataPacket *> *));
+      SpscQueue<OECDataPacket *> **fetchQueue = (SpscQueue<OECDataPacket *> **)calloc(num, sizeof(SpscQueue<OECDataPacket *> *));
       for (int i = 0; i < num; i++)
       {
-        fetchQueue[i] = new BlockingQueue<OECDataPacket *>();
+        fetchQueue[i] = new SpscQueue<OECDataPacket *>(_conf->_fetchQueueDepth, "fetch");
       }
       // create writeQueue
-      BlockingQueue<OECDataPacket *> *writeQueue = new BlockingQueue<OECDataPacket *>();
+      SpscQueue<OECDataPacket *> *writeQueue = new SpscQueue<OECDataPacket *>(_conf->_writeQueueDepth, "write");
 
       // create fetchThread
-      vector<thread> fetchThreads = vector<thread>(num);
+      vector<TaskHandle> fetchThreads = vector<TaskHandle>(num);
       for (int i = 0; i < num; i++)
       {
         int cid = cidxlist[i];
         string keybase = stripename + ":" + to_string(cid);
-        fetchThreads[i] = thread([=]
-                                 { fetchWorker(fetchQueue[i], keybase, iplist[i], pktnum); });
+        fetchThreads[i] = _ioPool->submit([=]
+                                          { fetchWorker(fetchQueue[i], keybase, iplist[i], pktnum); });
       }
 
-      thread cacheThread = thread([=]
-                                  { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
+      TaskHandle cacheThread = _ioPool->submit([=]
+                                               { cacheWorker(writeQueue, filename, pktnum * idx, pktnum, 1); });
 
       // fetch pkt from fetchQueue to writeQueue
       for (int i = 0; i < pktnum; i++)
@@ -2335,17 +2601,14 @@ void OECWorker::readOfflineObj(string filename, string objname, int objsizeMB, F
           continue;
         }
         int slicesize = _conf->_pktSize / num;
-        char *content = (char *)calloc(4 + _conf->_pktSize, sizeof(char));
-        int tmplen = htonl(_conf->_pktSize);
-        memcpy(content, (char *)&tmplen, 4);
+        OECDataPacket *retpkt = new OECDataPacket(_conf->_pktSize, false);
+        char *content = retpkt->getData();
         for (int j = 0; j < num; j++)
         {
           OECDataPacket *curpkt = fetchQueue[j]->pop();
-          memcpy(content + 4 + j * slicesize, curpkt->getData(), slicesize);
+          memcpy(content + j * slicesize, curpkt->getData(), slicesize);
           delete curpkt;
         }
-        OECDataPacket *retpkt = new OECDataPacket();
-        retpkt->setRaw(content);
         writeQueue->push(retpkt);
       }
 
@@ -2378,12 +2641,12 @@ void OECWorker::readOnline(string filename, int filesizeMB, int ecn, int eck, in
   vector<int> corruptIdx;
   bool needRecovery = false;
   FSObjInputStream **objstreams = (FSObjInputStream **)calloc(ecn, sizeof(FSObjInputStream *));
-  vector<thread> createThreads = vector<thread>(ecn);
+  vector<TaskHandle> createThreads = vector<TaskHandle>(ecn);
   for (int i = 0; i < ecn; i++)
   {
     string objname = filename + "_oecobj_" + to_string(i);
-    createThreads[i] = thread([=]
-                              { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
+    createThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i] = new FSObjInputStream(_conf, objname, _underfs); });
   }
   for (int i = 0; i < ecn; i++)
     createThreads[i].join();
@@ -2407,20 +2670,20 @@ void OECWorker::readOnline(string filename, int filesizeMB, int ecn, int eck, in
   {
     cout << "OECWorker::readOnline.do not need recovery" << endl;
     // we do not need recovery
-    vector<thread> readThreads = vector<thread>(eck);
+    vector<TaskHandle> readThreads = vector<TaskHandle>(eck);
     for (int i = 0; i < eck; i++)
     {
-      readThreads[i] = thread([=]
-                              { objstreams[i]->readObj(); });
+      readThreads[i] = _ioPool->submit([=]
+                                       { objstreams[i]->readObj(); });
     }
 
     // version 1 start: single caching thread
     unsigned long long filesizeBytes = (unsigned long long)filesizeMB * 1048576;
     int pktnum = filesizeBytes / (unsigned long long)_conf->_pktSize;
-    BlockingQueue<OECDataPacket *> *writeQueue = new BlockingQueue<OECDataPacket *>();
+    SpscQueue<OECDataPacket *> *writeQueue = new SpscQueue<OECDataPacket *>(_conf->_writeQueueDepth, "write");
     // 1.1 cacheThread
-    thread cacheThread = thread([=]
-                                { cacheWorker(writeQueue, filename, pktnum, 1); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { cacheWorker(writeQueue, filename, pktnum, 1); });
 
     // 1.3 get pkt from readThread to writeThread
     struct timeval push1, push2;
@@ -2532,31 +2795,32 @@ void OECWorker::readOnline(string filename, int filesizeMB, int ecn, int eck, in
       cout << "readStreams[" << i << "] = objstreams[" << loadidx[i] << "]" << endl;
     }
 
-    vector<thread> readThreads = vector<thread>(loadn);
+    vector<TaskHandle> readThreads = vector<TaskHandle>(loadn);
     for (int i = 0; i < loadn; i++)
     {
-      readThreads[i] = thread([=]
-                              { readStreams[i]->readObj(); });
+      readThreads[i] = _ioPool->submit([=]
+                                       { readStreams[i]->readObj(); });
     }
 
-    BlockingQueue<OECDataPacket *> *writeQueue = new BlockingQueue<OECDataPacket *>();
+    SpscQueue<OECDataPacket *> *writeQueue = new SpscQueue<OECDataPacket *>(_conf->_writeQueueDepth, "write");
     // 1.1 cacheThread
     unsigned long long filesizeBytes = (unsigned long long)filesizeMB * 1048576;
     int pktnum = filesizeBytes / (unsigned long long)_conf->_pktSize;
-    thread cacheThread = thread([=]
-                                { cacheWorker(writeQueue, filename, pktnum, 1); });
+    TaskHandle cacheThread = _ioPool->submit([=]
+                                             { cacheWorker(writeQueue, filename, pktnum, 1); });
 
     // 2.1 computeThread
     int stripenum = pktnum / eck;
-    thread computeThread = thread([=]
-                                  { computeWorker(readStreams, loadidx, writeQueue, computeTasks, stripenum, ecn, eck, ecw); });
+    TaskHandle computeThread = _cpuPool->submit([=]
+                                                { computeWorker(readStreams, loadidx, writeQueue, computeTasks, stripenum, ecn, eck, ecw); });
 
-    // join
+    // join, and let the readers finish past the pkts of the file in their objects
+    computeThread.join();
     for (int i = 0; i < loadn; i++)
     {
+      readStreams[i]->getQueue()->release();
       readThreads[i].join();
     }
-    computeThread.join();
     cacheThread.join();
 
     // delete
@@ -2590,6 +2854,7 @@ void OECWorker::readFetchCompute(AGCommand *agCmd)
   vector<unsigned int> prevLocs = agCmd->getPrevLocs();
   unordered_map<int, vector<int>> coefs = agCmd->getCoefs();
   unordered_map<int, int> cacheRefs = agCmd->getCacheRefs();
+  unordered_map<int, int> localRefs = agCmd->getLocalRefs();
 
   vector<int> computefor;
   for (auto item : coefs)
@@ -2602,10 +2867,10 @@ void OECWorker::readFetchCompute(AGCommand *agCmd)
     cout << "OECWorker::readWorker." << readObjName << " does not exist!" << endl;
     return;
   }
-  BlockingQueue<OECDataPacket *> *readQueue = objstream->getQueue();
+  SpscQueue<OECDataPacket *> *readQueue = objstream->getQueue();
 
   // create queue to fetch data from remote
-  BlockingQueue<OECDataPacket *> **fetchQueue = (BlockingQueue<OECDataPacket *> **)calloc(nprevs, sizeof(BlockingQueue<OECDataPacket *> *));
+  SpscQueue<OECDataPacket *> **fetchQueue = (SpscQueue<OECDataPacket *> **)calloc(nprevs, sizeof(SpscQueue<OECDataPacket *> *));
   for (int i = 0; i < nprevs; i++)
   {
     if (prevCids[i] == cid)
@@ -2614,61 +2879,63 @@ void OECWorker::readFetchCompute(AGCommand *agCmd)
     }
     else
     {
-      fetchQueue[i] = new BlockingQueue<OECDataPacket *>();
+      fetchQueue[i] = new SpscQueue<OECDataPacket *>(_conf->_fetchQueueDepth, "fetch");
     }
   }
 
   // create write queue
-  unordered_map<int, BlockingQueue<OECDataPacket *> *> writeQueue;
+  unordered_map<int, SpscQueue<OECDataPacket *> *> writeQueue;
   for (auto item : cacheRefs)
   {
     int target = item.first;
-    BlockingQueue<OECDataPacket *> *q = new BlockingQueue<OECDataPacket *>();
+    SpscQueue<OECDataPacket *> *q = new SpscQueue<OECDataPacket *>(_conf->_writeQueueDepth, "write");
     writeQueue.insert(make_pair(target, q));
   }
 
   // create thread to fetch data
-  vector<thread> fetchThreads = vector<thread>(nprevs);
+  vector<TaskHandle> fetchThreads = vector<TaskHandle>(nprevs);
   int pktsize = _conf->_pktSize;
   int slicesize = pktsize / ecw;
   for (int i = 0; i < nprevs; i++)
   {
     if (prevCids[i] == cid)
     {
-      fetchThreads[i] = thread([=]
-                               { objstream->readObj(pktsize); });
+      fetchThreads[i] = _ioPool->submit([=]
+                                        { objstream->readObj(pktsize); });
     }
     else
     {
       string keybase = stripename + ":" + to_string(prevCids[i]);
-      fetchThreads[i] = thread([=]
-                               { fetchWorker(fetchQueue[i], keybase, prevLocs[i], pktnum); });
+      fetchThreads[i] = _ioPool->submit([=]
+                                        { fetchWorker(fetchQueue[i], keybase, prevLocs[i], pktnum); });
     }
   }
 
   // create compute thread
-  thread computeThread = thread([=]
-                                { computeWorker(fetchQueue, nprevs, prevCids, pktnum, coefs, computefor, writeQueue, slicesize); });
+  TaskHandle computeThread = _cpuPool->submit([=]
+                                              { computeWorker(fetchQueue, nprevs, prevCids, pktnum, coefs, computefor, writeQueue, slicesize); });
 
   // create cache thread
-  vector<thread> cacheThreads = vector<thread>(cacheRefs.size());
+  vector<TaskHandle> cacheThreads = vector<TaskHandle>(cacheRefs.size());
   int cacheid = 0;
   for (auto item : cacheRefs)
   {
     int cid = item.first;
     int ref = item.second;
+    int localref = localRefs[cid];
     string keybase = stripename + ":" + to_string(cid);
-    BlockingQueue<OECDataPacket *> *queue = writeQueue[cid];
-    cacheThreads[cacheid++] = thread([=]
-                                     { cacheWorker(queue, keybase, pktnum, ref); });
+    SpscQueue<OECDataPacket *> *queue = writeQueue[cid];
+    cacheThreads[cacheid++] = _ioPool->submit([=]
+                                              { sendWorker(queue, keybase, pktnum, ref, localref); });
   }
 
-  // join
+  // join, and let the reader finish past the pkts that compute takes
+  computeThread.join();
+  readQueue->release();
   for (int i = 0; i < nprevs; i++)
   {
     fetchThreads[i].join();
   }
-  computeThread.join();
   for (int i = 0; i < cacheid; i++)
     cacheThreads[i].join();
 
@@ -1,16 +1,23 @@
 #ifndef _OECWORKER_HH_
 #define _OECWORKER_HH_
 
+#include <atomic>
 #include <iomanip>
 #include "BlockingQueue.hh"
 #include "Config.hh"
+#include "DataTransport.hh"
 #include "FSObjInputStream.hh"
 #include "FSObjOutputStream.hh"
+#include "LocalHandoff.hh"
 #include "OECDataPacket.hh"
+#include "ShmRing.hh"
+#include "SpscQueue.hh"
+#include "TaskPool.hh"
 // #include "ECBase.hh"
 // #include "RSCONV.hh"
 // #include "Util/hdfs.h"
 
+#include "../ec/CodingPlan.hh"
 #include "../ec/Computation.hh"
 #include "../ec/ECTask.hh"
 #include "../fs/UnderFS.hh"
@@ -30,11 +37,52 @@ private:
   redisContext *_coorCtx;
 
   UnderFS *_underfs;
+  DataTransport *_transport;
+  // packets for tasks of this agent are handed over in memory
+  LocalHandoff *_handoff;
+  // stages of commands run as tasks on these instead of threads of their own
+  TaskPool *_cpuPool;
+  TaskPool *_ioPool;
+
+  // the stats of the agent are dumped by one thread for all workers
+  static once_flag _statsFlag;
+  // numbers the fetches of the agent
+  static atomic<long> _fetchSeq;
+  void statsLoop();
+
+  // shared-memory rings of local clients, by ring name and filename
+  unordered_map<string, shared_ptr<ShmRing>> _clientRings;
+  mutex _ringLock;
+  // ring offered by the client of the command this worker runs, empty if none
+  string _clientShm;
+
+  // answer the ring offered by the client of filename, if any
+  void acceptClientRing(string filename, int minslots);
+  shared_ptr<ShmRing> getClientRing(string filename);
+  void closeClientRing(string filename);
+  // pass packets keybase:(startidx + i*step) to the client through its ring,
+  // false if the client of keybase has no ring. Packets too large for a slot,
+  // and copies beyond the first, go to redis
+  bool ringWorker(SpscQueue<OECDataPacket *> *writeQueue,
+                  string keybase,
+                  int startidx,
+                  int step,
+                  int num,
+                  int ref);
+
+  // obtain the targets and coding plan of each compute task
+  void prepareCodingPlans(vector<ECTask *> computeTasks,
+                          vector<vector<int>> &taskTargets,
+                          vector<shared_ptr<CodingPlan>> &taskPlans);
 
 public:
   OECWorker(Config *conf);
   ~OECWorker();
   void doProcess();
+  // run a command received by doProcess
+  void handleCommand(AGCommand *agCmd);
+  // run the tasks of a batch command together
+  void runBatch(AGCommand *agCmd);
   // deal with client request
   void clientWrite(AGCommand *agCmd);
   void clientRead(AGCommand *agCmd);
@@ -46,7 +94,9 @@ public:
   void readOfflineObj(string filename, string objname, int objsizeMB, FSObjInputStream *objstream, int pktnum, int idx);
 
   // load data from redis
-  void loadWorker(BlockingQueue<OECDataPacket *> *readQueue,
+  // the queue is the input of a compute stage, or the queue of an FSObjOutputStream
+  template <class Queue>
+  void loadWorker(Queue *readQueue,
                   string keybase,
                   int startid,
                   int step,
@@ -54,7 +104,7 @@ public:
                   bool zeropadding);
   // compute
   void computeWorker(vector<ECTask *> compute,
-                     BlockingQueue<OECDataPacket *> **readQueue,
+                     SpscQueue<OECDataPacket *> **readQueue,
                      FSObjOutputStream **objstreams,
                      int stripenum,
                      int ecn,
@@ -62,7 +112,7 @@ public:
                      int ecw);
   void computeWorker(FSObjInputStream **readStreams,
                      vector<int> idlist,
-                     BlockingQueue<OECDataPacket *> *writeQueue,
+                     SpscQueue<OECDataPacket *> *writeQueue,
                      vector<ECTask *> computeTasks,
                      int stripenum,
                      int ecn,
@@ -71,7 +121,7 @@ public:
   void computeWorkerDegradedOffline(FSObjInputStream **readStreams,
                                     vector<int> idlist,
                                     unordered_map<int, vector<int>> sid2Cids,
-                                    BlockingQueue<OECDataPacket *> *writeQueue,
+                                    SpscQueue<OECDataPacket *> *writeQueue,
                                     int lostidx,
                                     vector<ECTask *> computeTasks,
                                     int stripenum,
@@ -88,53 +138,75 @@ public:
   // for Shortening
   void readDiskForShortening(AGCommand *agCmd);
 
-  void selectCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
+  void selectCacheWorker(SpscQueue<OECDataPacket *> *cacheQueue,
                          int pktnum,
                          string keybase,
                          int w,
                          vector<int> idxlist,
-                         unordered_map<int, int> refs);
-  void partialCacheWorker(BlockingQueue<OECDataPacket *> *cacheQueue,
+                         unordered_map<int, int> refs,
+                         unordered_map<int, int> localRefs);
+  void partialCacheWorker(SpscQueue<OECDataPacket *> *cacheQueue,
                           int pktnum,
                           string keybase,
                           int w,
                           vector<int> idxlist,
-                          unordered_map<int, int> refs);
+                          unordered_map<int, int> refs,
+                          unordered_map<int, int> localRefs);
   // for Shortening
   void pushShorteningPktsToRedis(int pktnum,
                                  string keybase,
                                  int w,
                                  vector<int> idxlist,
-                                 unordered_map<int, int> refs);
-  void fetchWorker(BlockingQueue<OECDataPacket *> *fetchQueue,
+                                 unordered_map<int, int> refs,
+                                 unordered_map<int, int> localRefs);
+  // fetch keybase:0 to keybase:num-1 from the agent at loc, retrying while it cannot be reached
+  void fetchRemote(unsigned int loc, string keybase, int num, function<void(OECDataPacket *)> deliver);
+  void fetchWorker(SpscQueue<OECDataPacket *> *fetchQueue,
                    string keybase,
                    unsigned int loc,
                    int num);
-  void computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
+  // credits, if any, hold the stripes a source may run ahead of the slowest source
+  void fetchWorker(BlockingQueue<pair<int, OECDataPacket *>> *fetchQueue,
+                   SpscQueue<int> *credits,
+                   int srcidx,
+                   string keybase,
+                   unsigned int loc,
+                   int num);
+  void computeWorker(BlockingQueue<pair<int, OECDataPacket *>> *fetchQueue,
+                     SpscQueue<int> **credits,
                      int nprev,
                      int num,
                      unordered_map<int, vector<int>> coefs,
                      vector<int> cfor,
-                     BlockingQueue<OECDataPacket *> **writeQueue,
+                     SpscQueue<OECDataPacket *> **writeQueue,
                      int slicesize);
-  void computeWorker(BlockingQueue<OECDataPacket *> **fetchQueue,
+  void computeWorker(SpscQueue<OECDataPacket *> **fetchQueue,
                      int nprev,
                      vector<int> prevCids,
                      int num,
                      unordered_map<int, vector<int>> coefs,
                      vector<int> cfor,
-                     unordered_map<int, BlockingQueue<OECDataPacket *> *> writeQueue,
+                     unordered_map<int, SpscQueue<OECDataPacket *> *> writeQueue,
                      int slicesize);
-  void cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+  // publish pkt under key for refs fetches, localrefs of which are by tasks of this agent
+  void publish(DataSender *sender, string key, OECDataPacket *pkt, int refs, int localrefs);
+  // publish packets for other agents through the data transport, and for tasks of this agent in memory
+  void sendWorker(SpscQueue<OECDataPacket *> *writeQueue,
+                  string keybase,
+                  int num,
+                  int refs,
+                  int localrefs);
+  // cache packets in the local redis, e.g., for clients
+  void cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                    string keybase,
                    int num,
                    int refs);
-  void cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+  void cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                    string keybase,
                    int startidx,
                    int num,
                    int refs);
-  void cacheWorker(BlockingQueue<OECDataPacket *> *writeQueue,
+  void cacheWorker(SpscQueue<OECDataPacket *> *writeQueue,
                    string keybase,
                    int startidx,
                    int step,
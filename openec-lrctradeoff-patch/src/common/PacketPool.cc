@@ -0,0 +1,186 @@
+#include "PacketPool.hh"
+
+#include <sys/mman.h>
+
+PacketPool *PacketPool::_pool = NULL;
+once_flag PacketPool::_initFlag;
+
+// blocks cached by the current thread, returned to the shared lists on thread exit
+struct PacketCache
+{
+  unordered_map<int, vector<char *>> _freeMap;
+
+  ~PacketCache()
+  {
+    for (auto item : _freeMap)
+      for (auto block : item.second)
+        PacketPool::getPool()->releaseShared(block, item.first);
+  }
+};
+
+static thread_local PacketCache packetCache;
+
+PacketPool::PacketPool()
+{
+  _cachedBytes = 0;
+  _capacity = 1073741824;
+  _hugepage = false;
+  _hits = 0;
+  _misses = 0;
+  _inuseBytes = 0;
+  _highWater = 0;
+}
+
+PacketPool *PacketPool::getPool()
+{
+  // never deleted, as thread caches may return blocks during process exit
+  call_once(_initFlag, []
+            { _pool = new PacketPool(); });
+  return _pool;
+}
+
+int PacketPool::getBlockSize(int datalen)
+{
+  int blocksize = datalen + PACKETPOOL_ALIGN;
+  return (blocksize + PACKETPOOL_PAGE - 1) / PACKETPOOL_PAGE * PACKETPOOL_PAGE;
+}
+
+char *PacketPool::getRaw(char *block)
+{
+  return block + PACKETPOOL_ALIGN - 4;
+}
+
+void PacketPool::configure(long capacity, bool hugepage)
+{
+  lock_guard<mutex> lck(_lock);
+  _capacity = capacity;
+  _hugepage = hugepage;
+}
+
+char *PacketPool::newBlock(int blocksize)
+{
+  void *block = NULL;
+  if (_hugepage && blocksize >= PACKETPOOL_HUGEPAGE)
+  {
+    if (posix_memalign(&block, PACKETPOOL_HUGEPAGE, blocksize) != 0)
+      return NULL;
+    madvise(block, blocksize, MADV_HUGEPAGE);
+  }
+  else
+  {
+    if (posix_memalign(&block, PACKETPOOL_PAGE, blocksize) != 0)
+      return NULL;
+  }
+  return (char *)block;
+}
+
+void PacketPool::freeBlock(char *block)
+{
+  free(block);
+}
+
+char *PacketPool::allocate(int blocksize)
+{
+  char *block = NULL;
+  if (blocksize <= PACKETPOOL_MAX_BLOCK)
+  {
+    auto it = packetCache._freeMap.find(blocksize);
+    if (it != packetCache._freeMap.end() && !it->second.empty())
+    {
+      block = it->second.back();
+      it->second.pop_back();
+    }
+    else
+    {
+      lock_guard<mutex> lck(_lock);
+      auto it = _freeMap.find(blocksize);
+      if (it != _freeMap.end() && !it->second.empty())
+      {
+        block = it->second.back();
+        it->second.pop_back();
+        _cachedBytes -= blocksize;
+      }
+    }
+  }
+
+  if (block)
+  {
+    _hits++;
+  }
+  else
+  {
+    _misses++;
+    block = newBlock(blocksize);
+    if (!block)
+    {
+      cout << "PacketPool::allocate.alloc block fail, blocksize = " << blocksize << endl;
+      return NULL;
+    }
+  }
+
+  long inuse = (_inuseBytes += blocksize);
+  long highwater = _highWater;
+  while (inuse > highwater && !_highWater.compare_exchange_weak(highwater, inuse))
+    ;
+  return block;
+}
+
+void PacketPool::release(char *block, int blocksize)
+{
+  _inuseBytes -= blocksize;
+  if (blocksize > PACKETPOOL_MAX_BLOCK)
+  {
+    freeBlock(block);
+    return;
+  }
+  vector<char *> &cache = packetCache._freeMap[blocksize];
+  if (cache.size() < PACKETPOOL_THREAD_CACHE)
+  {
+    cache.push_back(block);
+    return;
+  }
+  releaseShared(block, blocksize);
+}
+
+void PacketPool::releaseShared(char *block, int blocksize)
+{
+  {
+    lock_guard<mutex> lck(_lock);
+    if (_cachedBytes + blocksize <= _capacity)
+    {
+      _freeMap[blocksize].push_back(block);
+      _cachedBytes += blocksize;
+      return;
+    }
+  }
+  freeBlock(block);
+}
+
+long PacketPool::getHits()
+{
+  return _hits;
+}
+
+long PacketPool::getMisses()
+{
+  return _misses;
+}
+
+long PacketPool::getHighWater()
+{
+  return _highWater;
+}
+
+void PacketPool::dump()
+{
+  long cached;
+  {
+    lock_guard<mutex> lck(_lock);
+    cached = _cachedBytes;
+  }
+  cout << "PacketPool::hits = " << _hits
+       << ", misses = " << _misses
+       << ", inuse = " << _inuseBytes
+       << ", highwater = " << _highWater
+       << ", cached = " << cached << endl;
+}
@@ -0,0 +1,68 @@
+#ifndef _PACKETPOOL_HH_
+#define _PACKETPOOL_HH_
+
+#include "../inc/include.hh"
+
+#include <atomic>
+
+using namespace std;
+
+#define PACKETPOOL_ALIGN 64
+#define PACKETPOOL_PAGE 4096
+#define PACKETPOOL_HUGEPAGE 2097152
+// blocks larger than this are not cached
+#define PACKETPOOL_MAX_BLOCK 67108864
+// number of blocks per size class kept by each thread
+#define PACKETPOOL_THREAD_CACHE 4
+
+/**
+ * Process-wide pool of packet buffers.
+ *
+ * A block is rounded up to a size class of whole pages and laid out so that
+ * raw = block + 60 holds the 4-byte length header and the data starting at
+ * block + 64 is 64-byte aligned. Freed blocks go to a small per-thread cache
+ * first, then to the shared free lists bounded by the configured capacity.
+ */
+class PacketPool
+{
+private:
+  unordered_map<int, vector<char *>> _freeMap;
+  mutex _lock;
+  long _cachedBytes;
+  long _capacity;
+  bool _hugepage;
+
+  atomic<long> _hits;
+  atomic<long> _misses;
+  atomic<long> _inuseBytes;
+  atomic<long> _highWater;
+
+  static PacketPool *_pool;
+  static once_flag _initFlag;
+
+  char *newBlock(int blocksize);
+  void freeBlock(char *block);
+
+public:
+  PacketPool();
+
+  static PacketPool *getPool();
+  static int getBlockSize(int datalen);
+  static char *getRaw(char *block);
+
+  // capacity of the shared free lists in bytes
+  void configure(long capacity, bool hugepage);
+
+  char *allocate(int blocksize);
+  void release(char *block, int blocksize);
+
+  // called by the per-thread cache when its thread exits
+  void releaseShared(char *block, int blocksize);
+
+  long getHits();
+  long getMisses();
+  long getHighWater();
+  void dump();
+};
+
+#endif
@@ -0,0 +1,424 @@
+#include "PlacementMigrator.hh"
+
+#include <climits>
+#include <unistd.h>
+#include <unordered_set>
+
+// a stripe that repairs keep relocating is given up after this many plans
+#define MIGRATOR_ATTEMPTS 3
+// cost of a group in a rack with fewer nodes than its blocks
+#define MIGRATOR_NOROOM 1000000
+
+PlacementMigrator::PlacementMigrator(Config *conf, StripeStore *ss, LinkScheduler *linkScheduler)
+{
+  _conf = conf;
+  _stripeStore = ss;
+  _linkScheduler = linkScheduler;
+  _worker = thread([=]
+                   { migrateLoop(); });
+}
+
+void PlacementMigrator::start(string ecpoolid, string ecid)
+{
+  _stripeStore->setMigration(ecpoolid, ecid);
+  _jobs.push(make_pair(ecpoolid, ecid));
+}
+
+void PlacementMigrator::resume()
+{
+  for (auto item : _stripeStore->getMigrations())
+  {
+    cout << "PlacementMigrator::resume " << item.first << " to " << item.second << endl;
+    _jobs.push(item);
+  }
+}
+
+void PlacementMigrator::migrateLoop()
+{
+  while (true)
+  {
+    pair<string, string> job = _jobs.pop();
+    migratePool(job.first, job.second);
+  }
+}
+
+void PlacementMigrator::migratePool(string ecpoolid, string ecid)
+{
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  ECPolicy *target = _conf->_ecPolicyMap[ecid];
+  vector<string> objs = _stripeStore->getObjsOfPool(ecpoolid);
+  vector<string> stripenames;
+  if (!objs.empty())
+  {
+    OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
+    unordered_set<string> stripes;
+    ecpool->lockShared();
+    for (auto objname : objs)
+      stripes.insert(ecpool->getStripeForObj(objname));
+    ecpool->unlockShared();
+    stripenames.assign(stripes.begin(), stripes.end());
+    sort(stripenames.begin(), stripenames.end());
+  }
+
+  int migrated = 0;
+  int skipped = 0;
+  for (auto stripename : stripenames)
+  {
+    OfflineECPool *ecpool = _stripeStore->getECPool(ecpoolid);
+    int ret = 0;
+    for (int attempt = 0; attempt < MIGRATOR_ATTEMPTS && ret == 0; attempt++)
+      ret = migrateStripe(ecpoolid, stripename, ecpool, target, ecid);
+    if (ret == 1)
+      migrated++;
+    else
+      skipped++;
+  }
+  _stripeStore->setMigration(ecpoolid, "");
+
+  gettimeofday(&time2, NULL);
+  cout << "PlacementMigrator::migratePool " << ecpoolid << " to " << ecid << ", migrated = " << migrated
+       << ", skipped = " << skipped << ", duration = " << RedisUtil::duration(time1, time2) << endl;
+}
+
+int PlacementMigrator::migrateStripe(string ecpoolid, string stripename, OfflineECPool *ecpool, ECPolicy *target, string ecid)
+{
+  ecpool->lockShared();
+  vector<string> stripeobjs = ecpool->getStripeObjList(stripename);
+  int basesizeMB = ecpool->getBasesize();
+  ECPolicy *poolpolicy = ecpool->getEcpolicy();
+  ecpool->unlockShared();
+  if (_stripeStore->getStripePolicy(stripename, poolpolicy) == target)
+    return 1;
+  // only an encoded stripe has all its blocks
+  if (stripeobjs.size() != target->getN())
+  {
+    cout << "PlacementMigrator::skip " << stripename << ", " << stripeobjs.size() << " blocks" << endl;
+    return -1;
+  }
+
+  _stripeStore->lockStripe(stripename);
+  vector<unsigned int> locs;
+  for (auto objname : stripeobjs)
+    locs.push_back(_stripeStore->getEntryFromObj(objname)->getLocOfObj(objname));
+  _stripeStore->unlockStripe(stripename);
+
+  ECBase *ec = target->createECClass();
+  vector<vector<int>> groups;
+  ec->Place(groups);
+  delete ec;
+  bool fail = false;
+  vector<BlockMove> moves = planMoves(stripeobjs, locs, groups, fail);
+  if (fail)
+  {
+    cout << "PlacementMigrator::skip " << stripename << ", the racks cannot hold the placement of " << ecid << endl;
+    return -1;
+  }
+  moveBlocks(stripename, moves, target->getW(), basesizeMB);
+
+  // switch the locations and the policy at once, unless a repair relocated a block meanwhile
+  _stripeStore->lockStripe(stripename);
+  bool relocated = false;
+  for (int i = 0; i < stripeobjs.size(); i++)
+  {
+    if (_stripeStore->getEntryFromObj(stripeobjs[i])->getLocOfObj(stripeobjs[i]) != locs[i])
+    {
+      cout << "PlacementMigrator::retry " << stripename << ", " << stripeobjs[i] << " is relocated" << endl;
+      relocated = true;
+    }
+  }
+  // the copy of a block that is still at its source is the block, it moves even if the
+  // stripe is planned again, which then finds it in place; the repair of a relocated
+  // block wins over its copy, which agents have no command to delete, so it only leaves
+  // the data load of its node
+  unordered_set<SSEntry *> entries;
+  int reclaimed = 0;
+  for (auto move : moves)
+  {
+    SSEntry *ssentry = _stripeStore->getEntryFromObj(move._objname);
+    if (ssentry->getLocOfObj(move._objname) != move._from)
+    {
+      cout << "PlacementMigrator::drop the copy of " << move._objname << " at " << RedisUtil::ip2Str(move._to) << endl;
+      _stripeStore->increaseDataLoadMap(move._to, -1);
+      continue;
+    }
+    ssentry->updateObjLoc(move._objname, move._to);
+    entries.insert(ssentry);
+    reclaimed++;
+  }
+  for (auto ssentry : entries)
+    _stripeStore->backupEntry(ssentry);
+  if (!relocated)
+    _stripeStore->setStripePolicy(ecpoolid, stripename, ecid);
+  _stripeStore->unlockStripe(stripename);
+  cout << "PlacementMigrator::migrateStripe " << stripename << " moves " << reclaimed << " of " << moves.size() << " blocks" << endl;
+  return relocated ? 0 : 1;
+}
+
+vector<BlockMove> PlacementMigrator::planMoves(vector<string> stripeobjs, vector<unsigned int> locs, vector<vector<int>> groups, bool &fail)
+{
+  vector<BlockMove> toret;
+  // a block in no group is a group of its own
+  vector<bool> grouped(stripeobjs.size(), false);
+  for (auto group : groups)
+  {
+    for (auto sid : group)
+      grouped[sid] = true;
+  }
+  for (int sid = 0; sid < stripeobjs.size(); sid++)
+  {
+    if (!grouped[sid])
+      groups.push_back({sid});
+  }
+
+  vector<string> racks;
+  for (auto item : _conf->_rack2Ips)
+    racks.push_back(item.first);
+  sort(racks.begin(), racks.end());
+  unordered_map<string, int> rackIdx;
+  vector<int> rackNodes;
+  for (int r = 0; r < racks.size(); r++)
+  {
+    rackIdx.insert(make_pair(racks[r], r));
+    rackNodes.push_back(_conf->_rack2Ips[racks[r]].size());
+  }
+  vector<int> blockRack;
+  for (auto loc : locs)
+  {
+    unordered_map<unsigned int, string>::iterator it = _conf->_ip2Rack.find(loc);
+    blockRack.push_back(it == _conf->_ip2Rack.end() ? -1 : rackIdx[it->second]);
+  }
+
+  vector<vector<int>> cost;
+  vector<int> groupSizes;
+  for (auto group : groups)
+  {
+    vector<int> groupCost(racks.size(), group.size());
+    for (auto sid : group)
+    {
+      if (blockRack[sid] >= 0)
+        groupCost[blockRack[sid]]--;
+    }
+    cost.push_back(groupCost);
+    groupSizes.push_back(group.size());
+  }
+  vector<int> assign = assignGroups(cost, groupSizes, rackNodes);
+  if (assign.empty() || assign[0] < 0)
+  {
+    fail = true;
+    return toret;
+  }
+
+  // blocks already in the rack of their group keep their nodes
+  unordered_set<unsigned int> occupied;
+  for (int g = 0; g < groups.size(); g++)
+  {
+    for (auto sid : groups[g])
+    {
+      if (blockRack[sid] == assign[g])
+        occupied.insert(locs[sid]);
+    }
+  }
+  for (int g = 0; g < groups.size(); g++)
+  {
+    for (auto sid : groups[g])
+    {
+      if (blockRack[sid] == assign[g])
+        continue;
+      // the least loaded free node of the rack
+      unsigned int to = 0;
+      for (auto ip : _conf->_rack2Ips[racks[assign[g]]])
+      {
+        if (occupied.find(ip) != occupied.end())
+          continue;
+        if (to == 0 || _stripeStore->getDataLoad(ip) < _stripeStore->getDataLoad(to))
+          to = ip;
+      }
+      if (to == 0)
+      {
+        // no free node is left in the rack, give up the stripe and the nodes taken so far
+        for (auto move : toret)
+          _stripeStore->increaseDataLoadMap(move._to, -1);
+        fail = true;
+        return vector<BlockMove>();
+      }
+      _stripeStore->increaseDataLoadMap(to, 1);
+      occupied.insert(to);
+      BlockMove move;
+      move._sid = sid;
+      move._objname = stripeobjs[sid];
+      move._from = locs[sid];
+      move._to = to;
+      toret.push_back(move);
+    }
+  }
+  return toret;
+}
+
+void PlacementMigrator::moveBlocks(string stripename, vector<BlockMove> moves, int ecw, int basesizeMB)
+{
+  if (moves.empty())
+    return;
+  struct timeval time1, time2;
+  gettimeofday(&time1, NULL);
+  long blockBytes = (long)basesizeMB * 1048576;
+  int pktnum = blockBytes / _conf->_pktSize;
+  // keys of the moved blocks apart from those of the degraded reads and repairs of the stripe
+  string keyname = stripename + "-migrate";
+
+  unordered_map<int, AGCommand *> readCmds;
+  vector<AGCommand *> persistCmds;
+  for (auto move : moves)
+  {
+    vector<int> cids;
+    unordered_map<int, int> refs;
+    for (int j = 0; j < ecw; j++)
+    {
+      int cid = move._sid * ecw + j;
+      cids.push_back(cid);
+      refs.insert(make_pair(cid, 1));
+    }
+    AGCommand *readCmd = new AGCommand();
+    readCmd->buildType2(2, move._from, keyname, ecw, pktnum, move._objname, cids, refs);
+    readCmds.insert(make_pair(move._sid, readCmd));
+    vector<unsigned int> prevLocs(ecw, move._from);
+    AGCommand *persistCmd = new AGCommand();
+    persistCmd->buildType5(5, move._to, keyname, ecw, pktnum, ecw, cids, prevLocs, move._objname);
+    persistCmds.push_back(persistCmd);
+  }
+
+  // moves share the cross-rack links with repairs
+  int linkid = _linkScheduler->reserveRepair(_linkScheduler->demand(readCmds, persistCmds, blockBytes / ecw));
+  vector<char *> todelete;
+  redisContext *distCtx = RedisUtil::createContext(_conf->_coorIp);
+  redisAppendCommand(distCtx, "MULTI");
+  for (int i = 0; i < moves.size() * 2; i++)
+  {
+    AGCommand *agcmd = i < moves.size() ? readCmds[moves[i]._sid] : persistCmds[i - moves.size()];
+    unsigned int ip = htonl(agcmd->getSendIp());
+    char *cmdstr = agcmd->getCmd();
+    int cmLen = agcmd->getCmdLen();
+    char *todist = (char *)calloc(cmLen + 4, sizeof(char));
+    memcpy(todist, (char *)&ip, 4);
+    memcpy(todist + 4, cmdstr, cmLen);
+    todelete.push_back(todist);
+    redisAppendCommand(distCtx, "RPUSH dist_request %b", todist, cmLen + 4);
+  }
+  redisAppendCommand(distCtx, "EXEC");
+
+  redisReply *distReply;
+  for (int i = 0; i < todelete.size() + 2; i++)
+  {
+    redisGetReply(distCtx, (void **)&distReply);
+    freeReplyObject(distReply);
+  }
+  redisFree(distCtx);
+
+  // wait for the moved blocks to be persisted
+  for (auto agcmd : persistCmds)
+  {
+    redisContext *waitCtx = RedisUtil::createContext(agcmd->getSendIp());
+    string wkey = "writefinish:" + agcmd->getWriteObjName();
+    redisReply *fReply = (redisReply *)redisCommand(waitCtx, "blpop %s 0", wkey.c_str());
+    freeReplyObject(fReply);
+    redisFree(waitCtx);
+  }
+  _linkScheduler->release(linkid);
+
+  for (auto item : readCmds)
+    delete item.second;
+  for (auto item : persistCmds)
+    delete item;
+  for (auto item : todelete)
+    free(item);
+
+  // pace the migration to oec.migration.mbps
+  gettimeofday(&time2, NULL);
+  double duration = RedisUtil::duration(time1, time2);
+  if (_conf->_migrationMbps > 0)
+  {
+    double paced = (double)blockBytes * moves.size() * 8 / _conf->_migrationMbps / 1000;
+    if (duration < paced)
+      usleep((long)((paced - duration) * 1000));
+  }
+}
+
+vector<int> PlacementMigrator::assignGroups(vector<vector<int>> cost, vector<int> groupSizes, vector<int> rackNodes)
+{
+  int n = cost.size();
+  int m = rackNodes.size();
+  if (n > m)
+    return vector<int>(n, -1);
+
+  // Hungarian method on the n x m costs, with rows and columns counted from 1
+  vector<vector<long>> a(n + 1, vector<long>(m + 1, 0));
+  for (int g = 0; g < n; g++)
+  {
+    for (int r = 0; r < m; r++)
+      a[g + 1][r + 1] = rackNodes[r] < groupSizes[g] ? MIGRATOR_NOROOM : cost[g][r];
+  }
+  vector<long> u(n + 1, 0), v(m + 1, 0);
+  vector<int> p(m + 1, 0), way(m + 1, 0);
+  for (int i = 1; i <= n; i++)
+  {
+    p[0] = i;
+    int j0 = 0;
+    vector<long> minv(m + 1, LONG_MAX);
+    vector<bool> used(m + 1, false);
+    do
+    {
+      used[j0] = true;
+      int i0 = p[j0];
+      long delta = LONG_MAX;
+      int j1 = 0;
+      for (int j = 1; j <= m; j++)
+      {
+        if (used[j])
+          continue;
+        long cur = a[i0][j] - u[i0] - v[j];
+        if (cur < minv[j])
+        {
+          minv[j] = cur;
+          way[j] = j0;
+        }
+        if (minv[j] < delta)
+        {
+          delta = minv[j];
+          j1 = j;
+        }
+      }
+      for (int j = 0; j <= m; j++)
+      {
+        if (used[j])
+        {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        }
+        else
+        {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    do
+    {
+      int j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  vector<int> toret(n, -1);
+  for (int j = 1; j <= m; j++)
+  {
+    if (p[j] != 0)
+      toret[p[j] - 1] = j - 1;
+  }
+  for (int g = 0; g < n; g++)
+  {
+    if (toret[g] < 0 || a[g + 1][toret[g] + 1] >= MIGRATOR_NOROOM)
+      return vector<int>(n, -1);
+  }
+  return toret;
+}
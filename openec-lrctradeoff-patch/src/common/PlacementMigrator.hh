@@ -0,0 +1,78 @@
+#ifndef _PLACEMENTMIGRATOR_HH_
+#define _PLACEMENTMIGRATOR_HH_
+
+#include "BlockingQueue.hh"
+#include "Config.hh"
+#include "LinkScheduler.hh"
+#include "StripeStore.hh"
+
+#include "../ec/OfflineECPool.hh"
+#include "../inc/include.hh"
+#include "../protocol/AGCommand.hh"
+#include "../util/RedisUtil.hh"
+
+using namespace std;
+
+// a block that a migration moves to another rack
+struct BlockMove
+{
+  int _sid;
+  string _objname;
+  unsigned int _from;
+  unsigned int _to;
+};
+
+/**
+ * Background migration of the stripes of a pool to the placement of another
+ * policy of the same code, e.g., from AF_14_10 or AT_14_10_0 to AT_14_10_2,
+ * without rewriting the data.
+ *
+ * For each stripe, the groups of the target Place() are given racks so that
+ * the fewest blocks move, by an assignment of groups to distinct racks with
+ * the least cost, the blocks of a group that are not in its rack yet. The
+ * moved blocks are read by their agent and persisted under their own names
+ * by an agent of the new rack, as repairs do, admitted by the link
+ * scheduler like repairs and paced to oec.migration.mbps. The new locations
+ * and the policy of the stripe then switch under the lock of the stripe.
+ * If a repair relocated a block of the stripe meanwhile, the copies of the
+ * other blocks are kept, and the stripe is planned again from there.
+ *
+ * A migration is logged in the stripe store until it is done, and so is the
+ * policy of every migrated stripe, so a coordinator that restarts resumes the
+ * migration past the stripes already migrated. One pool migrates at a time.
+ */
+class PlacementMigrator
+{
+private:
+  Config *_conf;
+  StripeStore *_stripeStore;
+  LinkScheduler *_linkScheduler;
+
+  // pools to migrate with the ecid of their target placement
+  BlockingQueue<pair<string, string>> _jobs;
+  thread _worker;
+
+  void migrateLoop();
+  void migratePool(string ecpoolid, string ecid);
+  // 1 once the stripe is at the target placement, 0 to try it again, -1 if it cannot migrate
+  int migrateStripe(string ecpoolid, string stripename, OfflineECPool *ecpool, ECPolicy *target, string ecid);
+  // moves that turn locs into the placement of groups, each counted in the data load of its new node,
+  // empty with fail set and nothing counted if the racks cannot hold the groups
+  vector<BlockMove> planMoves(vector<string> stripeobjs, vector<unsigned int> locs, vector<vector<int>> groups, bool &fail);
+  // read each moved block at its agent and persist it at its new one, paced to oec.migration.mbps
+  void moveBlocks(string stripename, vector<BlockMove> moves, int ecw, int basesizeMB);
+
+public:
+  PlacementMigrator(Config *conf, StripeStore *ss, LinkScheduler *linkScheduler);
+
+  // migrate ecpoolid to the placement of ecid in the background
+  void start(string ecpoolid, string ecid);
+  // start the migrations that a previous coordinator left unfinished
+  void resume();
+
+  // rack of each group, distinct and with enough nodes, so that the fewest blocks move; -1s if there is none
+  // cost[g][r] is the number of blocks of group g that are not in rack r
+  static vector<int> assignGroups(vector<vector<int>> cost, vector<int> groupSizes, vector<int> rackNodes);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "PlanCache.hh"
+
+PlanCache::PlanCache(int capacity)
+{
+  _capacity = capacity;
+  _hits = 0;
+  _misses = 0;
+}
+
+PlanCache::~PlanCache()
+{
+  for (auto item : _planMap)
+  {
+    delete item.second->_ecdag;
+    delete item.second;
+  }
+}
+
+string PlanCache::genKey(string ecid, string mode, vector<int> integrity,
+                         unordered_map<int, unsigned int> &sid2ip,
+                         unordered_map<unsigned int, string> &ip2Rack)
+{
+  string key = ecid + "|" + mode + "|";
+  for (auto i : integrity)
+    key += to_string(i);
+  key += "|";
+
+  // number nodes and racks by the first block placed on them, so that the
+  // key only tells which blocks are together
+  unordered_map<unsigned int, int> ip2class;
+  unordered_map<string, int> rack2class;
+  for (int sid = 0; sid < sid2ip.size(); sid++)
+  {
+    unsigned int ip = sid2ip[sid];
+    string rack;
+    unordered_map<unsigned int, string>::iterator it = ip2Rack.find(ip);
+    if (it != ip2Rack.end())
+      rack = it->second;
+    if (ip2class.find(ip) == ip2class.end())
+      ip2class.insert(make_pair(ip, ip2class.size()));
+    if (rack2class.find(rack) == rack2class.end())
+      rack2class.insert(make_pair(rack, rack2class.size()));
+    key += to_string(ip2class[ip]) + ":" + to_string(rack2class[rack]) + ",";
+  }
+  return key;
+}
+
+ECDAG *PlanCache::lookup(string key, unordered_map<int, unsigned int> &sid2ip, unordered_map<int, unsigned int> &cid2ip)
+{
+  RepairPlan *plan = NULL;
+  _lock.lock();
+  unordered_map<string, RepairPlan *>::iterator it = _planMap.find(key);
+  if (it != _planMap.end())
+  {
+    plan = it->second;
+    _hits++;
+  }
+  else
+  {
+    _misses++;
+  }
+  if (PLANCACHE_DEBUG_ENABLE)
+    cout << "PlanCache::lookup " << key << (plan ? " hit" : " miss") << ", hits = " << _hits << ", misses = " << _misses << endl;
+  _lock.unlock();
+  if (!plan)
+    return NULL;
+
+  // a kept plan is never changed, so it is copied out of the lock
+  for (auto item : plan->_cid2sid)
+    cid2ip.insert(make_pair(item.first, sid2ip[item.second]));
+  return plan->_ecdag->clone();
+}
+
+void PlanCache::insert(string key, ECDAG *ecdag, unordered_map<int, unsigned int> &sid2ip, unordered_map<int, unsigned int> &cid2ip)
+{
+  if (_capacity <= 0)
+    return;
+
+  unordered_map<unsigned int, int> ip2sid;
+  for (int sid = 0; sid < sid2ip.size(); sid++)
+  {
+    if (ip2sid.find(sid2ip[sid]) == ip2sid.end())
+      ip2sid.insert(make_pair(sid2ip[sid], sid));
+  }
+  RepairPlan *plan = new RepairPlan();
+  for (auto item : cid2ip)
+  {
+    unordered_map<unsigned int, int>::iterator it = ip2sid.find(item.second);
+    if (it == ip2sid.end())
+    {
+      // the node is placed away from the blocks, there is nothing to bind it to
+      delete plan;
+      return;
+    }
+    plan->_cid2sid.insert(make_pair(item.first, it->second));
+  }
+  plan->_ecdag = ecdag->clone();
+
+  _lock.lock();
+  bool inserted = _planMap.size() < _capacity && _planMap.insert(make_pair(key, plan)).second;
+  _lock.unlock();
+  if (!inserted)
+  {
+    delete plan->_ecdag;
+    delete plan;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _PLANCACHE_HH_
+#define _PLANCACHE_HH_
+
+#include "../ec/ECDAG.hh"
+#include "../inc/include.hh"
+
+using namespace std;
+
+#define PLANCACHE_DEBUG_ENABLE false
+
+// an optimized ecdag with the node locations as block indices instead of ips
+struct RepairPlan
+{
+  ECDAG *_ecdag;
+  // cid -> sid of the block whose location the node is placed at
+  unordered_map<int, int> _cid2sid;
+};
+
+/**
+ * Repair plans of the coordinator, reused across stripes.
+ *
+ * Decode, reconstruct, candidateIps and optimize2 give the same ecdag for
+ * stripes of the same policy with the same failed blocks, when their blocks
+ * are laid out alike: the same blocks share a node and the same blocks share
+ * a rack. Such a plan is kept with the location of each node as the block it
+ * is placed with, and bound to the ips and object names of another stripe at
+ * request time. Plans that place a node away from every block of the stripe
+ * are not kept.
+ */
+class PlanCache
+{
+private:
+  int _capacity;
+
+  mutex _lock;
+  unordered_map<string, RepairPlan *> _planMap;
+  long _hits;
+  long _misses;
+
+public:
+  // keeps up to capacity plans, 0 keeps none
+  PlanCache(int capacity);
+  ~PlanCache();
+
+  // mode tells apart the planners, integrity has 0 for the blocks to recover
+  static string genKey(string ecid, string mode, vector<int> integrity,
+                       unordered_map<int, unsigned int> &sid2ip,
+                       unordered_map<unsigned int, string> &ip2Rack);
+
+  // a new ecdag of the plan under key with its node ips in cid2ip, NULL on a miss
+  ECDAG *lookup(string key, unordered_map<int, unsigned int> &sid2ip, unordered_map<int, unsigned int> &cid2ip);
+  // keep a copy of an optimized ecdag, before it is parsed
+  void insert(string key, ECDAG *ecdag, unordered_map<int, unsigned int> &sid2ip, unordered_map<int, unsigned int> &cid2ip);
+};
+
+#endif
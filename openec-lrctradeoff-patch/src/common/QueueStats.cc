@@ -0,0 +1,36 @@
+#include "QueueStats.hh"
+
+mutex QueueStats::_lock;
+unordered_map<string, pair<int, int>> QueueStats::_stageMap;
+
+void QueueStats::record(string stage, int highwater, int capacity)
+{
+  lock_guard<mutex> lck(_lock);
+  auto it = _stageMap.find(stage);
+  if (it == _stageMap.end())
+  {
+    _stageMap.insert(make_pair(stage, make_pair(highwater, capacity)));
+    return;
+  }
+  it->second.first = max(it->second.first, highwater);
+  it->second.second = capacity;
+}
+
+int QueueStats::getHighWater(string stage)
+{
+  lock_guard<mutex> lck(_lock);
+  auto it = _stageMap.find(stage);
+  if (it == _stageMap.end())
+    return 0;
+  return it->second.first;
+}
+
+void QueueStats::dump()
+{
+  lock_guard<mutex> lck(_lock);
+  for (auto item : _stageMap)
+  {
+    string capacity = item.second.second > 0 ? to_string(item.second.second) : "unbounded";
+    cout << "QueueStats::" << item.first << ".highwater = " << item.second.first << " / " << capacity << endl;
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef _QUEUESTATS_HH_
+#define _QUEUESTATS_HH_
+
+#include "../inc/include.hh"
+
+using namespace std;
+
+/**
+ * Process-wide high-water marks of pipeline queues, kept per stage, so that
+ * the memory an agent buffers in each stage can be sized from them.
+ */
+class QueueStats
+{
+private:
+  static mutex _lock;
+  // stage -> largest length reached, and capacity of that stage
+  static unordered_map<string, pair<int, int>> _stageMap;
+
+public:
+  static void record(string stage, int highwater, int capacity);
+  static int getHighWater(string stage);
+  static void dump();
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "RepairLoad.hh"
+
+RepairLoad::RepairLoad(Config *conf)
+{
+  _conf = conf;
+}
+
+long RepairLoad::getNodeLoad(unsigned int ip)
+{
+  unordered_map<unsigned int, long>::iterator it = _nodeLoad.find(ip);
+  return it == _nodeLoad.end() ? 0 : it->second;
+}
+
+long RepairLoad::getUplinkLoad(string rack)
+{
+  unordered_map<string, long>::iterator it = _uplinkLoad.find(rack);
+  return it == _uplinkLoad.end() ? 0 : it->second;
+}
+
+unordered_map<string, long> RepairLoad::getRackOut()
+{
+  return _rackOut;
+}
+
+unordered_map<string, long> RepairLoad::getRackIn()
+{
+  return _rackIn;
+}
+
+string RepairLoad::getRack(unsigned int ip)
+{
+  // find, as the config is shared by the workers of the coordinator
+  unordered_map<unsigned int, string>::iterator it = _conf->_ip2Rack.find(ip);
+  return it == _conf->_ip2Rack.end() ? RedisUtil::ip2Str(ip) : it->second;
+}
+
+unsigned int RepairLoad::choose(vector<unsigned int> candidates)
+{
+  assert(candidates.size() > 0);
+  unsigned int minip = candidates[0];
+  long minload = -1;
+  for (auto ip : candidates)
+  {
+    long load = getNodeLoad(ip) + getUplinkLoad(getRack(ip));
+    if (minload < 0 || load < minload)
+    {
+      minload = load;
+      minip = ip;
+    }
+  }
+  return minip;
+}
+
+void RepairLoad::addTransfer(unsigned int from, unsigned int to, int num)
+{
+  // 0 is the same agent as to
+  if (from == 0 || from == to)
+    return;
+  _nodeLoad[from] += num;
+  _nodeLoad[to] += num;
+  string fromRack = getRack(from);
+  string toRack = getRack(to);
+  if (fromRack != toRack)
+  {
+    _uplinkLoad[fromRack] += num;
+    _uplinkLoad[toRack] += num;
+    _rackOut[fromRack] += num;
+    _rackIn[toRack] += num;
+  }
+}
+
+void RepairLoad::addCommand(AGCommand *cmd)
+{
+  int type = cmd->getType();
+  unsigned int ip = cmd->getSendIp();
+  if (type == 13)
+  {
+    for (auto subCmd : cmd->getSubCmds())
+      addCommand(subCmd);
+    return;
+  }
+  // read
+  if (type == 2 || type == 7 || type == 12)
+    _nodeLoad[ip] += cmd->getReadCidList().size();
+  // fetch
+  if (type == 3 || type == 5 || type == 7)
+  {
+    // the cid read by type 7 itself has 0 as its prevloc
+    for (auto loc : cmd->getPrevLocs())
+      addTransfer(loc, ip, 1);
+  }
+  // compute
+  if (type == 3 || type == 7)
+    _nodeLoad[ip] += cmd->getCoefs().size();
+  // persist
+  if (type == 5)
+    _nodeLoad[ip] += cmd->getNprevs();
+}
+
+void RepairLoad::add(unordered_map<int, AGCommand *> agCmds, vector<AGCommand *> persistCmds)
+{
+  for (auto item : agCmds)
+    addCommand(item.second);
+  for (auto cmd : persistCmds)
+    addCommand(cmd);
+}
+
+void RepairLoad::dump()
+{
+  long maxNode = 0;
+  unsigned int hotNode = 0;
+  for (auto item : _nodeLoad)
+  {
+    if (item.second > maxNode)
+    {
+      maxNode = item.second;
+      hotNode = item.first;
+    }
+  }
+  long maxUplink = 0;
+  string hotRack;
+  for (auto item : _uplinkLoad)
+  {
+    if (item.second > maxUplink)
+    {
+      maxUplink = item.second;
+      hotRack = item.first;
+    }
+  }
+  cout << "RepairLoad::hottest node " << RedisUtil::ip2Str(hotNode) << " = " << maxNode
+       << ", hottest uplink " << hotRack << " = " << maxUplink << " sub-blocks" << endl;
+}
@@ -0,0 +1,53 @@
+#ifndef _REPAIRLOAD_HH_
+#define _REPAIRLOAD_HH_
+
+#include "Config.hh"
+
+#include "../inc/include.hh"
+#include "../protocol/AGCommand.hh"
+
+using namespace std;
+
+/**
+ * Load that the repairs of a batch put on each node and each rack uplink,
+ * so that the coordinator co-plans the stripes of a failed node or rack.
+ *
+ * Loads are counted in sub-blocks (1/w of a block) from the parsed commands
+ * of each planned stripe: a node is charged for the sub-blocks it reads,
+ * computes, sends, receives and persists, and a rack uplink for the
+ * sub-blocks that cross it in either direction. A location is chosen for the
+ * next stripe by the load of the node plus the load of its uplink, so that
+ * the hottest node and the hottest uplink grow as slowly as they can.
+ */
+class RepairLoad
+{
+private:
+  Config *_conf;
+  unordered_map<unsigned int, long> _nodeLoad;
+  unordered_map<string, long> _uplinkLoad;
+  // the sub-blocks that leave and enter each rack
+  unordered_map<string, long> _rackOut;
+  unordered_map<string, long> _rackIn;
+
+  void addCommand(AGCommand *cmd);
+  // the rack of ip, with an ip out of the rack map, like a client, as a rack of its own
+  string getRack(unsigned int ip);
+
+public:
+  RepairLoad(Config *conf);
+
+  // the least loaded of candidates, which should not be empty
+  unsigned int choose(vector<unsigned int> candidates);
+  // charge num sub-blocks sent from one node to another, 0 as from is the same node as to
+  void addTransfer(unsigned int from, unsigned int to, int num);
+  // charge the commands of a planned stripe
+  void add(unordered_map<int, AGCommand *> agCmds, vector<AGCommand *> persistCmds);
+
+  long getNodeLoad(unsigned int ip);
+  long getUplinkLoad(string rack);
+  unordered_map<string, long> getRackOut();
+  unordered_map<string, long> getRackIn();
+  void dump();
+};
+
+#endif
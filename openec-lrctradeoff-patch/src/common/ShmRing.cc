@@ -0,0 +1,227 @@
+#include "ShmRing.hh"
+
+#include <climits>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+atomic<int> ShmRing::_ringid(0);
+
+ShmRing::ShmRing(string name, char *base, long mapsize, bool linked)
+{
+  _name = name;
+  _base = base;
+  _mapsize = mapsize;
+  _linked = linked;
+  _header = (ShmRingHeader *)base;
+  _slotSeq = (uint64_t *)(base + SHMRING_ALIGN);
+}
+
+ShmRing::~ShmRing()
+{
+  unlink();
+  munmap(_base, _mapsize);
+}
+
+string ShmRing::genName()
+{
+  return "/oec-" + to_string(getpid()) + "-" + to_string(_ringid++);
+}
+
+ShmRing *ShmRing::create(string name, int slotnum, int rawlen)
+{
+  // the data of a slot starts at a 64-byte boundary, after the 4-byte length
+  int slotsize = (rawlen - 4 + SHMRING_ALIGN * 2 - 1) / SHMRING_ALIGN * SHMRING_ALIGN;
+  int slotoff = (SHMRING_ALIGN + slotnum * sizeof(uint64_t) + 4095) / 4096 * 4096;
+  long mapsize = slotoff + (long)slotnum * slotsize;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    return NULL;
+  if (ftruncate(fd, mapsize) < 0)
+  {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return NULL;
+  }
+  char *base = (char *)mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+  {
+    shm_unlink(name.c_str());
+    return NULL;
+  }
+
+  ShmRing *ring = new ShmRing(name, base, mapsize, true);
+  ShmRingHeader *header = ring->_header;
+  header->_slotnum = slotnum;
+  header->_slotsize = slotsize;
+  header->_slotoff = slotoff;
+  header->_fillSeq = 0;
+  header->_fillWaiters = 0;
+  header->_freeSeq = 0;
+  header->_freeWaiters = 0;
+  for (int i = 0; i < slotnum; i++)
+    ring->_slotSeq[i] = 2 * (uint64_t)i;
+  __atomic_store_n(&header->_magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+  return ring;
+}
+
+ShmRing *ShmRing::attach(string name)
+{
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < SHMRING_ALIGN)
+  {
+    ::close(fd);
+    return NULL;
+  }
+  char *base = (char *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+  if (__atomic_load_n(&((ShmRingHeader *)base)->_magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC)
+  {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+  return new ShmRing(name, base, st.st_size, false);
+}
+
+shared_ptr<ShmRing> ShmRing::offer(int slotnum, int rawlen)
+{
+  return shared_ptr<ShmRing>(create(genName(), slotnum, rawlen));
+}
+
+bool ShmRing::waitAccept(redisContext *ctx, string name)
+{
+  string wkey = "shmack:" + name;
+  redisReply *rReply = (redisReply *)redisCommand(ctx, "blpop %s 0", wkey.c_str());
+  bool accepted = rReply->element[1]->str[0] == '1';
+  freeReplyObject(rReply);
+  return accepted;
+}
+
+shared_ptr<ShmRing> ShmRing::accept(redisContext *ctx, string name, int minslots)
+{
+  if (name.empty())
+    return nullptr;
+
+  shared_ptr<ShmRing> ring(attach(name));
+  if (ring && ring->getSlotNum() < minslots)
+  {
+    cout << "ShmRing::accept " << name << " has " << ring->getSlotNum() << " slots, " << minslots << " needed" << endl;
+    ring = nullptr;
+  }
+  string akey = "shmack:" + name;
+  string ack = ring ? "1" : "0";
+  redisReply *rReply = (redisReply *)redisCommand(ctx, "rpush %s %b", akey.c_str(), ack.c_str(), ack.size());
+  freeReplyObject(rReply);
+  return ring;
+}
+
+void ShmRing::unlink()
+{
+  if (_linked)
+  {
+    shm_unlink(_name.c_str());
+    _linked = false;
+  }
+}
+
+string ShmRing::getName()
+{
+  return _name;
+}
+
+int ShmRing::getSlotNum()
+{
+  return _header->_slotnum;
+}
+
+int ShmRing::getRawLen()
+{
+  return _header->_slotsize - SHMRING_ALIGN + 4;
+}
+
+char *ShmRing::getSlot(int pktid)
+{
+  int slotid = pktid % _header->_slotnum;
+  return _base + _header->_slotoff + (long)slotid * _header->_slotsize + SHMRING_ALIGN - 4;
+}
+
+void ShmRing::wait(uint32_t *seqword, uint32_t *waiters, uint64_t *slotseq, uint64_t expected)
+{
+  for (int i = 0; i < SHMRING_SPIN; i++)
+  {
+    if (__atomic_load_n(slotseq, __ATOMIC_ACQUIRE) == expected)
+      return;
+  }
+  while (true)
+  {
+    // register as a sleeper before the last check, so that a notify after it wakes us
+    __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    uint32_t curseq = __atomic_load_n(seqword, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(slotseq, __ATOMIC_SEQ_CST) == expected)
+    {
+      __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+      return;
+    }
+    syscall(SYS_futex, seqword, FUTEX_WAIT, curseq, NULL, NULL, 0);
+    __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void ShmRing::notify(uint32_t *seqword, uint32_t *waiters)
+{
+  __atomic_add_fetch(seqword, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST) > 0)
+    syscall(SYS_futex, seqword, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+char *ShmRing::acquire(int pktid)
+{
+  uint64_t *slotseq = &_slotSeq[pktid % _header->_slotnum];
+  wait(&_header->_freeSeq, &_header->_freeWaiters, slotseq, 2 * (uint64_t)pktid);
+  return getSlot(pktid);
+}
+
+void ShmRing::publish(int pktid)
+{
+  uint64_t *slotseq = &_slotSeq[pktid % _header->_slotnum];
+  __atomic_store_n(slotseq, 2 * (uint64_t)pktid + 1, __ATOMIC_SEQ_CST);
+  notify(&_header->_fillSeq, &_header->_fillWaiters);
+}
+
+char *ShmRing::take(int pktid)
+{
+  uint64_t *slotseq = &_slotSeq[pktid % _header->_slotnum];
+  wait(&_header->_fillSeq, &_header->_fillWaiters, slotseq, 2 * (uint64_t)pktid + 1);
+  return getSlot(pktid);
+}
+
+void ShmRing::release(int pktid)
+{
+  // the slot is free for the packet that is slotnum packets later
+  uint64_t *slotseq = &_slotSeq[pktid % _header->_slotnum];
+  __atomic_store_n(slotseq, 2 * ((uint64_t)pktid + _header->_slotnum), __ATOMIC_SEQ_CST);
+  notify(&_header->_freeSeq, &_header->_freeWaiters);
+}
+
+void ShmRing::redirect(int pktid)
+{
+  int tmplen = htonl(SHMRING_REDIRECT);
+  memcpy(acquire(pktid), (char *)&tmplen, 4);
+  publish(pktid);
+}
+
+bool ShmRing::isRedirect(char *raw)
+{
+  int tmplen;
+  memcpy((char *)&tmplen, raw, 4);
+  return (int)ntohl(tmplen) == SHMRING_REDIRECT;
+}
@@ -0,0 +1,101 @@
+#ifndef _SHMRING_HH_
+#define _SHMRING_HH_
+
+#include "../inc/include.hh"
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+#define SHMRING_MAGIC 0x4f454352
+#define SHMRING_ALIGN 64
+// polls of a slot before sleeping on the futex
+#define SHMRING_SPIN 1024
+// length of a slot whose packet does not fit, the packet is in Redis under its key instead
+#define SHMRING_REDIRECT -1
+
+// placed at the beginning of the shared memory
+struct ShmRingHeader
+{
+  uint32_t _magic;
+  int32_t _slotnum;
+  int32_t _slotsize;
+  int32_t _slotoff;
+
+  // futex words bumped when a slot is filled or freed, and their sleepers
+  uint32_t _fillSeq;
+  uint32_t _fillWaiters;
+  uint32_t _freeSeq;
+  uint32_t _freeWaiters;
+};
+
+/**
+ * Ring of packet slots in POSIX shared memory between a client stream and its
+ * local agent.
+ *
+ * Packet pktid lives in slot pktid % slotnum. Each slot has a sequence number
+ * that is 2 * pktid while it is free for pktid and 2 * pktid + 1 once pktid
+ * is in it, so producers may fill and the consumer may free slots in any
+ * order, as with the per-packet keys in Redis. A slot holds the raw of a
+ * packet, |len|data|, with the data 64-byte aligned. A packet larger than a
+ * slot goes through Redis, and its slot only holds SHMRING_REDIRECT as len.
+ *
+ * Both sides spin shortly and then sleep on a futex in the shared memory.
+ */
+class ShmRing
+{
+private:
+  string _name;
+  char *_base;
+  long _mapsize;
+  bool _linked;
+
+  ShmRingHeader *_header;
+  uint64_t *_slotSeq;
+
+  static atomic<int> _ringid;
+
+  ShmRing(string name, char *base, long mapsize, bool linked);
+  char *getSlot(int pktid);
+  void wait(uint32_t *seqword, uint32_t *waiters, uint64_t *slotseq, uint64_t expected);
+  void notify(uint32_t *seqword, uint32_t *waiters);
+
+public:
+  ~ShmRing();
+
+  // a name unique to this process
+  static string genName();
+  // create a ring of slotnum slots, each holding a raw of up to rawlen bytes
+  static ShmRing *create(string name, int slotnum, int rawlen);
+  // map a ring created by another process, NULL if it does not exist on this host
+  static ShmRing *attach(string name);
+
+  // handshake around the request of a client: the client names its ring in the
+  // request, and the agent answers under shmack:name in the local redis whether
+  // it mapped the ring with at least minslots slots
+  static shared_ptr<ShmRing> offer(int slotnum, int rawlen);
+  static bool waitAccept(redisContext *ctx, string name);
+  // NULL if the client offers no ring, or the agent cannot use it
+  static shared_ptr<ShmRing> accept(redisContext *ctx, string name, int minslots);
+
+  // remove the name once the peer has attached
+  void unlink();
+  string getName();
+  int getSlotNum();
+  // the largest raw a slot holds
+  int getRawLen();
+
+  // producer: wait until the slot of pktid is free, fill the raw it returns and publish
+  char *acquire(int pktid);
+  void publish(int pktid);
+  // consumer: wait until pktid is published and return its raw, then release the slot
+  char *take(int pktid);
+  void release(int pktid);
+  // producer: tell the consumer that pktid is in Redis, once it is there
+  void redirect(int pktid);
+  // whether a taken raw was redirected to Redis
+  static bool isRedirect(char *raw);
+};
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef _SPSCQUEUE_HH_
+#define _SPSCQUEUE_HH_
+
+#include "QueueStats.hh"
+#include "TaskPool.hh"
+
+#include "../inc/include.hh"
+
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+// items in a segment of the ring
+#define SPSCQUEUE_SEGMENT 64
+// polls before a side parks on the condition variable, adapted between the two
+#define SPSCQUEUE_SPIN_MIN 16
+#define SPSCQUEUE_SPIN_MAX 1024
+// bytes between the fields of the two sides, a cache line
+#define SPSCQUEUE_PAD 64
+
+/**
+ * Queue between a stage and the next one, with exactly one producer thread
+ * and one consumer thread at a time. It has the same interface as
+ * BlockingQueue, which is still used where several threads push or pop.
+ *
+ * Items go into a chain of fixed-size segments without locks: the producer
+ * publishes the count of items pushed and the consumer the count of items
+ * popped, and each side only rereads the count of the other when its cached
+ * copy says it has to wait. A side that has to wait polls the count for a
+ * while and then parks, and the other side takes the lock only to wake it.
+ * The polls of a side grow while polling succeeds and shrink when it parks,
+ * so that a core is not burnt when the other side is slow or has no core.
+ * A drained segment is kept as a spare for the producer, so a queue in
+ * steady state allocates nothing.
+ *
+ * With a capacity, push waits while the queue is full, and 0 leaves the
+ * queue unbounded, as in BlockingQueue.
+ */
+template <class T>
+class SpscQueue {
+  private:
+    struct Segment {
+      T _items[SPSCQUEUE_SEGMENT];
+      Segment* _next;
+    };
+
+    // producer side, a whole cache line apart from the consumer side; the gaps are
+    // explicit since a new of an over-aligned type is not aligned before C++17
+    Segment* _tailSeg;
+    int _tailIdx;
+    long _poppedCache;
+    int _producerSpin;
+    atomic<long> _pushed;
+    char _pad0[SPSCQUEUE_PAD];
+
+    // consumer side
+    Segment* _headSeg;
+    int _headIdx;
+    long _pushedCache;
+    int _consumerSpin;
+    atomic<long> _popped;
+    char _pad1[SPSCQUEUE_PAD];
+
+    atomic<Segment*> _spare;
+    atomic<int> _capacity;
+    atomic<bool> _released;
+    atomic<int> _highWater;
+    string _stage;
+
+    mutex _parkLock;
+    condition_variable _parkCond;
+    atomic<bool> _producerParked;
+    atomic<bool> _consumerParked;
+
+    Segment* newSegment() {
+      Segment* seg = _spare.exchange(NULL);
+      if (!seg) seg = new Segment();
+      seg->_next = NULL;
+      return seg;
+    }
+
+    // by the producer
+    bool hasRoom(long pushed) {
+      int capacity = _capacity.load();
+      if (capacity <= 0 || _released.load() || pushed - _poppedCache < capacity) return true;
+      _poppedCache = _popped.load();
+      return pushed - _poppedCache < capacity;
+    }
+
+    // by the consumer
+    bool hasItem(long popped) {
+      if (_pushedCache != popped) return true;
+      _pushedCache = _pushed.load();
+      return _pushedCache != popped;
+    }
+
+    template <class Ready>
+    void wait(atomic<bool>& parked, int& spin, Ready ready) {
+      for (int i = 0; i < spin; i++) {
+        if (ready()) {
+          spin = min(spin * 2, SPSCQUEUE_SPIN_MAX);
+          return;
+        }
+      }
+      spin = max(spin / 2, SPSCQUEUE_SPIN_MIN);
+      // let another worker of the pool run while we sleep
+      TaskPool::beginBlocking();
+      unique_lock<mutex> lck(_parkLock);
+      // announce before the last check, so that the other side sees us after its update
+      parked.store(true);
+      while (!ready()) _parkCond.wait(lck);
+      parked.store(false);
+      lck.unlock();
+      TaskPool::endBlocking();
+    }
+
+    void wake(atomic<bool>& parked) {
+      if (parked.load()) {
+        lock_guard<mutex> lck(_parkLock);
+        _parkCond.notify_all();
+      }
+    }
+
+    void put(T item) {
+      if (_tailIdx == SPSCQUEUE_SEGMENT) {
+        Segment* seg = newSegment();
+        _tailSeg->_next = seg;
+        _tailSeg = seg;
+        _tailIdx = 0;
+      }
+      _tailSeg->_items[_tailIdx++] = item;
+    }
+
+    T get() {
+      if (_headIdx == SPSCQUEUE_SEGMENT) {
+        Segment* seg = _headSeg->_next;
+        delete _spare.exchange(_headSeg);
+        _headSeg = seg;
+        _headIdx = 0;
+      }
+      return _headSeg->_items[_headIdx++];
+    }
+
+    void published(long pushed) {
+      _pushed.store(pushed);
+      // the cached count only overestimates the length, so reread it for a new mark
+      if (pushed - _poppedCache > _highWater.load(memory_order_relaxed) && !_released.load(memory_order_relaxed)) {
+        _poppedCache = _popped.load();
+        int size = pushed - _poppedCache;
+        if (size > _highWater.load(memory_order_relaxed)) _highWater.store(size, memory_order_relaxed);
+      }
+      wake(_consumerParked);
+    }
+
+    void freed(long popped) {
+      _popped.store(popped);
+      // a producer parks on a full queue, and is woken once half of it drains so it refills it in one go
+      int capacity = _capacity.load(memory_order_relaxed);
+      if (capacity <= 0 || _pushedCache - popped <= capacity / 2) wake(_producerParked);
+    }
+
+  public:
+    SpscQueue(int capacity = 0, string stage = "") {
+      _tailSeg = _headSeg = new Segment();
+      _tailSeg->_next = NULL;
+      _tailIdx = _headIdx = 0;
+      _pushed = 0;
+      _popped = 0;
+      _poppedCache = 0;
+      _pushedCache = 0;
+      _producerSpin = SPSCQUEUE_SPIN_MAX;
+      _consumerSpin = SPSCQUEUE_SPIN_MAX;
+      _spare = NULL;
+      _capacity = capacity;
+      _released = false;
+      _highWater = 0;
+      _stage = stage;
+      _producerParked = false;
+      _consumerParked = false;
+    }
+
+    ~SpscQueue() {
+      if (!_stage.empty()) QueueStats::record(_stage, _highWater, _capacity);
+      while (_headSeg) {
+        Segment* seg = _headSeg->_next;
+        delete _headSeg;
+        _headSeg = seg;
+      }
+      delete _spare.load();
+    }
+
+    void push(T item) {
+      long pushed = _pushed.load(memory_order_relaxed);
+      if (!hasRoom(pushed)) wait(_producerParked, _producerSpin, [&] { return hasRoom(pushed); });
+      put(item);
+      published(pushed + 1);
+    }
+
+    // push num items, publishing as many as there is room for at a time
+    void pushBatch(T* items, int num) {
+      long pushed = _pushed.load(memory_order_relaxed);
+      int done = 0;
+      while (done < num) {
+        if (!hasRoom(pushed)) wait(_producerParked, _producerSpin, [&] { return hasRoom(pushed); });
+        while (done < num && hasRoom(pushed)) {
+          put(items[done++]);
+          pushed++;
+        }
+        published(pushed);
+      }
+    }
+
+    T pop() {
+      long popped = _popped.load(memory_order_relaxed);
+      if (!hasItem(popped)) wait(_consumerParked, _consumerSpin, [&] { return hasItem(popped); });
+      T item = get();
+      freed(popped + 1);
+      return item;
+    }
+
+    // wait for at least one item and pop up to maxnum of them, returns the number popped
+    int popBatch(T* items, int maxnum) {
+      long popped = _popped.load(memory_order_relaxed);
+      if (!hasItem(popped)) wait(_consumerParked, _consumerSpin, [&] { return hasItem(popped); });
+      int num = min((long)maxnum, _pushedCache - popped);
+      for (int i = 0; i < num; i++) items[i] = get();
+      freed(popped + num);
+      return num;
+    }
+
+    int getSize() {
+      return _pushed.load() - _popped.load();
+    }
+
+    // by the consumer
+    void clear() {
+      long popped = _popped.load(memory_order_relaxed);
+      long pushed = _pushedCache = _pushed.load();
+      while (popped < pushed) {
+        get();
+        popped++;
+      }
+      freed(popped);
+    }
+
+    // 0 for unbounded
+    void setCapacity(int capacity) {
+      _capacity.store(capacity);
+      wake(_producerParked);
+    }
+
+    // lift the bound for a producer that goes on past the items its consumer
+    // takes, those items are not counted in the high-water mark
+    void release() {
+      _released.store(true);
+      wake(_producerParked);
+    }
+
+    int getCapacity() {
+      return _capacity.load();
+    }
+
+    int getHighWater() {
+      return _highWater.load();
+    }
+};
+
+#endif
@@ -1,65 +1,126 @@
 #include "StripeStore.hh"
 
+// records keep the line the text stores had, with its newline
+string trimLine(string line) {
+  if (line.size() && line.back() == '\n') line.pop_back();
+  return line;
+}
+
 StripeStore::StripeStore(Config* conf) {
   _conf = conf;
   // by default, encode scheduling is delayed
   _enableScan = false;
   _enableRepair = false;
+  _lostSeq = 0;
+  _ssEntryNum = 0;
+  _agentLoads = new AgentLoad[_conf->_agentsIPs.size()];
+  for (int i = 0; i < _conf->_agentsIPs.size(); i++) {
+    _agentIdx.insert(make_pair(_conf->_agentsIPs[i], i));
+    _agentLoads[i]._data = 0;
+    _agentLoads[i]._control = 0;
+    _agentLoads[i]._repair = 0;
+    _agentLoads[i]._encode = 0;
+  }
 
 //   if (_conf->_repair_scheduling == "delay") _enableRepair = false;
 //   else if (_conf->_repair_scheduling == "threshold") _enableRepair = false;
 //   else _enableRepair = true;
 
-  // TODO: if metaStore exists, we need to load metadata into memory
-  //       if not, we need to create a metaStore 
-  // check whether entryStore exists, and read data from entryStore
+  // load the snapshot and the log of the metadata
+  _metaLog = new MetaLog(_conf, _metaLogPath, _metaSnapshotPath);
+
+  // move the text stores of an older coordinator into the log
   ifstream entryStore(_entryStorePath);
   if (entryStore.is_open()) {
-    cout << "StripeStore::read entryStore" << endl;
+    cout << "StripeStore::migrate entryStore" << endl;
     string line;
     while (getline(entryStore, line)) {
       SSEntry* ssentry = new SSEntry(line);
-      ssentry->dump();
-      // insert ssentry into stripestore
-      insertEntry(ssentry);
+      _metaLog->append(METALOG_ENTRY, ssentry->getFilename(), line);
+      delete ssentry;
     }
     entryStore.close();
+    rename(_entryStorePath.c_str(), (_entryStorePath + ".migrated").c_str());
   }
-  // check whether poolStore exists, and read data from poolStore
   ifstream poolStore(_poolStorePath);
   if (poolStore.is_open()) {
-    cout << "StripeStore::read poolStore" << endl;
+    cout << "StripeStore::migrate poolStore" << endl;
     string line;
     while (getline(poolStore, line)) {
-      vector<string> entryitems = RedisUtil::str2container(line);
-      string ecpoolid = entryitems[0];
-      string ecid = _conf->_offlineECMap[ecpoolid];
-      int basesizeMB = _conf->_offlineECBase[ecpoolid];
-      ECPolicy* ecpolicy = _conf->_ecPolicyMap[ecid];
-      OfflineECPool* ecpool = getECPool(ecpoolid, ecpolicy, basesizeMB);
-      ecpool->constructPool(entryitems);
+      // |ecpoolid|stripename|objs|
+      vector<string> items = RedisUtil::str2container(trimLine(line));
+      _metaLog->append(METALOG_STRIPE, items[0] + " " + items[1], line);
     }
     poolStore.close();
+    rename(_poolStorePath.c_str(), (_poolStorePath + ".migrated").c_str());
+  }
+
+  // rebuild the entries, then the stripes of the pools and the hdfs blocks
+  for (auto item: _metaLog->getState(METALOG_ENTRY)) {
+    SSEntry* ssentry = new SSEntry(trimLine(item.second));
+    insertEntry(ssentry);
+    markLogged(ssentry->getFilename());
+  }
+  for (auto item: _metaLog->getState(METALOG_STRIPE)) {
+    vector<string> entryitems = RedisUtil::str2container(trimLine(item.second));
+    string ecpoolid = entryitems[0];
+    string ecid = _conf->_offlineECMap[ecpoolid];
+    int basesizeMB = _conf->_offlineECBase[ecpoolid];
+    ECPolicy* ecpolicy = _conf->_ecPolicyMap[ecid];
+    OfflineECPool* ecpool = getECPool(ecpoolid, ecpolicy, basesizeMB);
+    ecpool->constructPool(entryitems);
+  }
+  for (auto item: _metaLog->getState(METALOG_HDFS)) _hdfsfile2block.insert(item);
+  for (auto item: _metaLog->getState(METALOG_PLACEMENT)) {
+    string stripename = item.first.substr(item.first.find(' ') + 1);
+    _stripePolicy[stripename] = _conf->_ecPolicyMap[item.second];
+  }
+  for (auto item: _metaLog->getState(METALOG_MIGRATION)) {
+    if (!item.second.empty()) _migrations.insert(item);
   }
+  // the store holds the metadata from now on, the log takes its snapshots from it
+  _metaLog->setSource([=](const MetaLogEmit& emit) { snapshotMeta(emit); });
+  int objnum = 0;
+  long namebytes = 0;
+  for (int i = 0; i < STRIPESTORE_SHARDS; i++) {
+    objnum += _objShards[i]._names.size();
+    namebytes += _fileShards[i]._names.memory() + _objShards[i]._names.memory();
+  }
+  cout << "StripeStore::rebuilt " << _ssEntryNum << " entries of " << objnum << " objs, names take "
+       << namebytes / 1048576 << " MiB" << endl;
+}
+
+int StripeStore::shardOf(string name) {
+  return hash<string>()(name) % STRIPESTORE_SHARDS;
 }
 
 bool StripeStore::existEntry(string filename) {
-  unordered_map<string, SSEntry*>::iterator it = _ssEntryMap.find(filename);
-  return it == _ssEntryMap.end() ? false:true;
+  return getEntry(filename) != NULL;
 }
 
 void StripeStore::insertEntry(SSEntry* entry) {
-  unordered_map<string, SSEntry*>::iterator it = _ssEntryMap.find(entry->getFilename());
-  if (it == _ssEntryMap.end()) {
-    // the entry does not exist, insert this entry
-    _lockSSEntryMap.lock();
-    _ssEntryMap.insert(make_pair(entry->getFilename(), entry));
-    _lockSSEntryMap.unlock();
-
+  // coordinator workers may register the same file at once, only the first inserts
+  EntryShard& shard = _fileShards[shardOf(entry->getFilename())];
+  shard._lock.lock();
+  uint32_t id = shard._names.intern(entry->getFilename());
+  if (id == shard._entries.size()) {
+    shard._entries.push_back(NULL);
+    shard._logged.push_back(false);
+  }
+  bool inserted = shard._entries[id] == NULL;
+  if (inserted) {
+    shard._entries[id] = entry;
+    _ssEntryNum++;
+  }
+  shard._lock.unlock();
+  if (inserted) {
     for (auto obj: entry->getObjlist()) {
-      _lockObjEntryMap.lock();
-      _objEntryMap.insert(make_pair(obj, entry));
-      _lockObjEntryMap.unlock();
+      EntryShard& objshard = _objShards[shardOf(obj)];
+      objshard._lock.lock();
+      uint32_t objid = objshard._names.intern(obj);
+      if (objid == objshard._entries.size()) objshard._entries.push_back(entry);
+      else if (objshard._entries[objid] == NULL) objshard._entries[objid] = entry;
+      objshard._lock.unlock();
     }
   } else {
 //     // the entry exist, only need to update the entry
@@ -78,26 +139,68 @@ void StripeStore::insertEntry(SSEntry* entry) {
 }
 
 SSEntry* StripeStore::getEntry(string filename) {
-  if (existEntry(filename)) return _ssEntryMap[filename];
-  else return NULL;
+  SSEntry* toret = NULL;
+  EntryShard& shard = _fileShards[shardOf(filename)];
+  shard._lock.lock_shared();
+  uint32_t id = shard._names.find(filename);
+  if (id != NAMETABLE_NONE) toret = shard._entries[id];
+  shard._lock.unlock_shared();
+  return toret;
 }
 
 SSEntry* StripeStore::getEntryFromObj(string objname) {
-  if (_objEntryMap.find(objname) != _objEntryMap.end()) return _objEntryMap[objname];
-  else return NULL;
+  SSEntry* toret = NULL;
+  EntryShard& shard = _objShards[shardOf(objname)];
+  shard._lock.lock_shared();
+  uint32_t id = shard._names.find(objname);
+  if (id != NAMETABLE_NONE) toret = shard._entries[id];
+  shard._lock.unlock_shared();
+  return toret;
+}
+
+void StripeStore::lockStripe(string stripename) {
+  _lockStripes[hash<string>()(stripename) % STRIPESTORE_STRIPELOCKS].lock();
+}
+
+void StripeStore::unlockStripe(string stripename) {
+  _lockStripes[hash<string>()(stripename) % STRIPESTORE_STRIPELOCKS].unlock();
+}
+
+vector<int> stripeLockIds(vector<string> stripenames) {
+  vector<int> lockids;
+  for (auto stripename: stripenames) lockids.push_back(hash<string>()(stripename) % STRIPESTORE_STRIPELOCKS);
+  sort(lockids.begin(), lockids.end());
+  lockids.erase(unique(lockids.begin(), lockids.end()), lockids.end());
+  return lockids;
+}
+
+void StripeStore::lockStripes(vector<string> stripenames) {
+  for (auto lockid: stripeLockIds(stripenames)) _lockStripes[lockid].lock();
+}
+
+void StripeStore::unlockStripes(vector<string> stripenames) {
+  for (auto lockid: stripeLockIds(stripenames)) _lockStripes[lockid].unlock();
 }
 
 void StripeStore::insertECPool(string ecpoolid, OfflineECPool* pool) {
-  assert (_offlineECPoolMap.find(ecpoolid) == _offlineECPoolMap.end());
   _lockECPoolMap.lock();
+  assert (_offlineECPoolMap.find(ecpoolid) == _offlineECPoolMap.end());
   _offlineECPoolMap.insert(make_pair(ecpoolid, pool));
   _lockECPoolMap.unlock();
 }
 
 OfflineECPool* StripeStore::getECPool(string ecpoolid, ECPolicy* ecpolicy, int basesize) {
-  OfflineECPool* toret;
+  OfflineECPool* toret = NULL;
+  _lockECPoolMap.lock_shared();
+  unordered_map<string, OfflineECPool*>::iterator it = _offlineECPoolMap.find(ecpoolid);
+  if (it != _offlineECPoolMap.end()) toret = it->second;
+  _lockECPoolMap.unlock_shared();
+  if (toret != NULL) return toret;
+
+  // look again alone, another worker may have created it meanwhile
   _lockECPoolMap.lock();
-  if (_offlineECPoolMap.find(ecpoolid) != _offlineECPoolMap.end()) toret = _offlineECPoolMap[ecpoolid];
+  it = _offlineECPoolMap.find(ecpoolid);
+  if (it != _offlineECPoolMap.end()) toret = it->second;
   else {
     toret = new OfflineECPool(ecpoolid, ecpolicy, basesize);
     _offlineECPoolMap.insert(make_pair(ecpoolid, toret));
@@ -109,93 +212,96 @@ OfflineECPool* StripeStore::getECPool(string ecpoolid, ECPolicy* ecpolicy, int b
 OfflineECPool* StripeStore::getECPool(string poolname) {
   // TODO: the poolname must exist!
   OfflineECPool* toret;
-  _lockECPoolMap.lock();
+  _lockECPoolMap.lock_shared();
   unordered_map<string, OfflineECPool*>::iterator it = _offlineECPoolMap.find(poolname);
   assert (it != _offlineECPoolMap.end());
-  _lockECPoolMap.unlock();
-  return _offlineECPoolMap[poolname];
+  toret = it->second;
+  _lockECPoolMap.unlock_shared();
+  return toret;
 }
 
-int StripeStore::getControlLoad(unsigned int ip) {
-  int toret;
-  _lockCLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _controlLoadMap.find(ip);
-  if (it == _controlLoadMap.end()) toret = 0;
-  else toret = _controlLoadMap[ip];
-  _lockCLMap.unlock();
+AgentLoad* StripeStore::getAgentLoad(unsigned int ip, bool create) {
+  unordered_map<unsigned int, int>::iterator it = _agentIdx.find(ip);
+  if (it != _agentIdx.end()) return &_agentLoads[it->second];
+
+  // an ip that is not configured as an agent, e.g., a client
+  AgentLoad* toret = NULL;
+  _lockExtraLoads.lock_shared();
+  unordered_map<unsigned int, AgentLoad*>::iterator extra = _extraLoads.find(ip);
+  if (extra != _extraLoads.end()) toret = extra->second;
+  _lockExtraLoads.unlock_shared();
+  if (toret != NULL || !create) return toret;
+
+  _lockExtraLoads.lock();
+  extra = _extraLoads.find(ip);
+  if (extra != _extraLoads.end()) {
+    toret = extra->second;
+  } else {
+    toret = new AgentLoad();
+    toret->_data = 0;
+    toret->_control = 0;
+    toret->_repair = 0;
+    toret->_encode = 0;
+    _extraLoads.insert(make_pair(ip, toret));
+    cout << "StripeStore::getAgentLoad " << RedisUtil::ip2Str(ip) << " is not an agent, its load is kept apart" << endl;
+  }
+  _lockExtraLoads.unlock();
   return toret;
 }
 
+int StripeStore::getControlLoad(unsigned int ip) {
+  AgentLoad* load = getAgentLoad(ip, false);
+  return load == NULL ? 0 : load->_control.load(memory_order_relaxed);
+}
+
 void StripeStore::increaseControlLoadMap(unsigned int ip, int load) {
-  _lockCLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _controlLoadMap.find(ip);
-  if (it == _controlLoadMap.end()) _controlLoadMap.insert(make_pair(ip, load));
-  else _controlLoadMap[ip] += load;
-  _lockCLMap.unlock();
+  AgentLoad* agentload = getAgentLoad(ip, true);
+  if (agentload != NULL) agentload->_control.fetch_add(load, memory_order_relaxed);
 }
 
 int StripeStore::getDataLoad(unsigned int ip) {
-  int toret;
-  _lockDLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _dataLoadMap.find(ip);
-  if (it == _dataLoadMap.end()) toret = 0;
-  else toret = _dataLoadMap[ip];
-  _lockDLMap.unlock();
-  return toret;
+  AgentLoad* load = getAgentLoad(ip, false);
+  return load == NULL ? 0 : load->_data.load(memory_order_relaxed);
 }
 
 void StripeStore::increaseDataLoadMap(unsigned int ip, int load) {
-  _lockDLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _dataLoadMap.find(ip);
-  if (it == _dataLoadMap.end()) _dataLoadMap.insert(make_pair(ip, load));
-  else _dataLoadMap[ip] += load;
-  _lockDLMap.unlock();
+  AgentLoad* agentload = getAgentLoad(ip, true);
+  if (agentload != NULL) agentload->_data.fetch_add(load, memory_order_relaxed);
 }
 
 int StripeStore::getRepairLoad(unsigned int ip) {
-  int toret;
-  _lockRLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _repairLoadMap.find(ip);
-  if (it == _repairLoadMap.end()) toret = 0;
-  else toret = _repairLoadMap[ip];
-  _lockRLMap.unlock();
-  return toret;
+  AgentLoad* load = getAgentLoad(ip, false);
+  return load == NULL ? 0 : load->_repair.load(memory_order_relaxed);
 }
 
 void StripeStore::increaseRepairLoadMap(unsigned int ip, int load) {
-  _lockRLMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _repairLoadMap.find(ip);
-  if (it == _repairLoadMap.end()) _repairLoadMap.insert(make_pair(ip, load));
-  else _repairLoadMap[ip] += load;
-  _lockRLMap.unlock();
+  AgentLoad* agentload = getAgentLoad(ip, true);
+  if (agentload != NULL) agentload->_repair.fetch_add(load, memory_order_relaxed);
 }
 
-
 int StripeStore::getEncodeLoad(unsigned int ip) {
-  int toret;
-  _lockELMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _encodeLoadMap.find(ip);
-  if (it == _encodeLoadMap.end()) toret = 0;
-  else toret = _encodeLoadMap[ip];
-  _lockELMap.unlock();
-  return toret;
+  AgentLoad* load = getAgentLoad(ip, false);
+  return load == NULL ? 0 : load->_encode.load(memory_order_relaxed);
 }
 
 void StripeStore::increaseEncodeLoadMap(unsigned int ip, int load) {
-  _lockELMap.lock();
-  unordered_map<unsigned int, int>::iterator it = _encodeLoadMap.find(ip);
-  if (it == _encodeLoadMap.end()) _encodeLoadMap.insert(make_pair(ip, load));
-  else _encodeLoadMap[ip] += load;
-  _lockELMap.unlock();
+  AgentLoad* agentload = getAgentLoad(ip, true);
+  if (agentload != NULL) agentload->_encode.fetch_add(load, memory_order_relaxed);
 }
 
 void StripeStore::setECStatus(int op, string ectype) {
   if (ectype == "encode") {
+    _lockPECQueue.lock();
     if (op == 1) _enableScan = true;
     else _enableScan = false;
+    _lockPECQueue.unlock();
+    _scanCond.notify_all();
   } else if (ectype == "repair") {
+    _lockLostMap.lock();
     if (op == 1) _enableRepair = true;
     else _enableRepair = false;
+    _lockLostMap.unlock();
+    _repairCond.notify_all();
   }
 }
 
@@ -203,11 +309,12 @@ void StripeStore::setECStatus(int op, string ectype) {
 void StripeStore::scanning() {
   int concurrentNum = _conf->_ec_concurrent;
   while(true) {
-    std::this_thread::sleep_for (std::chrono::seconds(1));
-    if (!_enableScan) continue;
+    unique_lock<mutex> lck(_lockPECQueue);
+    // wait for a candidate, a finished stripe or encoding to be enabled
+    _scanCond.wait(lck, [&] {
+      return _enableScan && _pendingECQueue.getSize() && getECInProgressNum() < concurrentNum;
+    });
     // offline encoding is enabled
-    cout << "StripeStore::scanning the pendingECQueue" << endl;
-    _lockPECQueue.lock();
     int ecInProgressNum = getECInProgressNum();
     cout << "StripeStore::pendingECQueue.size = " << _pendingECQueue.getSize() << ", ecInProgress = "  << ecInProgressNum << ", concurrentNum = " << concurrentNum << endl;
     while (_pendingECQueue.getSize() && ecInProgressNum < concurrentNum) {
@@ -225,7 +332,6 @@ void StripeStore::scanning() {
       // obtain latest ecInProgress
       ecInProgressNum = getECInProgressNum();
     } 
-    _lockPECQueue.unlock();
   }
 }
 
@@ -233,6 +339,7 @@ void StripeStore::addEncodeCandidate(string ecpoolid, string stripename) {
   _lockPECQueue.lock();
   _pendingECQueue.push(make_pair(ecpoolid, stripename));
   _lockPECQueue.unlock();
+  _scanCond.notify_all();
 }
 
 int StripeStore::getECInProgressNum() {
@@ -246,22 +353,25 @@ int StripeStore::getECInProgressNum() {
 void StripeStore::startECStripe(string stripename) {
   _lockECInProgress.lock();
   if (_ECInProgress.size() == 0) gettimeofday(&_startEnc, NULL);
-  _ECInProgress.push_back(stripename);
+  _ECInProgress.insert(stripename);
   _lockECInProgress.unlock();
 }
 
 void StripeStore::finishECStripe(OfflineECPool* pool, string stripename) {
   _lockECInProgress.lock();
-  vector<string>::iterator pos = find(_ECInProgress.begin(), _ECInProgress.end(), stripename);
-  if (pos != _ECInProgress.end()) _ECInProgress.erase(pos);
+  _ECInProgress.erase(stripename);
   if (_ECInProgress.size() == 0) {
     gettimeofday(&_endEnc, NULL);
     cout << "StripeStore::finishECStripe.encodeTime = " << RedisUtil::duration(_startEnc, _endEnc) << endl;
   }
   _lockECInProgress.unlock();
+  // pass through the lock scanning checks with, so that the wakeup is not lost
+  _lockPECQueue.lock();
+  _lockPECQueue.unlock();
+  _scanCond.notify_all();
 
   // we need to backup offlineecpool
-  backupPoolStripe(pool->stripe2String(stripename));
+  backupPoolStripe(pool, stripename);
 }
 
 int StripeStore::getRPInProgressNum() {
@@ -271,118 +381,329 @@ int StripeStore::getRPInProgressNum() {
   return toret;
 }
 
+RepairPriority StripeStore::repairPriorityLocked(string objname) {
+  LostObjInfo& info = _lostInfo[objname];
+  int available = _maintenanceWindows.find(info._rack) == _maintenanceWindows.end() ? 1 : 0;
+  return make_tuple(available, (int)_stripeLost[info._stripename].size(), _lostMap[objname], -info._seq);
+}
+
+void StripeStore::queueLostObjLocked(string objname) {
+  // under threshold scheduling, an object waits for enough requests
+  if (_conf->_repair_scheduling == "threshold" && _lostMap[objname] < _conf->_repair_threshold) return;
+  _repairQueue.push(objname, repairPriorityLocked(objname));
+}
+
+void StripeStore::requeueStripeLocked(string stripename) {
+  for (auto objname: _stripeLost[stripename]) {
+    if (_repairQueue.contains(objname)) _repairQueue.push(objname, repairPriorityLocked(objname));
+  }
+}
+
+void StripeStore::requeueAllLocked() {
+  for (auto item: _lostMap) {
+    if (_repairQueue.contains(item.first)) _repairQueue.push(item.first, repairPriorityLocked(item.first));
+  }
+}
+
+void StripeStore::forgetLostObjLocked(string objname) {
+  unordered_map<string, LostObjInfo>::iterator it = _lostInfo.find(objname);
+  if (it == _lostInfo.end()) return;
+  string stripename = it->second._stripename;
+  _lostInfo.erase(it);
+  _stripeLost[stripename].erase(objname);
+  if (_stripeLost[stripename].empty()) _stripeLost.erase(stripename);
+  else requeueStripeLocked(stripename);
+}
 
 void StripeStore::addLostObj(string objname) {
+  // find the stripe and rack of objname before taking the lock
+  string stripename = objname;
+  string rack;
+  SSEntry* ssentry = getEntryFromObj(objname);
+  if (ssentry != NULL) {
+    if (ssentry->getType() == 0) {
+      stripename = ssentry->getFilename();
+    } else {
+      OfflineECPool* ecpool = getECPool(ssentry->getEcidpool());
+      ecpool->lockShared();
+      stripename = ecpool->getStripeForObj(objname);
+      ecpool->unlockShared();
+    }
+    // find, as the config is shared by the workers of the coordinator
+    unordered_map<unsigned int, string>::iterator rit = _conf->_ip2Rack.find(ssentry->getLocOfObj(objname));
+    if (rit != _conf->_ip2Rack.end()) rack = rit->second;
+  }
+
+  _lockLostMap.lock();
   // check whether objname is in _RPInProgress
-  bool inrepair = false;
   _lockRPInProgress.lock();
-  if (find(_RPInProgress.begin(), _RPInProgress.end(), objname) != _RPInProgress.end()) {
-    inrepair = true;
-  }
+  bool inrepair = _RPInProgress.find(objname) != _RPInProgress.end();
   _lockRPInProgress.unlock();
-  if (inrepair) return;
+  if (inrepair) {
+    _lockLostMap.unlock();
+    return;
+  }
+  _lostMap[objname]++;
+  if (_lostInfo.find(objname) == _lostInfo.end()) {
+    LostObjInfo info;
+    info._stripename = stripename;
+    info._rack = rack;
+    info._seq = _lostSeq++;
+    _lostInfo.insert(make_pair(objname, info));
+    _stripeLost[stripename].insert(objname);
+    // the other objects of the stripe are now more at risk
+    requeueStripeLocked(stripename);
+  }
+  queueLostObjLocked(objname);
+  _lockLostMap.unlock();
+  _repairCond.notify_all();
+}
+
+vector<string> StripeStore::getObjsOfPool(string ecpoolid) {
+  vector<string> toret;
+  for (int i = 0; i < STRIPESTORE_SHARDS; i++) {
+    EntryShard& shard = _objShards[i];
+    shard._lock.lock_shared();
+    for (uint32_t id = 0; id < shard._entries.size(); id++) {
+      if (shard._entries[id]->getEcidpool() == ecpoolid) toret.push_back(shard._names.name(id));
+    }
+    shard._lock.unlock_shared();
+  }
+  return toret;
+}
+
+vector<string> StripeStore::getObjsOnIps(vector<unsigned int> ips) {
+  vector<string> toret;
+  for (int i = 0; i < STRIPESTORE_SHARDS; i++) {
+    EntryShard& shard = _objShards[i];
+    shard._lock.lock_shared();
+    for (uint32_t id = 0; id < shard._entries.size(); id++) {
+      string objname = shard._names.name(id);
+      unsigned int loc = shard._entries[id]->getLocOfObj(objname);
+      if (find(ips.begin(), ips.end(), loc) != ips.end()) toret.push_back(objname);
+    }
+    shard._lock.unlock_shared();
+  }
+  return toret;
+}
+
+bool StripeStore::claimLostObj(string objname) {
+  // under _lockLostMap, as scanRepair dispatches, so each object is repaired once
   _lockLostMap.lock();
-  if (_lostMap.find(objname) == _lostMap.end()) {
-    _lostMap.insert(make_pair(objname, 1));
-  } else {
-    _lostMap[objname]++;
+  _lockRPInProgress.lock();
+  bool claimed = _RPInProgress.insert(objname).second;
+  _lockRPInProgress.unlock();
+  if (claimed) {
+    _lostMap.erase(objname);
+    _repairQueue.erase(objname);
   }
   _lockLostMap.unlock();
+  return claimed;
 }
 
-void StripeStore::scanRepair() {
-  int concurrentNum = _conf->_ec_concurrent;
-  while (true) {
-     std::this_thread::sleep_for(std::chrono::seconds(1));
-     if (!_enableRepair) continue;
-     cout << "StripeStore::scanning repair queue" << endl;
-     int rpInProgressNum = getRPInProgressNum();
-     cout << "StripeStore::scanRepair.rpInProgressNum = " << rpInProgressNum << endl;
-     while (_lostMap.size() && (rpInProgressNum < concurrentNum)) {
-       string objname;
- 
-       // search the lost map and find the one with the most request num
-       int maxreq=0;
-       _lockLostMap.lock();
-       for (auto item: _lostMap) {
-         if (item.second > maxreq) {
-           maxreq = item.second;
-           objname = item.first;
-         }
-       }
-       _lockLostMap.unlock();
- 
-       // now we have the obj with the most request num
-       if (_conf->_repair_scheduling == "threshold") {
-         if (!_enableRepair) continue;
-         if (maxreq < _conf->_repair_threshold) continue;
-       }
-
-      if ((_conf->_repair_scheduling == "delay" ) && 
-          !_enableRepair) continue;
-
-//      if (_conf->_repair_scheduling == "normal") continue;
-    
-      // send repair request to coordinator  
-      CoorCommand* coorCmd = new CoorCommand();
-      coorCmd->buildType8(8, _conf->_localIp, objname);
-      coorCmd->sendTo(_conf->_coorIp);
+void StripeStore::setRackMaintenance(string rack, int seconds) {
+  _lockLostMap.lock();
+  if (seconds > 0) _maintenanceWindows[rack] = chrono::steady_clock::now() + chrono::seconds(seconds);
+  else _maintenanceWindows.erase(rack);
+  requeueAllLocked();
+  _lockLostMap.unlock();
+  // scanRepair waits until the earliest window closes
+  _repairCond.notify_all();
+}
 
-      delete coorCmd;
+bool StripeStore::isRackInMaintenance(string rack) {
+  _lockLostMap.lock();
+  expireMaintenanceLocked();
+  bool toret = _maintenanceWindows.find(rack) != _maintenanceWindows.end();
+  _lockLostMap.unlock();
+  return toret;
+}
 
-      // now we move the obj to RPInProgress
-      startRepair(objname);
-      _lockLostMap.lock();
-      _lostMap.erase(_lostMap.find(objname));
-      _lockLostMap.unlock();
+void StripeStore::expireMaintenanceLocked() {
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  bool expired = false;
+  for (auto it = _maintenanceWindows.begin(); it != _maintenanceWindows.end();) {
+    if (it->second <= now) {
+      cout << "StripeStore::maintenance of " << it->first << " is over" << endl;
+      it = _maintenanceWindows.erase(it);
+      expired = true;
+    } else {
+      it++;
+    }
+  }
+  if (expired) requeueAllLocked();
+}
 
-      rpInProgressNum = getRPInProgressNum();
+void StripeStore::scanRepair() {
+  int concurrentNum = _conf->_ec_concurrent;
+  while (true) {
+    unique_lock<mutex> lck(_lockLostMap);
+    // wait for a lost object that may go, a free repair slot and repair to be enabled,
+    // and wake up when a maintenance window closes, as the order of the queue changes
+    expireMaintenanceLocked();
+    while (!(_enableRepair && !_repairQueue.empty() && getRPInProgressNum() < concurrentNum)) {
+      if (_maintenanceWindows.empty()) {
+        _repairCond.wait(lck);
+      } else {
+        chrono::steady_clock::time_point earliest = _maintenanceWindows.begin()->second;
+        for (auto item: _maintenanceWindows) earliest = min(earliest, item.second);
+        _repairCond.wait_until(lck, earliest);
+      }
+      expireMaintenanceLocked();
     }
+    RepairPriority priority = _repairQueue.topPriority();
+    string objname = _repairQueue.pop();
+    _lostMap.erase(objname);
+    // now we move the obj to RPInProgress
+    startRepair(objname);
+    int rpInProgressNum = getRPInProgressNum();
+    lck.unlock();
+    cout << "StripeStore::scanRepair.dispatch " << objname << ", lost in stripe = " << get<1>(priority)
+         << ", requests = " << get<2>(priority) << ", rpInProgressNum = " << rpInProgressNum << endl;
+
+    // send repair request to coordinator
+    CoorCommand* coorCmd = new CoorCommand();
+    coorCmd->buildType8(8, _conf->_localIp, objname);
+    coorCmd->sendTo(_conf->_coorIp);
+    delete coorCmd;
   }
 }
 
 void StripeStore::startRepair(string objname) {
   _lockRPInProgress.lock();
-  _RPInProgress.push_back(objname);
+  _RPInProgress.insert(objname);
   _lockRPInProgress.unlock();
 }
 
 void StripeStore::finishRepair(string objname) {
   _lockRPInProgress.lock();
-  vector<string>::iterator pos = find(_RPInProgress.begin(), _RPInProgress.end(), objname);
-  if (pos != _RPInProgress.end()) _RPInProgress.erase(pos);
+  _RPInProgress.erase(objname);
   _lockRPInProgress.unlock();
+  _lockLostMap.lock();
+  // objname may be lost again since it left _RPInProgress
+  if (_lostMap.find(objname) == _lostMap.end()) forgetLostObjLocked(objname);
+  _lockLostMap.unlock();
+  // a repair slot is free
+  _repairCond.notify_all();
+}
+
+void StripeStore::markLogged(string filename) {
+  EntryShard& shard = _fileShards[shardOf(filename)];
+  shard._lock.lock();
+  uint32_t id = shard._names.find(filename);
+  if (id != NAMETABLE_NONE) shard._logged[id] = true;
+  shard._lock.unlock();
 }
 
-void StripeStore::backupEntry(string entrystr) {
-  struct timeval time1, time2;
-  gettimeofday(&time1, NULL);
-  _lockEntryStore.lock();
-  _entryStore.open(_entryStorePath, ios::out | ios::app);
-  _entryStore << entrystr;
-  _entryStore.close();
-  _lockEntryStore.unlock();
-  gettimeofday(&time2, NULL);
-//  cout << "StripeStore::backupEntry.duration = " << RedisUtil::duration(time1, time2) << endl;
+void StripeStore::backupEntry(SSEntry* entry) {
+  // marked before the record is appended, so that a snapshot after the record has the entry
+  markLogged(entry->getFilename());
+  _metaLog->append(METALOG_ENTRY, entry->getFilename(), entry->toString());
 }
 
-void StripeStore::backupPoolStripe(string poolstr) {
-  struct timeval time1, time2;
-  gettimeofday(&time1, NULL);
-  _lockPoolStore.lock();
-  _poolStore.open(_poolStorePath, ios::out | ios::app);
-  _poolStore << poolstr;
-  _poolStore.close();
-  _lockPoolStore.unlock();
-  gettimeofday(&time2, NULL);
-//  cout << "StripeStore::backupPool.duration = " << RedisUtil::duration(time1, time2) << endl;
+void StripeStore::backupPoolStripe(OfflineECPool* pool, string stripename) {
+  pool->lock();
+  pool->setLogged(stripename);
+  string poolstr = pool->stripe2String(stripename);
+  pool->unlock();
+  // |ecpoolid|stripename|objs|
+  vector<string> items = RedisUtil::str2container(trimLine(poolstr));
+  _metaLog->append(METALOG_STRIPE, items[0] + " " + items[1], poolstr);
+}
+
+void StripeStore::snapshotMeta(const MetaLogEmit& emit) {
+  // entries go in two passes, first those that their first obj maps to, so that a restart
+  // maps every obj to the entry it maps to now, whatever order they were logged in
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < STRIPESTORE_SHARDS; i++) {
+      EntryShard& shard = _fileShards[i];
+      shard._lock.lock_shared();
+      for (uint32_t id = 0; id < shard._entries.size(); id++) {
+        SSEntry* entry = shard._entries[id];
+        if (!shard._logged[id]) continue;
+        vector<string> objlist = entry->getObjlist();
+        bool owner = objlist.empty() || getEntryFromObj(objlist[0]) == entry;
+        if (owner == (pass == 0)) emit(METALOG_ENTRY, entry->getFilename(), entry->toString());
+      }
+      shard._lock.unlock_shared();
+    }
+  }
+
+  // the stripes of each pool in the order they were created, each with the placement it migrated to
+  vector<pair<string, OfflineECPool*>> pools;
+  _lockECPoolMap.lock_shared();
+  for (auto item: _offlineECPoolMap) pools.push_back(item);
+  _lockECPoolMap.unlock_shared();
+  for (auto item: pools) {
+    OfflineECPool* pool = item.second;
+    pool->lockShared();
+    vector<string> stripenames = pool->getLoggedStripes();
+    for (auto stripename: stripenames) {
+      string poolstr = pool->stripe2String(stripename);
+      emit(METALOG_STRIPE, item.first + " " + stripename, poolstr);
+    }
+    pool->unlockShared();
+    _lockStripePolicy.lock_shared();
+    for (auto stripename: stripenames) {
+      unordered_map<string, ECPolicy*>::iterator it = _stripePolicy.find(stripename);
+      if (it != _stripePolicy.end()) emit(METALOG_PLACEMENT, item.first + " " + stripename, it->second->getPolicyId());
+    }
+    _lockStripePolicy.unlock_shared();
+  }
+
+  _lockHDFS.lock_shared();
+  for (auto item: _hdfsfile2block) emit(METALOG_HDFS, item.first, item.second);
+  _lockHDFS.unlock_shared();
+  _lockMigrations.lock();
+  for (auto item: _migrations) emit(METALOG_MIGRATION, item.first, item.second);
+  _lockMigrations.unlock();
 }
 
 void StripeStore::setHDFSMeta(string hdfsfile, string block) {
+  _lockHDFS.lock();
   _hdfsfile2block.insert(make_pair(hdfsfile, block));
+  _lockHDFS.unlock();
+  _metaLog->append(METALOG_HDFS, hdfsfile, block);
+}
+
+ECPolicy* StripeStore::getStripePolicy(string stripename, ECPolicy* poolpolicy) {
+  ECPolicy* toret = poolpolicy;
+  _lockStripePolicy.lock_shared();
+  unordered_map<string, ECPolicy*>::iterator it = _stripePolicy.find(stripename);
+  if (it != _stripePolicy.end()) toret = it->second;
+  _lockStripePolicy.unlock_shared();
+  return toret;
+}
+
+void StripeStore::setStripePolicy(string ecpoolid, string stripename, string ecid) {
+  // set before it is logged, as snapshots read the store, and used only once the stripe is
+  // unlocked; a stripe whose record is lost is migrated again
+  _lockStripePolicy.lock();
+  _stripePolicy[stripename] = _conf->_ecPolicyMap[ecid];
+  _lockStripePolicy.unlock();
+  _metaLog->append(METALOG_PLACEMENT, ecpoolid + " " + stripename, ecid);
+}
+
+void StripeStore::setMigration(string ecpoolid, string ecid) {
+  _lockMigrations.lock();
+  if (ecid.empty()) _migrations.erase(ecpoolid);
+  else _migrations[ecpoolid] = ecid;
+  _lockMigrations.unlock();
+  _metaLog->append(METALOG_MIGRATION, ecpoolid, ecid);
+}
+
+unordered_map<string, string> StripeStore::getMigrations() {
+  _lockMigrations.lock();
+  unordered_map<string, string> toret = _migrations;
+  _lockMigrations.unlock();
+  return toret;
 }
 
 string StripeStore::getHDFSBlkName(string hdfsfile) {
-  assert (_hdfsfile2block.find(hdfsfile) != _hdfsfile2block.end());
-  return _hdfsfile2block[hdfsfile];
+  _lockHDFS.lock_shared();
+  unordered_map<string, string>::iterator it = _hdfsfile2block.find(hdfsfile);
+  assert (it != _hdfsfile2block.end());
+  string toret = it->second;
+  _lockHDFS.unlock_shared();
+  return toret;
 }
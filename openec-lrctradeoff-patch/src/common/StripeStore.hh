@@ -3,6 +3,9 @@
 
 #include "BlockingQueue.hh"
 #include "Config.hh"
+#include "IndexedHeap.hh"
+#include "MetaLog.hh"
+#include "NameTable.hh"
 #include "SSEntry.hh"
 //#include "ECPolicy.hh"
 //#include "OfflineECPool.hh"
@@ -11,61 +14,140 @@
 #include "../ec/OfflineECPool.hh"
 #include "../protocol/CoorCommand.hh"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_set>
+
 using namespace std;
 
+// stripes hash onto this many locks
+#define STRIPESTORE_STRIPELOCKS 1024
+// file names and objnames hash onto this many shards of their indexes
+#define STRIPESTORE_SHARDS 64
+
+// order of lost objects in the repair queue, the largest is dispatched first:
+// | rack not under maintenance | objs lost in the stripe | requests | -arrival |
+typedef tuple<int, int, int, long> RepairPriority;
+
+// where a lost object is, to prioritize it
+struct LostObjInfo {
+  string _stripename;
+  string _rack;
+  long _seq;
+};
+
+// a shard of a name index, lookups share its lock and inserts hold it alone
+struct EntryShard {
+  NameTable _names;
+  vector<SSEntry*> _entries;
+  // whether the entry is in the metadata log, in the shards of file names
+  vector<bool> _logged;
+  shared_timed_mutex _lock;
+};
+
+// load of an agent, updated without locks
+struct AgentLoad {
+  atomic<int> _data;
+  atomic<int> _control;
+  atomic<int> _repair;
+  atomic<int> _encode;
+};
+
 class StripeStore {
   private:
     Config* _conf;
 
-    // map original file name to SSEntry
+    // map original file name to SSEntry, by the id of the interned file name
     // for online-encoded file, we can get objname for each split
     // for offline encoded file, we can get splited blocks
-    unordered_map<string, SSEntry*> _ssEntryMap;  
-    mutex _lockSSEntryMap;
-    // map objname to original file name
+    EntryShard _fileShards[STRIPESTORE_SHARDS];
+    atomic<int> _ssEntryNum;
+    // map objname to the SSEntry of original file, by the id of the interned objname
     // for online encoded file, given a split name, we can get the original filename
     // for offline encoded file, given a block name, we can get the original filename
-    unordered_map<string, SSEntry*> _objEntryMap;
-    mutex _lockObjEntryMap;
-    
-    unordered_map<unsigned int, int> _dataLoadMap;
-    mutex _lockDLMap;
-    unordered_map<unsigned int, int> _controlLoadMap;
-    mutex _lockCLMap;
-    unordered_map<unsigned int, int> _repairLoadMap;
-    mutex _lockRLMap;
-    unordered_map<unsigned int, int> _encodeLoadMap;
-    mutex _lockELMap;
+    EntryShard _objShards[STRIPESTORE_SHARDS];
+
+    // loads by the index of the agent in _conf->_agentsIPs, the index is fixed at startup
+    unordered_map<unsigned int, int> _agentIdx;
+    AgentLoad* _agentLoads;
+    // loads of ips that are not in _conf->_agentsIPs, added when first loaded and never removed
+    unordered_map<unsigned int, AgentLoad*> _extraLoads;
+    shared_timed_mutex _lockExtraLoads;
 
+    // pools are created a few times and looked up for every request
     unordered_map<string, OfflineECPool*> _offlineECPoolMap;
-    mutex _lockECPoolMap;
+    shared_timed_mutex _lockECPoolMap;
     BlockingQueue<pair<string, string>> _pendingECQueue;
     mutex _lockPECQueue;
-    vector<string> _ECInProgress;
+    // signaled with _lockPECQueue on a new candidate, a finished stripe or a status change
+    condition_variable _scanCond;
+    unordered_set<string> _ECInProgress;
     mutex _lockECInProgress;
+
+    // request num of each lost object that waits for repair
     unordered_map<string, int> _lostMap;
+    // the objects of _lostMap that may be dispatched, by RepairPriority
+    IndexedHeap<string, RepairPriority> _repairQueue;
+    // lost objects, queued or in repair, and the lost objects of each stripe
+    unordered_map<string, LostObjInfo> _lostInfo;
+    unordered_map<string, unordered_set<string>> _stripeLost;
+    // racks under maintenance, until the end of their window
+    unordered_map<string, chrono::steady_clock::time_point> _maintenanceWindows;
+    long _lostSeq;
     mutex _lockLostMap;
-    vector<string> _RPInProgress;
+    // signaled with _lockLostMap on a lost object, a finished repair or a status change
+    condition_variable _repairCond;
+    unordered_set<string> _RPInProgress;
     mutex _lockRPInProgress;
 
     mutex _lockRandom;
 
+    // held by a coordinator worker while it plans the repair of a stripe
+    mutex _lockStripes[STRIPESTORE_STRIPELOCKS];
+
     // offline encoding
     bool _enableScan;
     struct timeval _startEnc, _endEnc; 
 
     bool _enableRepair;
 
-    // backup
+    // backup, the text stores of older coordinators are moved into the log at startup
     string _entryStorePath = "entryStore";
-    ofstream _entryStore;
-    mutex _lockEntryStore;
-
     string _poolStorePath = "poolStore";
-    ofstream _poolStore;
-    mutex _lockPoolStore;
+    string _metaLogPath = "metaLog";
+    string _metaSnapshotPath = "metaSnapshot";
+    MetaLog* _metaLog;
     
     unordered_map<string, string> _hdfsfile2block;
+    shared_timed_mutex _lockHDFS;
+
+    // stripes migrated to the placement of another policy of the same code, decoded by it from then on
+    unordered_map<string, ECPolicy*> _stripePolicy;
+    shared_timed_mutex _lockStripePolicy;
+    // pools that migrate, with the ecid of their target placement
+    unordered_map<string, string> _migrations;
+    mutex _lockMigrations;
+
+    // called with _lockLostMap held
+    RepairPriority repairPriorityLocked(string objname);
+    // queue objname by its priority, if it may be dispatched
+    void queueLostObjLocked(string objname);
+    // requeue the queued objects of a stripe whose lost objects change
+    void requeueStripeLocked(string stripename);
+    // requeue all queued objects, when racks enter or leave maintenance
+    void requeueAllLocked();
+    void forgetLostObjLocked(string objname);
+    // close the windows that are over, and requeue by the new priorities
+    void expireMaintenanceLocked();
+    static int shardOf(string name);
+    // NULL for an ip that has no load yet, unless create
+    AgentLoad* getAgentLoad(unsigned int ip, bool create);
+    void markLogged(string filename);
+    // the records of the metadata that is in the log, for its snapshots
+    void snapshotMeta(const MetaLogEmit& emit);
     
   public:
     StripeStore(Config* conf);
@@ -75,6 +157,13 @@ class StripeStore {
     SSEntry* getEntry(string filename);
     SSEntry* getEntryFromObj(string objname);
 
+    // serialize the coordinator workers that plan for the same stripe
+    void lockStripe(string stripename);
+    void unlockStripe(string stripename);
+    // lock several stripes at once, each lock once and in order, as stripes may share one
+    void lockStripes(vector<string> stripenames);
+    void unlockStripes(vector<string> stripenames);
+
     OfflineECPool* getECPool(string ecpoolid, ECPolicy* ecpolicy, int basesize);
     OfflineECPool* getECPool(string ecpoolid);
     void insertECPool(string ecpoolid, OfflineECPool* pool);
@@ -106,19 +195,38 @@ class StripeStore {
 //    void setScan(bool status);
     void finishECStripe(OfflineECPool* ecpool, string stripename);
     
-    // repair
+    // repair, dispatched as soon as a lost object may go and a repair slot is free
     void scanRepair();
     void addLostObj(string objname);
+    // objects stored on any of ips, e.g., those lost with a node or rack
+    vector<string> getObjsOnIps(vector<unsigned int> ips);
+    // objects of the files written into ecpoolid
+    vector<string> getObjsOfPool(string ecpoolid);
+    // take a lost object out of the repair queue and into _RPInProgress, to repair it
+    // out of the queue; false if a repair of it is already in progress
+    bool claimLostObj(string objname);
+    // blocks of a rack under maintenance come back, they are repaired after the others and decoded
+    // with maintenance decoding until the window closes, 0 seconds closes it at once
+    void setRackMaintenance(string rack, int seconds);
+    bool isRackInMaintenance(string rack);
 //    void setRepair(bool status);
     void startRepair(string objname);
     void finishRepair(string objname);
     int getRPInProgressNum();
   
     // backup
-    void backupEntry(string entrystr);
-    void backupPoolStripe(string stripename);
+    void backupEntry(SSEntry* entry);
+    // log stripename as OfflineECPool::stripe2String gives it, with pool unlocked
+    void backupPoolStripe(OfflineECPool* pool, string stripename);
 
     void setHDFSMeta(string hdfsfile, string block);
+
+    // placement migration, the policy of a stripe changes under the lock of the stripe
+    ECPolicy* getStripePolicy(string stripename, ECPolicy* poolpolicy);
+    void setStripePolicy(string ecpoolid, string stripename, string ecid);
+    // an empty ecid marks the migration of ecpoolid done
+    void setMigration(string ecpoolid, string ecid);
+    unordered_map<string, string> getMigrations();
     string getHDFSBlkName(string hdfsfile);
 
 };
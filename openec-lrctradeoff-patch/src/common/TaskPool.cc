@@ -0,0 +1,239 @@
+#include "TaskPool.hh"
+
+#include "Config.hh"
+
+TaskPool *TaskPool::_cpuPool = NULL;
+TaskPool *TaskPool::_ioPool = NULL;
+once_flag TaskPool::_initFlag;
+
+// the pool and slot of the current thread, if it is a worker
+static thread_local TaskPool *curPool = NULL;
+static thread_local int curSlot = -1;
+
+TaskHandle::TaskHandle()
+{
+}
+
+TaskHandle::TaskHandle(shared_ptr<TaskState> state)
+{
+  _state = state;
+}
+
+void TaskHandle::join()
+{
+  if (!_state)
+    return;
+  unique_lock<mutex> lck(_state->_lock);
+  if (!_state->_done)
+  {
+    TaskPool::beginBlocking();
+    _state->_cond.wait(lck, [&]
+                       { return _state->_done; });
+    TaskPool::endBlocking();
+  }
+}
+
+TaskPool::TaskPool(string name, int target, int keep)
+{
+  _name = name;
+  _target = target;
+  _keep = keep < 1 ? 1 : keep;
+  _slotNum = 0;
+  _threadNum = 0;
+  _idle = 0;
+  _running = 0;
+  _pending = 0;
+
+  lock_guard<mutex> lck(_lock);
+  for (int i = 0; i < _keep; i++)
+    spawn();
+}
+
+TaskPool *TaskPool::getCpuPool(Config *conf)
+{
+  call_once(_initFlag, [conf]
+            {
+    int cpunum = conf->_taskThreadNum;
+    if (cpunum <= 0)
+      cpunum = thread::hardware_concurrency();
+    if (cpunum <= 0)
+      cpunum = 1;
+    _cpuPool = new TaskPool("cpu", cpunum, cpunum);
+    _ioPool = new TaskPool("io", 0, conf->_taskIOThreadNum); });
+  return _cpuPool;
+}
+
+TaskPool *TaskPool::getIOPool(Config *conf)
+{
+  getCpuPool(conf);
+  return _ioPool;
+}
+
+void TaskPool::schedule()
+{
+  if (_pending == 0 || (_target > 0 && _running >= _target))
+    return;
+  if (_idle > 0)
+    _cond.notify_one();
+  else
+    spawn();
+}
+
+void TaskPool::spawn()
+{
+  int slot;
+  if (!_freeSlots.empty())
+  {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  else if (_slotNum < TASKPOOL_MAXTHREADS)
+  {
+    slot = _slotNum++;
+  }
+  else
+  {
+    cerr << "TaskPool::spawn " << _name << " pool has " << _threadNum << " threads, no more is started" << endl;
+    return;
+  }
+  _threadNum++;
+  thread worker = thread([=]
+                         { workerLoop(slot); });
+  worker.detach();
+}
+
+void TaskPool::workerLoop(int slot)
+{
+  curPool = this;
+  curSlot = slot;
+  unique_lock<mutex> lck(_lock);
+  while (true)
+  {
+    _idle++;
+    bool retire = false;
+    while (!(_pending > 0 && (_target == 0 || _running < _target)))
+    {
+      if (_cond.wait_for(lck, chrono::milliseconds(TASKPOOL_IDLE_MS)) == cv_status::timeout && _threadNum > _keep)
+      {
+        retire = true;
+        break;
+      }
+    }
+    _idle--;
+    if (retire)
+    {
+      // the tasks left in our slot are stolen by others
+      _threadNum--;
+      _freeSlots.push_back(slot);
+      schedule();
+      return;
+    }
+
+    _pending--;
+    _running++;
+    // more tasks may be waiting for a worker
+    schedule();
+    lck.unlock();
+
+    function<void()> task = take(slot);
+    task();
+
+    lck.lock();
+    _running--;
+  }
+}
+
+function<void()> TaskPool::take(int slot)
+{
+  while (true)
+  {
+    {
+      TaskSlot &own = _slots[slot];
+      lock_guard<mutex> lck(own._lock);
+      if (!own._tasks.empty())
+      {
+        function<void()> task = move(own._tasks.back());
+        own._tasks.pop_back();
+        return task;
+      }
+    }
+    {
+      lock_guard<mutex> lck(_inject._lock);
+      if (!_inject._tasks.empty())
+      {
+        function<void()> task = move(_inject._tasks.front());
+        _inject._tasks.pop_front();
+        return task;
+      }
+    }
+    int slotnum = _slotNum;
+    for (int i = 1; i < slotnum; i++)
+    {
+      TaskSlot &victim = _slots[(slot + i) % slotnum];
+      lock_guard<mutex> lck(victim._lock);
+      if (!victim._tasks.empty())
+      {
+        function<void()> task = move(victim._tasks.front());
+        victim._tasks.pop_front();
+        return task;
+      }
+    }
+    // another worker took the task we found first, look again
+    this_thread::yield();
+  }
+}
+
+TaskHandle TaskPool::submit(function<void()> task)
+{
+  shared_ptr<TaskState> state = make_shared<TaskState>();
+  function<void()> wrapped = [task, state]
+  {
+    task();
+    lock_guard<mutex> lck(state->_lock);
+    state->_done = true;
+    state->_cond.notify_all();
+  };
+
+  TaskSlot &slot = curPool == this ? _slots[curSlot] : _inject;
+  {
+    lock_guard<mutex> lck(slot._lock);
+    slot._tasks.push_back(move(wrapped));
+  }
+  {
+    lock_guard<mutex> lck(_lock);
+    _pending++;
+    schedule();
+  }
+  return TaskHandle(state);
+}
+
+void TaskPool::block()
+{
+  lock_guard<mutex> lck(_lock);
+  _running--;
+  schedule();
+}
+
+void TaskPool::unblock()
+{
+  lock_guard<mutex> lck(_lock);
+  _running++;
+}
+
+void TaskPool::beginBlocking()
+{
+  if (curPool)
+    curPool->block();
+}
+
+void TaskPool::endBlocking()
+{
+  if (curPool)
+    curPool->unblock();
+}
+
+void TaskPool::dump()
+{
+  lock_guard<mutex> lck(_lock);
+  cout << "TaskPool::" << _name << ".threads = " << _threadNum << ", running = " << _running << ", idle = " << _idle << ", pending = " << _pending << endl;
+}
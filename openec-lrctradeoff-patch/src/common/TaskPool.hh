@@ -0,0 +1,110 @@
+#ifndef _TASKPOOL_HH_
+#define _TASKPOOL_HH_
+
+#include "../inc/include.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+class Config;
+
+#define TASKPOOL_MAXTHREADS 4096
+// a thread beyond the ones a pool keeps exits after being idle for so long
+#define TASKPOOL_IDLE_MS 30000
+
+struct TaskState
+{
+  mutex _lock;
+  condition_variable _cond;
+  bool _done = false;
+};
+
+// tasks queued by one worker thread, or by threads out of the pool
+struct TaskSlot
+{
+  deque<function<void()>> _tasks;
+  mutex _lock;
+};
+
+// what a submitted task is joined with, in place of a thread
+class TaskHandle
+{
+private:
+  shared_ptr<TaskState> _state;
+
+public:
+  TaskHandle();
+  TaskHandle(shared_ptr<TaskState> state);
+  void join();
+};
+
+/**
+ * Persistent worker threads that run the stages of agent commands.
+ *
+ * Each worker has a slot of its own: a task submitted by a worker goes to
+ * its slot and is taken back last-in first-out, while idle workers steal
+ * first-in first-out from the slots of others and from the slot of threads
+ * out of the pool.
+ *
+ * At most target tasks run at once (0 for no limit). Stages wait for each
+ * other on queues, so a worker that blocks in BlockingQueue or in a join
+ * stops counting as running and another worker takes its place, which is
+ * started only if no worker is idle. Threads beyond keep exit once idle.
+ */
+class TaskPool
+{
+private:
+  string _name;
+  int _target;
+  int _keep;
+
+  TaskSlot _inject;
+  TaskSlot _slots[TASKPOOL_MAXTHREADS];
+  atomic<int> _slotNum;
+  vector<int> _freeSlots;
+
+  // guards the counters below
+  mutex _lock;
+  condition_variable _cond;
+  int _threadNum;
+  int _idle;
+  int _running;
+  // tasks queued and not taken by a worker yet
+  int _pending;
+
+  static TaskPool *_cpuPool;
+  static TaskPool *_ioPool;
+  static once_flag _initFlag;
+
+  // with _lock held: wake an idle worker or start one if a task can run
+  void schedule();
+  void spawn();
+  void workerLoop(int slot);
+  // a task counted in _pending by the caller
+  function<void()> take(int slot);
+  void block();
+  void unblock();
+
+public:
+  // never deleted, as workers may still be parked
+  TaskPool(string name, int target, int keep);
+
+  // compute stages run on a pool sized to cores (oec.task.thread.num), and
+  // stages blocking on disk or network on an unlimited one (oec.task.io.thread.num kept)
+  static TaskPool *getCpuPool(Config *conf);
+  static TaskPool *getIOPool(Config *conf);
+
+  TaskHandle submit(function<void()> task);
+
+  // around a wait of a thread that may be a worker of some pool
+  static void beginBlocking();
+  static void endBlocking();
+
+  void dump();
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include "TcpTransport.hh"
+
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+TcpSender::TcpSender(TcpTransport *transport)
+{
+  _transport = transport;
+}
+
+void TcpSender::put(string key, OECDataPacket *pkt, int refs)
+{
+  _transport->publish(key, pkt, refs);
+}
+
+void TcpSender::flush()
+{
+  // packets are accepted as soon as they are published
+}
+
+TcpTransport::TcpTransport(unsigned int localIp, int port, int credit, int storeMB)
+{
+  _localIp = localIp;
+  _port = port;
+  _credit = credit > 0 ? credit : 1;
+  _storeBytes = (long long)storeMB * 1048576;
+  _storedBytes = 0;
+  _serving = 0;
+
+  _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  int opt = 1;
+  setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = _localIp;
+  if (::bind(_listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(_listenFd, 128) < 0)
+  {
+    cerr << "TcpTransport::TcpTransport cannot listen on " << RedisUtil::ip2Str(_localIp) << ":" << _port << endl;
+    close(_listenFd);
+    _listenFd = -1;
+    return;
+  }
+
+  thread acceptThread = thread([=]
+                               { acceptWorker(); });
+  acceptThread.detach();
+}
+
+bool TcpTransport::isListening()
+{
+  return _listenFd >= 0;
+}
+
+void TcpTransport::publish(string key, OECDataPacket *pkt, int refs)
+{
+  if (refs <= 0)
+  {
+    delete pkt;
+    return;
+  }
+  string keybase = key.substr(0, key.rfind(':'));
+  int len = pkt->getDatalen();
+  {
+    unique_lock<mutex> lck(_budgetLock);
+    _budgetCond.wait(lck, [&]
+                     { return _storedBytes + len <= _storeBytes || _streamPkts[keybase] == 0; });
+    _storedBytes += len;
+    _streamPkts[keybase]++;
+  }
+  shared_ptr<OECDataPacket> curpkt(pkt);
+  {
+    lock_guard<mutex> lck(_storeLock);
+    deque<shared_ptr<OECDataPacket>> &copies = _store[key];
+    for (int i = 0; i < refs; i++)
+      copies.push_back(curpkt);
+  }
+  _storeCond.notify_all();
+}
+
+void TcpTransport::release(string keybase, int len)
+{
+  {
+    lock_guard<mutex> lck(_budgetLock);
+    _storedBytes -= len;
+    if (--_streamPkts[keybase] == 0)
+      _streamPkts.erase(keybase);
+  }
+  _budgetCond.notify_all();
+}
+
+void TcpTransport::beginFetch(string fetchid, int start)
+{
+  unique_lock<mutex> lck(_storeLock);
+  // a broken connection of the fetch parks its packets before it lets go
+  _storeCond.wait(lck, [&]
+                  { return _activeFetches.find(fetchid) == _activeFetches.end(); });
+  _activeFetches.insert(fetchid);
+  auto it = _parked.find(fetchid);
+  if (it == _parked.end())
+    return;
+  // the fetch delivered the packets before start
+  it->second.erase(it->second.begin(), it->second.lower_bound(start));
+  if (it->second.empty())
+    _parked.erase(it);
+}
+
+void TcpTransport::endFetch(string fetchid, deque<pair<int, shared_ptr<OECDataPacket>>> &unacked)
+{
+  {
+    lock_guard<mutex> lck(_storeLock);
+    if (!unacked.empty())
+    {
+      map<int, shared_ptr<OECDataPacket>> &parked = _parked[fetchid];
+      for (auto &sent : unacked)
+        parked[sent.first] = sent.second;
+    }
+    _activeFetches.erase(fetchid);
+  }
+  unacked.clear();
+  _storeCond.notify_all();
+}
+
+shared_ptr<OECDataPacket> TcpTransport::take(string fetchid, string keybase, int index, int fd)
+{
+  string key = keybase + ":" + to_string(index);
+  unique_lock<mutex> lck(_storeLock);
+  while (true)
+  {
+    auto pit = _parked.find(fetchid);
+    if (pit != _parked.end())
+    {
+      auto it = pit->second.find(index);
+      if (it != pit->second.end())
+      {
+        shared_ptr<OECDataPacket> pkt = it->second;
+        pit->second.erase(it);
+        if (pit->second.empty())
+          _parked.erase(pit);
+        return pkt;
+      }
+    }
+    auto sit = _store.find(key);
+    if (sit != _store.end())
+    {
+      shared_ptr<OECDataPacket> pkt = sit->second.front();
+      sit->second.pop_front();
+      // packets on their way to fetches are bounded by the credits instead
+      if (sit->second.empty())
+      {
+        _store.erase(sit);
+        release(keybase, pkt->getDatalen());
+      }
+      return pkt;
+    }
+    if (peerClosed(fd))
+      return nullptr;
+    _storeCond.wait_for(lck, chrono::milliseconds(TCPTRANSPORT_POLL_MS));
+  }
+}
+
+DataSender *TcpTransport::createSender()
+{
+  return new TcpSender(this);
+}
+
+void TcpTransport::acceptWorker()
+{
+  while (true)
+  {
+    int fd = accept(_listenFd, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      cerr << "TcpTransport::acceptWorker accept error " << errno << endl;
+      break;
+    }
+    if (_serving >= TCPTRANSPORT_MAX_SERVING)
+    {
+      // the peer sees a broken connection and retries
+      cerr << "TcpTransport::acceptWorker serving " << TCPTRANSPORT_MAX_SERVING << " connections, turning one away" << endl;
+      close(fd);
+      continue;
+    }
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    _serving++;
+    thread serveThread = thread([=]
+                                { serveWorker(fd);
+                                  _serving--; });
+    serveThread.detach();
+  }
+}
+
+void TcpTransport::serveWorker(int fd)
+{
+  // the fetch served or holding packets on this connection, and its packets
+  // sent and not acknowledged, oldest first
+  string fetchid;
+  deque<pair<int, shared_ptr<OECDataPacket>>> unacked;
+  auto ack = [&](int n)
+  {
+    for (; n > 0 && !unacked.empty(); n--)
+      unacked.pop_front();
+  };
+
+  int type;
+  bool ok = true;
+  while (ok && readInt(fd, type))
+  {
+    int value;
+    if (type == TCPTRANSPORT_CREDIT)
+    {
+      // credits for the last packets of a finished fetch
+      if (!(ok = readInt(fd, value)))
+        break;
+      ack(value);
+      if (unacked.empty() && !fetchid.empty())
+      {
+        endFetch(fetchid, unacked);
+        fetchid.clear();
+      }
+      continue;
+    }
+    if (type != TCPTRANSPORT_FETCH)
+    {
+      cerr << "TcpTransport::serveWorker unknown frame type " << type << endl;
+      break;
+    }
+
+    int start, num, credit, keylen, idlen;
+    if (!readInt(fd, start) || !readInt(fd, num) || !readInt(fd, credit) || !readInt(fd, keylen))
+      break;
+    string keybase(keylen, '\0');
+    if (!readFull(fd, &keybase[0], keylen) || !readInt(fd, idlen))
+      break;
+    // a fetch that left packets unacknowledged here resumes on another connection
+    if (!fetchid.empty())
+      endFetch(fetchid, unacked);
+    fetchid.assign(idlen, '\0');
+    if (!readFull(fd, &fetchid[0], idlen))
+    {
+      fetchid.clear();
+      break;
+    }
+    beginFetch(fetchid, start);
+
+    for (int i = start; i < num && ok; i++)
+    {
+      while (credit <= 0)
+      {
+        if (!readInt(fd, type) || type != TCPTRANSPORT_CREDIT || !readInt(fd, value))
+        {
+          ok = false;
+          break;
+        }
+        credit += value;
+        ack(value);
+      }
+      if (!ok)
+        break;
+      shared_ptr<OECDataPacket> pkt = take(fetchid, keybase, i, fd);
+      if (!pkt)
+      {
+        ok = false;
+        break;
+      }
+      unacked.push_back(make_pair(i, pkt));
+      char hdr[4];
+      pkt->getHeader(hdr);
+      ok = writeFull(fd, hdr, 4, true) && writeFull(fd, pkt->getData(), pkt->getDatalen(), false);
+      credit--;
+    }
+    if (ok && unacked.empty())
+    {
+      endFetch(fetchid, unacked);
+      fetchid.clear();
+    }
+  }
+  // the fetch resumes on another connection with the packets not acknowledged here
+  if (!fetchid.empty())
+    endFetch(fetchid, unacked);
+  close(fd);
+}
+
+int TcpTransport::getConn(unsigned int ip)
+{
+  {
+    lock_guard<mutex> lck(_connLock);
+    vector<int> &conns = _idleConns[ip];
+    if (!conns.empty())
+    {
+      int fd = conns.back();
+      conns.pop_back();
+      return fd;
+    }
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = ip;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+  {
+    cerr << "TcpTransport::getConn cannot connect to " << RedisUtil::ip2Str(ip) << ":" << _port << endl;
+    close(fd);
+    return -1;
+  }
+  int opt = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+  return fd;
+}
+
+void TcpTransport::putConn(unsigned int ip, int fd)
+{
+  {
+    lock_guard<mutex> lck(_connLock);
+    vector<int> &conns = _idleConns[ip];
+    if (conns.size() < TCPTRANSPORT_MAX_IDLE)
+    {
+      conns.push_back(fd);
+      return;
+    }
+  }
+  close(fd);
+}
+
+bool TcpTransport::fetch(unsigned int ip, string keybase, string fetchid, int start, int num, function<void(OECDataPacket *)> deliver)
+{
+  int next = start;
+  // a fetch with all its packets delivered still reconnects to acknowledge them
+  for (int attempt = 0; attempt <= TCPTRANSPORT_RETRIES; attempt++)
+  {
+    if (attempt > 0)
+      usleep(attempt * 100000);
+    int fd = getConn(ip);
+    if (fd < 0)
+      continue;
+    int before = next;
+    if (fetchOnce(fd, keybase, fetchid, next, num, deliver))
+    {
+      putConn(ip, fd);
+      return true;
+    }
+    cerr << "TcpTransport::fetch connection to " << RedisUtil::ip2Str(ip) << " broken for " << keybase << " at " << next << endl;
+    close(fd);
+    // a stale idle connection or a lost peer, only a fetch without progress counts against the retries
+    if (next > before)
+      attempt = -1;
+  }
+  return next >= num;
+}
+
+bool TcpTransport::fetchOnce(int fd, string keybase, string fetchid, int &next, int num, function<void(OECDataPacket *)> deliver)
+{
+  bool ok = writeInt(fd, TCPTRANSPORT_FETCH, true) && writeInt(fd, next, true) && writeInt(fd, num, true) &&
+            writeInt(fd, _credit, true) && writeInt(fd, keybase.size(), true) &&
+            writeFull(fd, (char *)keybase.c_str(), keybase.size(), true) && writeInt(fd, fetchid.size(), true) &&
+            writeFull(fd, (char *)fetchid.c_str(), fetchid.size(), false);
+
+  // return credits in batches to save frames
+  int batch = max(1, _credit / 2);
+  int consumed = 0;
+  while (next < num && ok)
+  {
+    int len;
+    if (!(ok = readInt(fd, len)))
+      break;
+    OECDataPacket *pkt = new OECDataPacket(len, false);
+    if (!(ok = readFull(fd, pkt->getData(), len)))
+    {
+      delete pkt;
+      break;
+    }
+    deliver(pkt);
+    next++;
+    consumed++;
+    if (consumed == batch || next == num)
+    {
+      ok = writeInt(fd, TCPTRANSPORT_CREDIT, true) && writeInt(fd, consumed, false);
+      consumed = 0;
+    }
+  }
+  return ok;
+}
+
+bool TcpTransport::readFull(int fd, char *buf, int len)
+{
+  int hasread = 0;
+  while (hasread < len)
+  {
+    int ret = recv(fd, buf + hasread, len - hasread, 0);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    hasread += ret;
+  }
+  return true;
+}
+
+bool TcpTransport::writeFull(int fd, char *buf, int len, bool more)
+{
+  int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+  int written = 0;
+  while (written < len)
+  {
+    int ret = send(fd, buf + written, len - written, flags);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    written += ret;
+  }
+  return true;
+}
+
+bool TcpTransport::readInt(int fd, int &value)
+{
+  int tmp;
+  if (!readFull(fd, (char *)&tmp, 4))
+    return false;
+  value = ntohl(tmp);
+  return true;
+}
+
+bool TcpTransport::writeInt(int fd, int value, bool more)
+{
+  int tmp = htonl(value);
+  return writeFull(fd, (char *)&tmp, 4, more);
+}
+
+bool TcpTransport::peerClosed(int fd)
+{
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLRDHUP;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
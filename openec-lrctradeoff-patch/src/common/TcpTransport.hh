@@ -0,0 +1,129 @@
+#ifndef _TCPTRANSPORT_HH_
+#define _TCPTRANSPORT_HH_
+
+#include "DataTransport.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <unordered_set>
+
+using namespace std;
+
+// frame types sent by a fetching agent
+#define TCPTRANSPORT_FETCH 1
+#define TCPTRANSPORT_CREDIT 2
+// reconnects of a fetch that makes no progress before it fails
+#define TCPTRANSPORT_RETRIES 3
+// connections an agent serves at once, further peers are turned away
+#define TCPTRANSPORT_MAX_SERVING 256
+// idle connections kept to each peer
+#define TCPTRANSPORT_MAX_IDLE 16
+// milliseconds between checks of a fetching agent while its packet is not published
+#define TCPTRANSPORT_POLL_MS 100
+
+class TcpTransport;
+
+class TcpSender : public DataSender
+{
+private:
+  TcpTransport *_transport;
+
+public:
+  TcpSender(TcpTransport *transport);
+  void put(string key, OECDataPacket *pkt, int refs);
+  void flush();
+};
+
+/**
+ * Agent-to-agent transport over persistent TCP connections.
+ *
+ * Published packets stay in the memory of the publishing agent, and a packet
+ * published for refs fetches is shared by them instead of being copied.
+ * Every agent serves its packets on local.addr:oec.data.port, so several
+ * agents can run on one host with different loopback addresses.
+ *
+ * A fetch sends |FETCH|start|num|credit|keylen|keybase|idlen|fetchid| on
+ * an idle connection to the peer, and the peer streams keybase:start to
+ * keybase:num-1 back as |len|data| frames, the same layout as the raw of a
+ * packet. The peer sends a frame only when it holds a credit; the fetching
+ * agent returns credits in |CREDIT|n| frames as it consumes packets, the
+ * last ones included, and they acknowledge the oldest packets sent.
+ *
+ * The peer keeps the packets it sent until they are acknowledged. When a
+ * connection breaks, they are parked under the fetch id, and the fetch
+ * reconnects and resumes at the first packet it did not deliver: the parked
+ * packets before it are dropped and the others are sent again. A fetch that
+ * delivered all its packets but could not acknowledge them resumes at num
+ * only to drop them.
+ *
+ * Publishing blocks while the packets not taken by all their fetches exceed
+ * oec.data.store.size, unless the stream of the packet, its keybase, has
+ * none, so that a stream never waits for the fetches of another. Packets
+ * taken and not acknowledged are bounded by the credits of the fetches.
+ * Packets of a fetch whose agent never comes back stay parked.
+ */
+class TcpTransport : public DataTransport
+{
+private:
+  unsigned int _localIp;
+  int _port;
+  int _credit;
+
+  // published packets, with a copy for each fetch that takes them
+  unordered_map<string, deque<shared_ptr<OECDataPacket>>> _store;
+  // packets sent on broken connections and not acknowledged, by fetch id and index
+  unordered_map<string, map<int, shared_ptr<OECDataPacket>>> _parked;
+  // fetches with a connection that serves them or holds their packets
+  unordered_set<string> _activeFetches;
+  mutex _storeLock;
+  condition_variable _storeCond;
+
+  // bytes of the packets not taken by all their fetches, and such packets of each stream
+  long long _storeBytes;
+  long long _storedBytes;
+  unordered_map<string, int> _streamPkts;
+  mutex _budgetLock;
+  condition_variable _budgetCond;
+
+  // idle connections to each peer
+  unordered_map<unsigned int, vector<int>> _idleConns;
+  mutex _connLock;
+
+  int _listenFd;
+  atomic<int> _serving;
+
+  void acceptWorker();
+  void serveWorker(int fd);
+  // return the bytes of a packet of keybase taken by all its fetches, with _storeLock held
+  void release(string keybase, int len);
+  // serve fetchid on this connection from start, once no other connection holds its packets
+  void beginFetch(string fetchid, int start);
+  // park the packets of fetchid not acknowledged on this connection
+  void endFetch(string fetchid, deque<pair<int, shared_ptr<OECDataPacket>>> &unacked);
+  // wait until packet index of keybase is parked for fetchid or published, and take it;
+  // NULL once the fetching agent on fd is gone
+  shared_ptr<OECDataPacket> take(string fetchid, string keybase, int index, int fd);
+  int getConn(unsigned int ip);
+  void putConn(unsigned int ip, int fd);
+  // one fetch on fd, next is the index of the next packet to deliver
+  bool fetchOnce(int fd, string keybase, string fetchid, int &next, int num, function<void(OECDataPacket *)> deliver);
+
+  static bool readFull(int fd, char *buf, int len);
+  static bool writeFull(int fd, char *buf, int len, bool more);
+  static bool readInt(int fd, int &value);
+  static bool writeInt(int fd, int value, bool more);
+  static bool peerClosed(int fd);
+
+public:
+  // never deleted once listening, as serving threads outlive any command
+  TcpTransport(unsigned int localIp, int port, int credit, int storeMB);
+
+  bool isListening();
+  void publish(string key, OECDataPacket *pkt, int refs);
+  DataSender *createSender();
+  bool fetch(unsigned int ip, string keybase, string fetchid, int start, int num, function<void(OECDataPacket *)> deliver);
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "CodingPlan.hh"
+
+mutex CodingPlan::_planLock;
+unordered_map<string, shared_ptr<CodingPlan>> CodingPlan::_planMap;
+unsigned long CodingPlan::_hits = 0;
+unsigned long CodingPlan::_misses = 0;
+
+CodingPlan::CodingPlan(int *matrix, int row, int col)
+{
+  _row = row;
+  _col = col;
+  _gftbls = NULL;
+
+  for (int i = 0; i < row; i++)
+  {
+    bool isxor = true;
+    vector<int> srcs;
+    for (int j = 0; j < col; j++)
+    {
+      int coef = matrix[i * col + j];
+      if (coef == 1)
+        srcs.push_back(j);
+      else if (coef != 0)
+      {
+        isxor = false;
+        break;
+      }
+    }
+    if (isxor)
+    {
+      _xorRows.push_back(i);
+      _xorSrcs.push_back(srcs);
+    }
+    else
+    {
+      _gfRows.push_back(i);
+    }
+  }
+
+  _xorRowsOfSrc = vector<vector<int>>(col);
+  for (int i = 0; i < _xorRows.size(); i++)
+    for (auto src : _xorSrcs[i])
+      _xorRowsOfSrc[src].push_back(_xorRows[i]);
+
+  int gfrow = _gfRows.size();
+  if (gfrow > 0)
+  {
+    unsigned char *imatrix = (unsigned char *)calloc(gfrow * col, sizeof(unsigned char));
+    for (int i = 0; i < gfrow; i++)
+      for (int j = 0; j < col; j++)
+        imatrix[i * col + j] = (unsigned char)matrix[_gfRows[i] * col + j];
+    _gftbls = (unsigned char *)calloc(32 * gfrow * col, sizeof(unsigned char));
+    ec_init_tables(col, gfrow, imatrix, _gftbls);
+    free(imatrix);
+  }
+}
+
+CodingPlan::~CodingPlan()
+{
+  if (_gftbls)
+    free(_gftbls);
+}
+
+string CodingPlan::genKey(int *matrix, int row, int col)
+{
+  string key = to_string(row) + "x" + to_string(col) + ":";
+  for (int i = 0; i < row * col; i++)
+    key.push_back((char)matrix[i]);
+  return key;
+}
+
+shared_ptr<CodingPlan> CodingPlan::getPlan(int *matrix, int row, int col)
+{
+  string key = genKey(matrix, row, col);
+  lock_guard<mutex> lck(_planLock);
+  auto it = _planMap.find(key);
+  if (it != _planMap.end())
+  {
+    _hits++;
+    return it->second;
+  }
+  _misses++;
+  if (_planMap.size() >= CODINGPLAN_CACHE_MAX)
+    _planMap.clear();
+  shared_ptr<CodingPlan> plan = make_shared<CodingPlan>(matrix, row, col);
+  _planMap.insert(make_pair(key, plan));
+  return plan;
+}
+
+void CodingPlan::getStats(unsigned long &hits, unsigned long &misses)
+{
+  lock_guard<mutex> lck(_planLock);
+  hits = _hits;
+  misses = _misses;
+}
+
+void CodingPlan::encode(char **code, char **data, int len)
+{
+  int xorrow = _xorRows.size();
+  int gfrow = _gfRows.size();
+  if (xorrow > 0)
+  {
+    vector<char *> srcs(_col);
+    for (int i = 0; i < xorrow; i++)
+    {
+      vector<int> &cursrcs = _xorSrcs[i];
+      for (int j = 0; j < cursrcs.size(); j++)
+        srcs[j] = data[cursrcs[j]];
+      XorKernel::xorData(code[_xorRows[i]], srcs.data(), cursrcs.size(), len);
+    }
+  }
+  if (gfrow == _row)
+  {
+    ec_encode_data(len, _col, _row, _gftbls, (unsigned char **)data, (unsigned char **)code);
+  }
+  else if (gfrow > 0)
+  {
+    vector<char *> gfcode(gfrow);
+    for (int i = 0; i < gfrow; i++)
+      gfcode[i] = code[_gfRows[i]];
+    ec_encode_data(len, _col, gfrow, _gftbls, (unsigned char **)data, (unsigned char **)gfcode.data());
+  }
+}
+
+void CodingPlan::update(char **code, char *data, int vecidx, int len)
+{
+  for (auto xorrow : _xorRowsOfSrc[vecidx])
+    XorKernel::xorUpdate(code[xorrow], &data, 1, len);
+  int gfrow = _gfRows.size();
+  if (gfrow == _row)
+  {
+    ec_encode_data_update(len, _col, _row, vecidx, _gftbls, (unsigned char *)data, (unsigned char **)code);
+  }
+  else if (gfrow > 0)
+  {
+    vector<char *> gfcode(gfrow);
+    for (int i = 0; i < gfrow; i++)
+      gfcode[i] = code[_gfRows[i]];
+    ec_encode_data_update(len, _col, gfrow, vecidx, _gftbls, (unsigned char *)data, (unsigned char **)gfcode.data());
+  }
+}
+
+int CodingPlan::getTileNum(int len, int &tilesize, int threadnum)
+{
+  // without tiling, we still split the buffers into one part per core
+  if (tilesize <= 0 || tilesize > len)
+    tilesize = threadnum > 1 ? (len + threadnum - 1) / threadnum : len;
+  // keep tiles aligned to 64B for the SIMD kernels
+  if (tilesize < len)
+    tilesize = (tilesize + 63) / 64 * 64;
+  return (len + tilesize - 1) / tilesize;
+}
+
+void CodingPlan::encode(char **code, char **data, int len, int tilesize, int threadnum)
+{
+  int tilenum = getTileNum(len, tilesize, threadnum);
+  if (tilenum <= 1)
+  {
+    encode(code, data, len);
+    return;
+  }
+  ComputePool::getPool(threadnum)->parallelFor(tilenum, [&](int tileid)
+                                               {
+    int offset = tileid * tilesize;
+    int curlen = min(tilesize, len - offset);
+    vector<char *> tilecode(_row);
+    vector<char *> tiledata(_col);
+    for (int i = 0; i < _row; i++)
+      tilecode[i] = code[i] + offset;
+    for (int j = 0; j < _col; j++)
+      tiledata[j] = data[j] + offset;
+    encode(tilecode.data(), tiledata.data(), curlen); });
+}
+
+void CodingPlan::update(char **code, char *data, int vecidx, int len, int tilesize, int threadnum)
+{
+  int tilenum = getTileNum(len, tilesize, threadnum);
+  if (tilenum <= 1)
+  {
+    update(code, data, vecidx, len);
+    return;
+  }
+  ComputePool::getPool(threadnum)->parallelFor(tilenum, [&](int tileid)
+                                               {
+    int offset = tileid * tilesize;
+    int curlen = min(tilesize, len - offset);
+    vector<char *> tilecode(_row);
+    for (int i = 0; i < _row; i++)
+      tilecode[i] = code[i] + offset;
+    update(tilecode.data(), data + offset, vecidx, curlen); });
+}
+
+int CodingPlan::getRow()
+{
+  return _row;
+}
+
+int CodingPlan::getCol()
+{
+  return _col;
+}
+
+int CodingPlan::getXorRowNum()
+{
+  return _xorRows.size();
+}
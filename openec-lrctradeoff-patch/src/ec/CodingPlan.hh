@@ -0,0 +1,74 @@
+#ifndef _CODINGPLAN_HH_
+#define _CODINGPLAN_HH_
+
+#include "ComputePool.hh"
+#include "Computation.hh"
+#include "XorKernel.hh"
+
+#include "../inc/include.hh"
+
+#include <memory>
+
+using namespace std;
+
+#define CODINGPLAN_CACHE_MAX 1024
+
+/**
+ * A CodingPlan holds the expanded ISA-L GF tables of one coefficient matrix,
+ * so that coding a packet only runs the SIMD multiply.
+ *
+ * Plans are cached by matrix content and shared across worker threads and
+ * commands. A different matrix always maps to a different plan, so a cached
+ * plan never goes stale; when the cache grows beyond CODINGPLAN_CACHE_MAX it
+ * is cleared and plans still in use are released by their last holder.
+ *
+ * Rows whose coefficients are all 0/1 skip the GF tables and are coded by the
+ * multi-source XOR kernel; only the remaining rows go through ISA-L.
+ */
+class CodingPlan
+{
+private:
+  int _row;
+  int _col;
+
+  // rows coded by xor, and the sources with coefficient 1 of each row
+  vector<int> _xorRows;
+  vector<vector<int>> _xorSrcs;
+  // for each source, the xor rows it contributes to
+  vector<vector<int>> _xorRowsOfSrc;
+
+  // rows coded by ISA-L, and the GF tables of these rows
+  vector<int> _gfRows;
+  unsigned char *_gftbls;
+
+  static mutex _planLock;
+  static unordered_map<string, shared_ptr<CodingPlan>> _planMap;
+  static unsigned long _hits;
+  static unsigned long _misses;
+
+  static string genKey(int *matrix, int row, int col);
+  static int getTileNum(int len, int &tilesize, int threadnum);
+
+public:
+  CodingPlan(int *matrix, int row, int col);
+  ~CodingPlan();
+
+  // look up the plan for a row x col matrix, build it on first use
+  static shared_ptr<CodingPlan> getPlan(int *matrix, int row, int col);
+  static void getStats(unsigned long &hits, unsigned long &misses);
+
+  // code[i] = sum_j matrix[i][j] * data[j], for len bytes
+  void encode(char **code, char **data, int len);
+  // code[i] += matrix[i][vecidx] * data, for len bytes
+  void update(char **code, char *data, int vecidx, int len);
+
+  // same as above, but the buffers are coded tilesize bytes at a time so that the
+  // working set stays in L2, and tiles are spread over threadnum cores
+  void encode(char **code, char **data, int len, int tilesize, int threadnum);
+  void update(char **code, char *data, int vecidx, int len, int tilesize, int threadnum);
+  int getRow();
+  int getCol();
+  int getXorRowNum();
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "ComputePool.hh"
+
+ComputePool *ComputePool::_pool = NULL;
+once_flag ComputePool::_initFlag;
+
+ComputePool::ComputePool(int threadnum)
+{
+  _threadNum = threadnum < 1 ? 1 : threadnum;
+  _stop = false;
+  // the caller of parallelFor works as well, so we only need threadnum-1 helpers
+  for (int i = 0; i < _threadNum - 1; i++)
+  {
+    _workers.push_back(thread([=]
+                              { workerLoop(); }));
+  }
+}
+
+ComputePool::~ComputePool()
+{
+  {
+    lock_guard<mutex> lck(_lock);
+    _stop = true;
+  }
+  _cond.notify_all();
+  for (int i = 0; i < _workers.size(); i++)
+    _workers[i].join();
+}
+
+ComputePool *ComputePool::getPool(int threadnum)
+{
+  call_once(_initFlag, [=]
+            { _pool = new ComputePool(threadnum); });
+  return _pool;
+}
+
+void ComputePool::runJob(shared_ptr<ComputeJob> job)
+{
+  int idx;
+  while ((idx = job->_next++) < job->_num)
+  {
+    job->_func(idx);
+    if (++job->_done == job->_num)
+    {
+      lock_guard<mutex> lck(job->_lock);
+      job->_cond.notify_all();
+    }
+  }
+}
+
+void ComputePool::workerLoop()
+{
+  while (true)
+  {
+    shared_ptr<ComputeJob> job;
+    {
+      unique_lock<mutex> lck(_lock);
+      _cond.wait(lck, [&]
+                 { return _stop || !_jobQueue.empty(); });
+      if (_stop)
+        return;
+      job = _jobQueue.front();
+      if (job->_next >= job->_num)
+      {
+        // all tasks of this job have been taken
+        _jobQueue.pop_front();
+        continue;
+      }
+    }
+    runJob(job);
+  }
+}
+
+void ComputePool::parallelFor(int num, function<void(int)> func)
+{
+  if (num <= 1 || _threadNum <= 1)
+  {
+    for (int i = 0; i < num; i++)
+      func(i);
+    return;
+  }
+
+  shared_ptr<ComputeJob> job = make_shared<ComputeJob>();
+  job->_func = func;
+  job->_num = num;
+  job->_next = 0;
+  job->_done = 0;
+  {
+    lock_guard<mutex> lck(_lock);
+    _jobQueue.push_back(job);
+  }
+  _cond.notify_all();
+
+  runJob(job);
+  {
+    unique_lock<mutex> lck(job->_lock);
+    job->_cond.wait(lck, [&]
+                    { return job->_done == job->_num; });
+  }
+
+  // remove the job if no helper has done it
+  lock_guard<mutex> lck(_lock);
+  auto it = find(_jobQueue.begin(), _jobQueue.end(), job);
+  if (it != _jobQueue.end())
+    _jobQueue.erase(it);
+}
+
+int ComputePool::getThreadNum()
+{
+  return _threadNum;
+}
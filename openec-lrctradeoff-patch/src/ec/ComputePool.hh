@@ -0,0 +1,58 @@
+#ifndef _COMPUTEPOOL_HH_
+#define _COMPUTEPOOL_HH_
+
+#include "../inc/include.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+// a batch of independent tasks, e.g., the tiles of one packet
+struct ComputeJob
+{
+  function<void(int)> _func;
+  int _num;
+  atomic<int> _next;
+  atomic<int> _done;
+  mutex _lock;
+  condition_variable _cond;
+};
+
+/**
+ * A fixed set of helper threads shared by all compute threads in the process.
+ *
+ * parallelFor(num, func) runs func(0) ... func(num-1) with the caller and the
+ * helpers taking tasks one by one, and returns after all of them finish.
+ * Several callers can use the pool at the same time.
+ */
+class ComputePool
+{
+private:
+  int _threadNum;
+  vector<thread> _workers;
+  deque<shared_ptr<ComputeJob>> _jobQueue;
+  mutex _lock;
+  condition_variable _cond;
+  bool _stop;
+
+  static ComputePool *_pool;
+  static once_flag _initFlag;
+
+  void workerLoop();
+  void runJob(shared_ptr<ComputeJob> job);
+
+public:
+  ComputePool(int threadnum);
+  ~ComputePool();
+
+  // the pool of the process, created by the first call with threadnum
+  static ComputePool *getPool(int threadnum);
+
+  void parallelFor(int num, function<void(int)> func);
+  int getThreadNum();
+};
+
+#endif
@@ -6,18 +6,66 @@ ECDAG::ECDAG()
 
 ECDAG::~ECDAG()
 {
-  for (auto it : _ecNodeMap)
+  for (auto it : _clusterMap)
+    delete it;
+}
+
+ECNode *ECDAG::findNode(int cidx)
+{
+  unordered_map<int, int>::iterator it = _ecNodeIdx.find(cidx);
+  if (it == _ecNodeIdx.end())
+    return NULL;
+  return _ecNodes[it->second];
+}
+
+ECNode *ECDAG::addNode(int cidx)
+{
+  assert(_ecNodeIdx.find(cidx) == _ecNodeIdx.end());
+  _ecNodeArena.emplace_back(cidx);
+  ECNode *node = &_ecNodeArena.back();
+  _ecNodeIdx.insert(make_pair(cidx, _ecNodes.size()));
+  _ecNodes.push_back(node);
+  _isHeader.push_back(false);
+  return node;
+}
+
+bool ECDAG::isHeader(int cidx)
+{
+  unordered_map<int, int>::iterator it = _ecNodeIdx.find(cidx);
+  return it != _ecNodeIdx.end() && _isHeader[it->second];
+}
+
+void ECDAG::addHeader(int cidx)
+{
+  int idx = _ecNodeIdx[cidx];
+  if (_isHeader[idx])
+    return;
+  _isHeader[idx] = true;
+  _ecHeaders.push_back(cidx);
+}
+
+void ECDAG::removeHeader(int cidx)
+{
+  unordered_map<int, int>::iterator it = _ecNodeIdx.find(cidx);
+  if (it != _ecNodeIdx.end())
+    _isHeader[it->second] = false;
+}
+
+void ECDAG::deleteClusters(vector<int> deletelist)
+{
+  vector<Cluster *> remaining;
+  int j = 0;
+  for (int i = 0; i < _clusterMap.size(); i++)
   {
-    if (it.second)
+    if (j < deletelist.size() && deletelist[j] == i)
     {
-      delete it.second;
-      it.second = nullptr;
+      delete _clusterMap[i];
+      j++;
     }
+    else
+      remaining.push_back(_clusterMap[i]);
   }
-  _ecNodeMap.clear();
-
-  for (auto it : _clusterMap)
-    delete it;
+  _clusterMap = remaining;
 }
 
 int ECDAG::findCluster(vector<int> childs)
@@ -49,47 +97,32 @@ void ECDAG::Join(int pidx, vector<int> cidx, vector<int> coefs)
   for (int i = 0; i < cidx.size(); i++)
   {
     int curId = cidx[i];
-    // 0.0 check whether child exists in our ecNodeMap
-    unordered_map<int, ECNode *>::const_iterator findNode = _ecNodeMap.find(curId);
-    ECNode *curNode;
-    if (findNode == _ecNodeMap.end())
+    // 0.0 check whether child exists in our dag
+    ECNode *curNode = findNode(curId);
+    if (curNode == NULL)
     {
       // child does not exists, we need to create a new one
-      curNode = new ECNode(curId);
-      // insert into ecNodeMap
-      _ecNodeMap.insert(make_pair(curId, curNode));
-    }
-    else
-    {
-      // child exists
-      curNode = _ecNodeMap[curId];
+      curNode = addNode(curId);
     }
     // 0.1 add curNode into targetChilds
     targetChilds.push_back(curNode);
-    // 0.2 check whether curNode is in headers
-    vector<int>::iterator findpos = find(_ecHeaders.begin(), _ecHeaders.end(), curId);
-    if (findpos != _ecHeaders.end())
-    {
-      // delete from headers
-      _ecHeaders.erase(findpos);
-    }
+    // 0.2 delete curNode from headers, if it is there
+    removeHeader(curId);
     // 0.3 increase refNo for curNode
     curNode->incRefNumFor(curId);
   }
 
   // 1. deal with root
-  ECNode *rNode;
-  if (_ecNodeMap.find(pidx) == _ecNodeMap.end())
+  ECNode *rNode = findNode(pidx);
+  if (rNode == NULL)
   {
     // pidx does not exists, create new one and add to headers
-    rNode = new ECNode(pidx);
-    _ecNodeMap.insert(make_pair(pidx, rNode));
-    _ecHeaders.push_back(pidx);
+    rNode = addNode(pidx);
+    addHeader(pidx);
   }
   else
   {
     // pidx exists, clean the pidx node
-    rNode = _ecNodeMap[pidx];
     rNode->cleanChilds();
   }
   rNode->setChilds(targetChilds);
@@ -119,21 +152,18 @@ int ECDAG::BindX(vector<int> idxs)
     return -1;
   // 0. create a bind node
   int bindid = _bindId++;
-  assert(_ecNodeMap.find(bindid) == _ecNodeMap.end());
-  ECNode *bindNode = new ECNode(bindid);
+  ECNode *bindNode = addNode(bindid);
   // 1. we need to make sure for each node in idxs, their child are the same
   vector<int> childids;
   vector<ECNode *> childnodes;
   assert(idxs.size() > 0);
-  assert(_ecNodeMap.find(idxs[0]) != _ecNodeMap.end());
-  childnodes = _ecNodeMap[idxs[0]]->getChildren();
+  childnodes = getNode(idxs[0])->getChildren();
   for (int i = 0; i < childnodes.size(); i++)
     childids.push_back(childnodes[i]->getNodeId());
   bindNode->setChilds(childnodes);
   for (int i = 1; i < idxs.size(); i++)
   {
-    assert(_ecNodeMap.find(idxs[i]) != _ecNodeMap.end());
-    ECNode *curnode = _ecNodeMap[idxs[i]];
+    ECNode *curnode = getNode(idxs[i]);
     vector<ECNode *> curchildnodes = curnode->getChildren();
     assert(curchildnodes.size() == childids.size());
     for (int j = 0; j < curchildnodes.size(); j++)
@@ -148,8 +178,7 @@ int ECDAG::BindX(vector<int> idxs)
   for (int i = 0; i < idxs.size(); i++)
   {
     int tbid = idxs[i];
-    assert(_ecNodeMap.find(tbid) != _ecNodeMap.end());
-    ECNode *tbnode = _ecNodeMap[tbid];
+    ECNode *tbnode = getNode(tbid);
     // add the coef of cur node to the bind node
     for (auto item : tbnode->getCoefmap())
     {
@@ -163,8 +192,6 @@ int ECDAG::BindX(vector<int> idxs)
     tbnode->setChilds(newChildNodes);
     tbnode->addCoefs(tbid, {1});
   }
-  // 3. add tbnode into ecmap
-  _ecNodeMap.insert(make_pair(bindid, bindNode));
   // 4. deal with cluster
   int clusterid = findCluster(childids);
   assert(clusterid != -1);
@@ -194,18 +221,14 @@ int ECDAG::BindX(vector<int> idxs)
 
 void ECDAG::BindY(int pidx, int cidx)
 {
-  unordered_map<int, ECNode *>::const_iterator curNode = _ecNodeMap.find(pidx);
-  assert(curNode != _ecNodeMap.end());
-  ECNode *toaddNode = _ecNodeMap[pidx];
+  ECNode *toaddNode = getNode(pidx);
   vector<ECNode *> childNodes = toaddNode->getChildren();
 
   vector<int> childids;
   for (int i = 0; i < childNodes.size(); i++)
     childids.push_back(childNodes[i]->getNodeId());
 
-  curNode = _ecNodeMap.find(cidx);
-  assert(curNode != _ecNodeMap.end());
-  ECNode *consNode = _ecNodeMap[cidx];
+  assert(findNode(cidx) != NULL);
 
   toaddNode->setConstraint(true, cidx);
 
@@ -217,111 +240,69 @@ void ECDAG::BindY(int pidx, int cidx)
   cluster->setOpt(1);
 }
 
-vector<int> ECDAG::toposort()
+ECDAG *ECDAG::clone()
 {
-
-  vector<int> toret;
-
-  // We maintain 3 data-structures for topological sorting
-  unordered_map<int, vector<int>> child2Parent; // given childId, get the parent list of this child
-  unordered_map<int, vector<int>> inNum2List;   // given incoming number, get the nodeId List
-  unordered_map<int, int> id2InNum;             // given nodeId, figure out current inNum
-
-  for (auto item : _ecNodeMap)
+  ECDAG *toret = new ECDAG();
+  for (auto node : _ecNodes)
+    toret->addNode(node->getNodeId());
+  for (int i = 0; i < _ecNodes.size(); i++)
   {
-    int nodeId = item.first;
-    ECNode *curNode = item.second;
-    vector<ECNode *> childNodes = curNode->getChildren();
-    int inNum = childNodes.size();
-    id2InNum.insert(make_pair(nodeId, inNum));
-
-    // maintain child->parent
-    for (auto item : childNodes)
-    {
-      int childId = item->getNodeId();
-      if (child2Parent.find(childId) == child2Parent.end())
-      {
-        vector<int> list = {nodeId};
-        child2Parent.insert(make_pair(childId, list));
-      }
-      else
-      {
-        child2Parent[childId].push_back(nodeId);
-      }
-    }
+    vector<ECNode *> childs;
+    for (auto child : _ecNodes[i]->getChildren())
+      childs.push_back(toret->_ecNodes[_ecNodeIdx[child->getNodeId()]]);
+    toret->_ecNodes[i]->copyFrom(_ecNodes[i], childs);
+  }
+  toret->_ecHeaders = _ecHeaders;
+  toret->_isHeader = _isHeader;
+  toret->_bindId = _bindId;
+  toret->_optId = _optId;
+  return toret;
+}
 
-    // maintain inNum2List
-    if (inNum2List.find(inNum) == inNum2List.end())
-    {
-      vector<int> list = {nodeId};
-      inNum2List.insert(make_pair(inNum, list));
-    }
-    else
+vector<int> ECDAG::toposort()
+{
+  // Kahn's algorithm: a node is visited once all of its children are
+  int nodenum = _ecNodes.size();
+  vector<int> inNum(nodenum, 0);
+  vector<int> childIdx;
+  // parents of dense number i are parents[parentOff[i]..parentOff[i+1])
+  vector<int> parentOff(nodenum + 1, 0);
+  for (int i = 0; i < nodenum; i++)
+  {
+    for (auto child : _ecNodes[i]->getChildren())
     {
-      inNum2List[inNum].push_back(nodeId);
+      int c = _ecNodeIdx[child->getNodeId()];
+      childIdx.push_back(c);
+      parentOff[c + 1]++;
+      inNum[i]++;
     }
   }
+  for (int i = 0; i < nodenum; i++)
+    parentOff[i + 1] += parentOff[i];
+  vector<int> parents(childIdx.size());
+  vector<int> fill(parentOff.begin(), parentOff.end() - 1);
+  int e = 0;
+  for (int i = 0; i < nodenum; i++)
+  {
+    for (int j = 0; j < inNum[i]; j++)
+      parents[fill[childIdx[e++]]++] = i;
+  }
 
-  //  for (auto item: child2Parent) {
-  //    cout << "child: " << item.first << ", parentList: ";
-  //    for (auto p: item.second) cout << p << " ";
-  //    cout << endl;
-  //  }
-  //
-  //  for (auto item: inNum2List) {
-  //    cout << "inNum: " << item.first << ", List:";
-  //    for (auto nid: item.second) cout << " " << nid;
-  //    cout << endl;
-  //  }
-
-  // in each iteration we check nodes with inNum = 0
-  while (true)
+  vector<int> queue;
+  for (int i = 0; i < nodenum; i++)
+  {
+    if (inNum[i] == 0)
+      queue.push_back(i);
+  }
+  vector<int> toret;
+  for (int head = 0; head < queue.size(); head++)
   {
-    if (inNum2List.find(0) == inNum2List.end())
-      break;
-    if (inNum2List[0].size() == 0)
-      break;
-
-    // take out the list with incoming number equals to 0
-    vector<int> zerolist = inNum2List[0];
-    //    cout << "zerolist1: ";
-    //    for (auto xl: zerolist) cout << xl << " ";
-    //    cout << endl;
-    // add items in zerolist to toret list
-    for (auto id : zerolist)
-      toret.push_back(id);
-    inNum2List[0].clear();
-    for (auto id : zerolist)
+    int cur = queue[head];
+    toret.push_back(_ecNodes[cur]->getNodeId());
+    for (int j = parentOff[cur]; j < parentOff[cur + 1]; j++)
     {
-      // do something to corresponding parent
-      vector<int> idparentlist = child2Parent[id];
-      //      cout << "parentlist for " << id << ": ";
-      //      for (auto xl: idparentlist) cout << xl << " ";
-      //      cout << endl;
-      for (auto p : idparentlist)
-      {
-        // figure out current inNum
-        int curInNum = id2InNum[p];
-        // figure out updated inNum
-        int updatedInNum = curInNum - 1;
-        // update id2InNum for p
-        id2InNum[p] = updatedInNum;
-        //	cout << "inNum for " << p << ": " << curInNum << " -> " << updatedInNum << endl;
-
-        // remove p from curInNum list
-        vector<int>::iterator ppos = find(inNum2List[curInNum].begin(), inNum2List[curInNum].end(), p);
-        inNum2List[curInNum].erase(ppos);
-        // add to updated list
-        if (inNum2List.find(updatedInNum) == inNum2List.end())
-        {
-          vector<int> updatedlist = {p};
-          inNum2List.insert(make_pair(updatedInNum, updatedlist));
-        }
-        else
-        {
-          inNum2List[updatedInNum].push_back(p);
-        }
-      }
+      if (--inNum[parents[j]] == 0)
+        queue.push_back(parents[j]);
     }
   }
   return toret;
@@ -329,24 +310,36 @@ vector<int> ECDAG::toposort()
 
 ECNode *ECDAG::getNode(int cidx)
 {
-  assert(_ecNodeMap.find(cidx) != _ecNodeMap.end());
-  return _ecNodeMap[cidx];
+  ECNode *node = findNode(cidx);
+  assert(node != NULL);
+  return node;
 }
 
 vector<int> ECDAG::getHeaders()
 {
-  return _ecHeaders;
+  // leave out the roots that were removed, and any root added again after that
+  vector<int> toret;
+  vector<bool> kept(_ecNodes.size(), false);
+  for (auto cid : _ecHeaders)
+  {
+    int idx = _ecNodeIdx[cid];
+    if (_isHeader[idx] && !kept[idx])
+    {
+      kept[idx] = true;
+      toret.push_back(cid);
+    }
+  }
+  _ecHeaders = toret;
+  return toret;
 }
 
 vector<int> ECDAG::getLeaves()
 {
   vector<int> toret;
-  for (auto item : _ecNodeMap)
+  for (auto node : _ecNodes)
   {
-    int idx = item.first;
-    ECNode *node = item.second;
     if (node->getChildNum() == 0)
-      toret.push_back(idx);
+      toret.push_back(node->getNodeId());
   }
   sort(toret.begin(), toret.end());
   return toret;
@@ -384,12 +377,12 @@ void ECDAG::optimize(int opt,
   else if (opt == 2)
   {
     unordered_map<int, string> cid2Rack;
-    for (auto item : _ecNodeMap)
+    for (auto node : _ecNodes)
     {
-      //      ECNode* curnode = item.second;
+      //      ECNode* curnode = node;
       //      unsigned int curip = curnode->getIp();
       //      string rack = ip2Rack[curip];
-      //      int cid = item.first;
+      //      int cid = node->getNodeId();
       //      cout << "cid: " << cid << ", ip: " << RedisUtil::ip2Str(curip) << endl;
       //      cid2Rack.insert(make_pair(cid, rack));
     }
@@ -408,9 +401,9 @@ void ECDAG::optimize2(int opt,
   if (opt == 2)
   {
     unordered_map<int, string> cid2Rack;
-    for (auto item : _ecNodeMap)
+    for (auto node : _ecNodes)
     {
-      int cid = item.first;
+      int cid = node->getNodeId();
       unsigned int curip = cid2ip[cid];
       string rack = ip2Rack[curip];
       cid2Rack.insert(make_pair(cid, rack));
@@ -433,9 +426,9 @@ void ECDAG::optimize2(int opt,
   else if (opt == 3)
   { // add support for optimization 3
     unordered_map<int, string> cid2Rack;
-    for (auto item : _ecNodeMap)
+    for (auto node : _ecNodes)
     {
-      int cid = item.first;
+      int cid = node->getNodeId();
       unsigned int curip = cid2ip[cid];
       string rack = ip2Rack[curip];
       cid2Rack.insert(make_pair(cid, rack));
@@ -535,16 +528,16 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
       if (ECDAG_DEBUG_ENABLE)
         cout << "numoutput == 1, deploy pipelining optimization" << endl;
       int parent = curParents[0];
-      ECNode *parentnode = _ecNodeMap[parent];
+      ECNode *parentnode = getNode(parent);
       bool isProot = false;
-      if (find(_ecHeaders.begin(), _ecHeaders.end(), parent) != _ecHeaders.end())
+      if (isHeader(parent))
         isProot = true;
       string prack = n2Rack[parent];
 
       // clean ref for child
       for (auto curcid : curChilds)
       {
-        ECNode *curcnode = _ecNodeMap[curcid];
+        ECNode *curcnode = getNode(curcid);
         curcnode->cleanRefNumFor(curcid);
       }
 
@@ -606,9 +599,7 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
       if (!isProot)
       {
         // delete parent from root
-        vector<int>::iterator p = find(_ecHeaders.begin(), _ecHeaders.end(), parent);
-        if (p != _ecHeaders.end())
-          _ecHeaders.erase(p);
+        removeHeader(parent);
       }
     }
     else
@@ -647,7 +638,7 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
           // we will reconstruct this group, clean ref for all itemchilds
           for (int i = 0; i < itemchilds.size(); i++)
           {
-            ECNode *itemchildnode = _ecNodeMap[itemchilds[i]];
+            ECNode *itemchildnode = getNode(itemchilds[i]);
             itemchildnode->cleanRefNumFor(itemchilds[i]);
           }
           // we can create a new subcluster for this group of childs, add subparents
@@ -674,7 +665,7 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
           for (int i = 0; i < numoutput; i++)
           {
             int parent = curParents[i];
-            ECNode *parentnode = _ecNodeMap[parent];
+            ECNode *parentnode = getNode(parent);
             int tmpparent = subparents[i];
 
             vector<int> tmpcoef;
@@ -722,13 +713,13 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
           for (int i = 0; i < itemchilds.size(); i++)
           {
             globalChilds.push_back(itemchilds[i]);
-            ECNode *itemchildnode = _ecNodeMap[itemchilds[i]];
+            ECNode *itemchildnode = getNode(itemchilds[i]);
             itemchildnode->cleanRefNumFor(itemchilds[i]);
           }
           for (int i = 0; i < numoutput; i++)
           {
             int parent = curParents[i];
-            ECNode *parentnode = _ecNodeMap[parent];
+            ECNode *parentnode = getNode(parent);
             // find corresponding coefs to calculate parent
             for (int j = 0; j < itemchilds.size(); j++)
             {
@@ -761,24 +752,12 @@ void ECDAG::Opt2(unordered_map<int, string> n2Rack)
 
       // check whether global Childs are in roots
       for (auto c : globalChilds)
-      {
-        vector<int>::iterator inroot = find(_ecHeaders.begin(), _ecHeaders.end(), c);
-        if (inroot != _ecHeaders.end())
-          _ecHeaders.erase(inroot);
-      }
+        removeHeader(c);
     }
   }
   // delete cluster in deletelist
-  vector<Cluster *>::iterator it;
-  ;
   sort(deletelist.begin(), deletelist.end());
-  for (int i = deletelist.size() - 1; i >= 0; i--)
-  {
-    it = _clusterMap.begin();
-    int idx = deletelist[i];
-    it += idx;
-    _clusterMap.erase(it);
-  }
+  deleteClusters(deletelist);
 }
 
 void ECDAG::Opt3(unordered_map<int, string> n2Rack)
@@ -820,22 +799,22 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
       if (ECDAG_DEBUG_ENABLE)
         cout << "numoutput == 1, deploy hierarchical optimization" << endl;
       int parent = curParents[0];
-      ECNode *parentnode = _ecNodeMap[parent];
+      ECNode *parentnode = getNode(parent);
       bool isProot = false;
-      if (find(_ecHeaders.begin(), _ecHeaders.end(), parent) != _ecHeaders.end())
+      if (isHeader(parent))
         isProot = true;
       string prack = n2Rack[parent];
 
       // // clean ref for child
       // for (auto curcid : curChilds)
       // {
-      //   ECNode *curcnode = _ecNodeMap[curcid];
+      //   ECNode *curcnode = getNode(curcid);
       //   curcnode->cleanRefNumFor(curcid);
       // }
       // decrease ref for child
       for (auto curcid : curChilds)
       {
-        ECNode *curcnode = _ecNodeMap[curcid];
+        ECNode *curcnode = getNode(curcid);
         curcnode->decRefNumFor(curcid);
       }
       // cross-rack symbols and coefficients
@@ -916,9 +895,7 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
       if (!isProot)
       {
         // delete parent from root
-        vector<int>::iterator p = find(_ecHeaders.begin(), _ecHeaders.end(), parent);
-        if (p != _ecHeaders.end())
-          _ecHeaders.erase(p);
+        removeHeader(parent);
       }
     }
     else
@@ -956,7 +933,7 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
           // we will reconstruct this group, clean ref for all itemchilds
           for (int i = 0; i < itemchilds.size(); i++)
           {
-            ECNode *itemchildnode = _ecNodeMap[itemchilds[i]];
+            ECNode *itemchildnode = getNode(itemchilds[i]);
             itemchildnode->cleanRefNumFor(itemchilds[i]);
           }
           // we can create a new subcluster for this group of childs, add subparents
@@ -983,7 +960,7 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
           for (int i = 0; i < numoutput; i++)
           {
             int parent = curParents[i];
-            ECNode *parentnode = _ecNodeMap[parent];
+            ECNode *parentnode = getNode(parent);
             int tmpparent = subparents[i];
 
             vector<int> tmpcoef;
@@ -1031,13 +1008,13 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
           for (int i = 0; i < itemchilds.size(); i++)
           {
             globalChilds.push_back(itemchilds[i]);
-            ECNode *itemchildnode = _ecNodeMap[itemchilds[i]];
+            ECNode *itemchildnode = getNode(itemchilds[i]);
             itemchildnode->cleanRefNumFor(itemchilds[i]);
           }
           for (int i = 0; i < numoutput; i++)
           {
             int parent = curParents[i];
-            ECNode *parentnode = _ecNodeMap[parent];
+            ECNode *parentnode = getNode(parent);
             // find corresponding coefs to calculate parent
             for (int j = 0; j < itemchilds.size(); j++)
             {
@@ -1070,24 +1047,12 @@ void ECDAG::Opt3(unordered_map<int, string> n2Rack)
 
       // check whether global Childs are in roots
       for (auto c : globalChilds)
-      {
-        vector<int>::iterator inroot = find(_ecHeaders.begin(), _ecHeaders.end(), c);
-        if (inroot != _ecHeaders.end())
-          _ecHeaders.erase(inroot);
-      }
+        removeHeader(c);
     }
   }
   // delete cluster in deletelist
-  vector<Cluster *>::iterator it;
-  ;
   sort(deletelist.begin(), deletelist.end());
-  for (int i = deletelist.size() - 1; i >= 0; i--)
-  {
-    it = _clusterMap.begin();
-    int idx = deletelist[i];
-    it += idx;
-    _clusterMap.erase(it);
-  }
+  deleteClusters(deletelist);
 }
 
 unordered_map<int, AGCommand *> ECDAG::parseForOEC(unordered_map<int, unsigned int> cid2ip,
@@ -1097,10 +1062,11 @@ unordered_map<int, AGCommand *> ECDAG::parseForOEC(unordered_map<int, unsigned i
 {
 
   // adjust refnum for heads
-  for (int i = 0; i < _ecHeaders.size(); i++)
+  vector<int> headers = getHeaders();
+  for (int i = 0; i < headers.size(); i++)
   {
-    int nid = _ecHeaders[i];
-    _ecNodeMap[nid]->incRefNumFor(nid);
+    int nid = headers[i];
+    getNode(nid)->incRefNumFor(nid);
   }
 
   vector<AGCommand *> toret;
@@ -1225,6 +1191,95 @@ unordered_map<int, AGCommand *> ECDAG::parseForOEC(unordered_map<int, unsigned i
     }
   }
 
+  // a task that fetches the output of a task on the same agent takes it in
+  // memory: its prevloc becomes 0, and the producer hands over as many of its
+  // refs locally. The extra refs of the headers are for persist or the client,
+  // which always fetch through the data transport.
+  unordered_map<int, int> producers;
+  for (auto item : agCmds)
+  {
+    for (auto ref : item.second->getCacheRefs())
+      producers[ref.first] = item.first;
+  }
+  unordered_map<int, unordered_map<int, int>> localRefs;
+  for (auto item : agCmds)
+  {
+    AGCommand *cmd = item.second;
+    if (cmd->getType() != 3 && cmd->getType() != 7)
+      continue;
+    unsigned int ip = cmd->getSendIp();
+    vector<int> prevCids = cmd->getPrevCids();
+    vector<unsigned int> prevLocs = cmd->getPrevLocs();
+    bool local = false;
+    for (int i = 0; i < prevCids.size(); i++)
+    {
+      int childid = prevCids[i];
+      if (prevLocs[i] != ip || producers.find(childid) == producers.end())
+        continue;
+      AGCommand *childCmd = agCmds[producers[childid]];
+      if (childCmd->getSendIp() != ip || localRefs[producers[childid]][childid] >= childCmd->getCacheRefs()[childid])
+        continue;
+      if (ECDAG_DEBUG_ENABLE)
+        cout << "ECDAG::parseForOEC.local " << childid << " to " << item.first << endl;
+      localRefs[producers[childid]][childid]++;
+      prevLocs[i] = 0;
+      local = true;
+    }
+    if (local)
+      cmd->setPrevLocs(prevLocs);
+  }
+  for (auto item : localRefs)
+    agCmds[item.first]->setLocalRefs(item.second);
+
+  // the remaining commands for the same agent are packed into batches, so that
+  // the agent takes the tasks of a plan at once and runs them together
+  unordered_map<unsigned int, vector<int>> ip2cids;
+  for (auto cidx : sortedList)
+  {
+    if (agCmds.find(cidx) == agCmds.end() || !agCmds[cidx]->getShouldSend())
+      continue;
+    ip2cids[agCmds[cidx]->getSendIp()].push_back(cidx);
+  }
+  for (auto item : ip2cids)
+  {
+    unsigned int ip = item.first;
+    vector<int> batch;
+    // type, stripename and the number of commands
+    int headlen = 12 + stripename.length();
+    int batchlen = headlen;
+    for (int i = 0; i <= item.second.size(); i++)
+    {
+      AGCommand *cmd = i < item.second.size() ? agCmds[item.second[i]] : NULL;
+      if (cmd && batchlen + 4 + cmd->getCmdLen() <= MAX_COMMAND_LEN)
+      {
+        batch.push_back(item.second[i]);
+        batchlen += 4 + cmd->getCmdLen();
+        continue;
+      }
+      if (batch.size() > 1)
+      {
+        vector<AGCommand *> cmds;
+        for (auto cid : batch)
+        {
+          cmds.push_back(agCmds[cid]);
+          agCmds.erase(cid);
+        }
+        if (ECDAG_DEBUG_ENABLE)
+          cout << "ECDAG::parseForOEC.coalesce " << cmds.size() << " commands for " << RedisUtil::ip2Str(ip) << endl;
+        AGCommand *batchCmd = new AGCommand();
+        batchCmd->buildType13(13, ip, stripename, cmds);
+        agCmds.insert(make_pair(batch[0], batchCmd));
+      }
+      batch.clear();
+      batchlen = headlen;
+      if (cmd)
+      {
+        batch.push_back(item.second[i]);
+        batchlen += 4 + cmd->getCmdLen();
+      }
+    }
+  }
+
   for (auto item : agCmds)
     item.second->dump();
 
@@ -1238,13 +1293,14 @@ vector<AGCommand *> ECDAG::persist(unordered_map<int, unsigned int> cid2ip,
 {
   vector<AGCommand *> toret;
   // sort headers
-  sort(_ecHeaders.begin(), _ecHeaders.end());
-  int numblks = _ecHeaders.size() / w;
+  vector<int> headers = getHeaders();
+  sort(headers.begin(), headers.end());
+  int numblks = headers.size() / w;
   if (ECDAG_DEBUG_ENABLE)
     cout << "ECDAG:: persist. numblks: " << numblks << endl;
   for (int i = 0; i < numblks; i++)
   {
-    int cid = _ecHeaders[i * w];
+    int cid = headers[i * w];
     int sid = cid / w;
     string objname = objlist[sid].first;
     unsigned int ip = objlist[sid].second;
@@ -1268,9 +1324,9 @@ vector<AGCommand *> ECDAG::persist(unordered_map<int, unsigned int> cid2ip,
 
 void ECDAG::dump()
 {
-  for (auto id : _ecHeaders)
+  for (auto id : getHeaders())
   {
-    _ecNodeMap[id]->dump(-1);
+    getNode(id)->dump(-1);
     cout << endl;
   }
   for (auto cluster : _clusterMap)
@@ -13,16 +13,38 @@ using namespace std;
 #define BINDSTART 10200
 #define OPTSTART 10300
 
+/**
+ * Nodes of an ECDAG are numbered densely in the order they are created, and
+ * allocated from an arena of the dag, which frees them all at once.
+ *
+ * toposort builds the parents of each node as arrays (CSR) over the dense
+ * numbers and visits each edge once. A root that stops being one is only
+ * unflagged, so that Join and the Opt passes drop roots in constant time,
+ * and getHeaders leaves out the unflagged ones.
+ */
 class ECDAG
 {
 private:
-  unordered_map<int, ECNode *> _ecNodeMap;
+  deque<ECNode> _ecNodeArena;
+  // dense number -> node, and cid -> dense number
+  vector<ECNode *> _ecNodes;
+  unordered_map<int, int> _ecNodeIdx;
+  // roots in the order they are added, and whether a dense number is a root
   vector<int> _ecHeaders;
+  vector<bool> _isHeader;
   int _bindId = BINDSTART;
   vector<Cluster *> _clusterMap;
   int _optId = OPTSTART;
 
   int findCluster(vector<int> childs);
+  // NULL if cidx is not in the dag
+  ECNode *findNode(int cidx);
+  ECNode *addNode(int cidx);
+  bool isHeader(int cidx);
+  void addHeader(int cidx);
+  void removeHeader(int cidx);
+  // drop the clusters at the sorted indices in deletelist
+  void deleteClusters(vector<int> deletelist);
 
 public:
   ECDAG();
@@ -32,6 +54,10 @@ public:
   int BindX(vector<int> idxs);
   void BindY(int pidx, int cidx);
 
+  // a copy of the nodes and headers, before parseForOEC assigns tasks to them;
+  // clusters are not copied, so the copy is not reconstructed or optimized again
+  ECDAG *clone();
+
   // topological sorting
   vector<int> toposort();
   ECNode *getNode(int cidx);
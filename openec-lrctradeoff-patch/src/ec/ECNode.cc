@@ -151,6 +151,15 @@ void ECNode::setConstraint(bool cons, int id)
     _consId = id;
 }
 
+void ECNode::copyFrom(ECNode *node, vector<ECNode *> childs)
+{
+  _childNodes = childs;
+  _coefMap = node->_coefMap;
+  _refNumFor = node->_refNumFor;
+  _hasConstraint = node->_hasConstraint;
+  _consId = node->_consId;
+}
+
 void ECNode::dump(int parent)
 {
   if (parent == -1)
@@ -54,6 +54,8 @@ class ECNode {
     unordered_map<int, int> getRefMap();
 
     void setConstraint(bool cons, int id);
+    // take the children, coefs, refs and constraint of node, with childs standing for its children
+    void copyFrom(ECNode* node, vector<ECNode*> childs);
 
     unsigned int getIp();
 
@@ -14,42 +14,87 @@ ECPolicy::ECPolicy(string id, string classname, int n, int k, int w, int opt, ve
 }
 
 ECBase *ECPolicy::createECClass()
+{
+  return createECClass(_param);
+}
+
+ECBase *ECPolicy::createECClass(bool maintenance)
+{
+  vector<string> param = _param;
+  int approachIdx = getApproachIdx();
+  if (approachIdx >= 0)
+    param[approachIdx] = maintenance ? "1" : "0";
+  return createECClass(param);
+}
+
+ECBase *ECPolicy::createECClass(vector<string> param)
 {
   ECBase *toret;
   if (_classname == "RSCONV")
   {
     //    toret = new RSCONV(_n, _k, _w, _locality, _opt, _param);
-    toret = new RSCONV(_n, _k, _w, _opt, _param);
+    toret = new RSCONV(_n, _k, _w, _opt, param);
   }
   else if (_classname == "AzureLRCFlat")
   {
     //    toret = new AzureLRCFlat(_n, _k, _w, _locality, _opt, _param);
-    toret = new AzureLRCFlat(_n, _k, _w, _opt, _param);
+    toret = new AzureLRCFlat(_n, _k, _w, _opt, param);
   }
   else if (_classname == "AzureLRCTradeoff")
   {
     //    toret = new AzureLRCTradeoff(_n, _k, _w, _locality, _opt, _param);
-    toret = new AzureLRCTradeoff(_n, _k, _w, _opt, _param);
+    toret = new AzureLRCTradeoff(_n, _k, _w, _opt, param);
   }
   else if (_classname == "AzureLRCOptR1022")
   {
     //    toret = new AzureLRCOptR1022(_n, _k, _w, _locality, _opt, _param);
-    toret = new AzureLRCOptR1022(_n, _k, _w, _opt, _param);
+    toret = new AzureLRCOptR1022(_n, _k, _w, _opt, param);
   }
   else if (_classname == "AzureLRCOptM1022")
   {
     //    toret = new AzureLRCOptM1022(_n, _k, _w, _locality, _opt, _param);
-    toret = new AzureLRCOptM1022(_n, _k, _w, _opt, _param);
+    toret = new AzureLRCOptM1022(_n, _k, _w, _opt, param);
   }
   else
   {
     cout << "unrecognized code, use default RSCONV" << endl;
     //    toret = new RSCONV(_n, _k, _w, _locality, _opt, _param);
-    toret = new RSCONV(_n, _k, _w, _opt, _param);
+    toret = new RSCONV(_n, _k, _w, _opt, param);
   }
   return toret;
 }
 
+int ECPolicy::getApproachIdx()
+{
+  int approachIdx = -1;
+  if (_classname == "AzureLRCTradeoff")
+    approachIdx = 3;
+  else if (_classname == "AzureLRCOptR1022" || _classname == "AzureLRCOptM1022")
+    approachIdx = 2;
+  if (approachIdx >= _param.size())
+    approachIdx = -1;
+  return approachIdx;
+}
+
+bool ECPolicy::isMaintenance()
+{
+  int approachIdx = getApproachIdx();
+  return approachIdx >= 0 && atoi(_param[approachIdx].c_str()) == 1;
+}
+
+bool ECPolicy::sameCode(ECPolicy *other)
+{
+  if (_n != other->_n || _k != other->_k || _w != other->_w)
+    return false;
+  // these codes build the same matrix from l and g, and differ only in placement and decoding
+  vector<string> azureLRC = {"AzureLRCFlat", "AzureLRCTradeoff", "AzureLRCOptR1022"};
+  bool lrc = find(azureLRC.begin(), azureLRC.end(), _classname) != azureLRC.end();
+  bool otherLrc = find(azureLRC.begin(), azureLRC.end(), other->_classname) != azureLRC.end();
+  if (lrc && otherLrc)
+    return _param.size() >= 2 && other->_param.size() >= 2 && _param[0] == other->_param[0] && _param[1] == other->_param[1];
+  return _classname == other->_classname && _param == other->_param;
+}
+
 string ECPolicy::getPolicyId()
 {
   return _id;
@@ -25,10 +25,20 @@ private:
 
   vector<string> _param;
 
+  ECBase *createECClass(vector<string> param);
+
 public:
   //    ECPolicy(string id, string classname, int n, int k, int w, bool locality, int opt, vector<string> param);
   ECPolicy(string id, string classname, int n, int k, int w, int opt, vector<string> param);
   ECBase *createECClass();
+  // with the approach param set, so that a pool is repaired with regular or maintenance decoding at runtime
+  ECBase *createECClass(bool maintenance);
+  // position of the approach param (0: repair; 1: maintenance) of codes with maintenance decoding, -1 for others
+  int getApproachIdx();
+  // the approach param is 1
+  bool isMaintenance();
+  // other encodes stripes the same way, so that a stripe can be placed and decoded by either policy
+  bool sameCode(ECPolicy *other);
   string getPolicyId();
   int getN();
   int getK();
@@ -7,42 +7,52 @@ OfflineECPool::OfflineECPool(string ecpoolid, ECPolicy *ecpolicy, int basesize)
   _basesize = basesize;
 }
 
+uint32_t OfflineECPool::internStripe(const string &stripename)
+{
+  uint32_t sid = _stripeNames.intern(stripename);
+  if (sid == _stripe2objs.size())
+  {
+    _stripe2objs.push_back(vector<uint32_t>());
+    _logged.push_back(false);
+  }
+  return sid;
+}
+
 void OfflineECPool::addObj(string objname, string stripename)
 {
-  _objs.insert(make_pair(objname, false));
-  if (find(_stripes.begin(), _stripes.end(), stripename) == _stripes.end())
-    _stripes.push_back(stripename);
-  unordered_map<string, vector<string>>::iterator it1 = _stripe2objs.find(stripename);
-  if (it1 != _stripe2objs.end())
-    _stripe2objs[stripename].push_back(objname);
-  else
+  uint32_t sid = internStripe(stripename);
+  uint32_t oid = _objNames.intern(objname);
+  if (oid == _finalized.size())
   {
-    vector<string> curlist;
-    curlist.push_back(objname);
-    _stripe2objs.insert(make_pair(stripename, curlist));
+    _finalized.push_back(false);
+    _obj2stripe.push_back(sid);
   }
-  _obj2stripe.insert(make_pair(objname, stripename));
+  _stripe2objs[sid].push_back(oid);
 }
 
 void OfflineECPool::finalizeObj(string objname)
 {
-  assert(_objs.find(objname) != _objs.end());
-  _objs[objname] = true;
+  uint32_t oid = _objNames.find(objname);
+  assert(oid != NAMETABLE_NONE);
+  _finalized[oid] = true;
 }
 
 bool OfflineECPool::isCandidateForEC(string stripename)
 {
   int eck = _ecpolicy->getK();
-  vector<string> objlist = _stripe2objs[stripename];
+  uint32_t sid = _stripeNames.find(stripename);
+  if (sid == NAMETABLE_NONE)
+    return false;
+  vector<uint32_t> &objlist = _stripe2objs[sid];
   if (objlist.size() < eck)
     return false;
   if (objlist.size() == eck)
   {
     // this might be a candidate, check finalize for each obj
     bool toret = true;
-    for (auto obj : objlist)
+    for (auto oid : objlist)
     {
-      if (!_objs[obj])
+      if (!_finalized[oid])
       {
         toret = false;
         break;
@@ -69,12 +79,12 @@ string OfflineECPool::getStripeForObj(string objname)
   //    cout << "OfflineECPool::getStripeForObj return " << _obj2stripe[objname] << endl;
   //    return _obj2stripe[objname];
   //  }
-  if (_objs.find(objname) != _objs.end())
+  uint32_t oid = _objNames.find(objname);
+  if (oid != NAMETABLE_NONE)
   {
-    return _obj2stripe[objname];
+    return _stripeNames.name(_obj2stripe[oid]);
   }
-  vector<string> objlist;
-  if (_stripes.size() == 0)
+  if (_stripeNames.size() == 0)
   {
     stripename = "oecstripe-" + getTimeStamp();
   }
@@ -82,7 +92,7 @@ string OfflineECPool::getStripeForObj(string objname)
   {
     // Temporarily uncomment this
 
-    stripename = _stripes.back();
+    stripename = _stripeNames.name(_stripeNames.size() - 1);
     // if (_stripe2objs[stripename].size() >= _ecpolicy->getK()) {
     //   stripename = "oecstripe-"+getTimeStamp();
     // }
@@ -93,9 +103,12 @@ string OfflineECPool::getStripeForObj(string objname)
 vector<string> OfflineECPool::getStripeObjList(string stripename)
 {
   vector<string> toret;
-  unordered_map<string, vector<string>>::iterator it = _stripe2objs.find(stripename);
-  if (it != _stripe2objs.end())
-    toret = _stripe2objs[stripename];
+  uint32_t sid = _stripeNames.find(stripename);
+  if (sid != NAMETABLE_NONE)
+  {
+    for (auto oid : _stripe2objs[sid])
+      toret.push_back(_objNames.name(oid));
+  }
   return toret;
 }
 
@@ -121,12 +134,22 @@ void OfflineECPool::unlock()
   _lockECPool.unlock();
 }
 
+void OfflineECPool::lockShared()
+{
+  _lockECPool.lock_shared();
+}
+
+void OfflineECPool::unlockShared()
+{
+  _lockECPool.unlock_shared();
+}
+
 string OfflineECPool::stripe2String(string stripename)
 {
   string toret = "";
   toret += _ecpoolid + ";";
   toret += stripename + ";";
-  vector<string> objlist = _stripe2objs[stripename];
+  vector<string> objlist = getStripeObjList(stripename);
   for (int i = 0; i < objlist.size(); i++)
   {
     toret += objlist[i] + ";";
@@ -135,6 +158,24 @@ string OfflineECPool::stripe2String(string stripename)
   return toret;
 }
 
+void OfflineECPool::setLogged(string stripename)
+{
+  uint32_t sid = _stripeNames.find(stripename);
+  if (sid != NAMETABLE_NONE)
+    _logged[sid] = true;
+}
+
+vector<string> OfflineECPool::getLoggedStripes()
+{
+  vector<string> toret;
+  for (uint32_t sid = 0; sid < _logged.size(); sid++)
+  {
+    if (_logged[sid])
+      toret.push_back(_stripeNames.name(sid));
+  }
+  return toret;
+}
+
 void OfflineECPool::constructPool(vector<string> items)
 {
   // we skip items[0], which is poolid
@@ -142,18 +183,23 @@ void OfflineECPool::constructPool(vector<string> items)
   _lockECPool.lock();
   string stripename = items[1];
   cout << stripename << endl;
-  _stripes.push_back(stripename);
+  uint32_t sid = internStripe(stripename);
+  // the record of a stripe lists all its objects, the last one of a stripe wins
+  _stripe2objs[sid].clear();
+  _logged[sid] = true;
   int objnum = (items.size() - 2);
-  vector<string> stripelist;
   for (int i = 0; i < objnum; i++)
   {
     int idx = 2 + i;
     string objname = items[idx];
-    _objs.insert(make_pair(objname, true));
-    _obj2stripe.insert(make_pair(objname, stripename));
-    stripelist.push_back(objname);
+    uint32_t oid = _objNames.intern(objname);
+    if (oid == _finalized.size())
+    {
+      _finalized.push_back(true);
+      _obj2stripe.push_back(sid);
+    }
+    _stripe2objs[sid].push_back(oid);
     cout << objname << endl;
   }
-  _stripe2objs.insert(make_pair(stripename, stripelist));
   _lockECPool.unlock();
 }
@@ -0,0 +1,71 @@
+#ifndef _OFFLINEECPOOL_HH_
+#define _OFFLINEECPOOL_HH_
+
+#include "ECPolicy.hh"
+
+#include "../common/NameTable.hh"
+#include "../inc/include.hh"
+
+#include <shared_mutex>
+
+using namespace std;
+
+/**
+ * Objects written into an offline pool, grouped into stripes until they
+ * are erasure-coded.
+ *
+ * Object and stripe names are interned in two NameTables, and what the
+ * pool keeps of them is in flat vectors by id. Stripes are numbered in the
+ * order they are created, so the last stripe is the one being filled.
+ * The pool is synchronized by its owner: lock around adding and finalizing
+ * objects, lockShared around reading stripes, so that the degraded reads and
+ * repairs of a pool do not wait for each other.
+ */
+class OfflineECPool
+{
+private:
+  string _ecpoolid;
+  ECPolicy *_ecpolicy;
+  int _basesize;
+
+  shared_timed_mutex _lockECPool;
+  NameTable _objNames;
+  NameTable _stripeNames;
+  // by object id
+  vector<bool> _finalized;
+  vector<uint32_t> _obj2stripe;
+  // object ids of each stripe, by stripe id
+  vector<vector<uint32_t>> _stripe2objs;
+  // whether the stripe is in the metadata log, by stripe id
+  vector<bool> _logged;
+
+  // the id of stripename, with a new stripe for a new name
+  uint32_t internStripe(const string &stripename);
+
+public:
+  OfflineECPool(string ecpoolid, ECPolicy *ecpolicy, int basesize);
+
+  void addObj(string objname, string stripename);
+  void finalizeObj(string objname);
+  bool isCandidateForEC(string stripename);
+  int getBasesize();
+  // the stripe of objname, or the stripe that a new object goes to
+  string getStripeForObj(string objname);
+  vector<string> getStripeObjList(string stripename);
+  ECPolicy *getEcpolicy();
+  string getTimeStamp();
+  void lock();
+  void unlock();
+  void lockShared();
+  void unlockShared();
+  // |ecpoolid;stripename;objs;|, the record of the stripe in the metadata log
+  string stripe2String(string stripename);
+  // mark stripename as in the metadata log, under lock
+  void setLogged(string stripename);
+  // the stripes in the metadata log, in the order they were created
+  vector<string> getLoggedStripes();
+  // add a stripe from stripe2String at startup
+  void constructPool(vector<string> items);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "XorKernel.hh"
+
+#include <immintrin.h>
+
+static void xorScalar(char *dst, char **src, int nsrc, int off, int len, bool update)
+{
+  for (; off + 8 <= len; off += 8)
+  {
+    uint64_t acc;
+    if (update)
+      memcpy(&acc, dst + off, 8);
+    else
+      acc = 0;
+    for (int i = 0; i < nsrc; i++)
+    {
+      uint64_t cur;
+      memcpy(&cur, src[i] + off, 8);
+      acc ^= cur;
+    }
+    memcpy(dst + off, &acc, 8);
+  }
+  for (; off < len; off++)
+  {
+    char acc = update ? dst[off] : 0;
+    for (int i = 0; i < nsrc; i++)
+      acc ^= src[i][off];
+    dst[off] = acc;
+  }
+}
+
+__attribute__((target("avx2"))) static void xorAVX2(char *dst, char **src, int nsrc, int off, int len, bool update)
+{
+  // 4 x 32B per round to keep the load ports busy
+  for (; off + 128 <= len; off += 128)
+  {
+    __m256i acc0, acc1, acc2, acc3;
+    if (update)
+    {
+      acc0 = _mm256_loadu_si256((__m256i *)(dst + off));
+      acc1 = _mm256_loadu_si256((__m256i *)(dst + off + 32));
+      acc2 = _mm256_loadu_si256((__m256i *)(dst + off + 64));
+      acc3 = _mm256_loadu_si256((__m256i *)(dst + off + 96));
+    }
+    else
+    {
+      acc0 = acc1 = acc2 = acc3 = _mm256_setzero_si256();
+    }
+    for (int i = 0; i < nsrc; i++)
+    {
+      char *cur = src[i] + off;
+      acc0 = _mm256_xor_si256(acc0, _mm256_loadu_si256((__m256i *)cur));
+      acc1 = _mm256_xor_si256(acc1, _mm256_loadu_si256((__m256i *)(cur + 32)));
+      acc2 = _mm256_xor_si256(acc2, _mm256_loadu_si256((__m256i *)(cur + 64)));
+      acc3 = _mm256_xor_si256(acc3, _mm256_loadu_si256((__m256i *)(cur + 96)));
+    }
+    _mm256_storeu_si256((__m256i *)(dst + off), acc0);
+    _mm256_storeu_si256((__m256i *)(dst + off + 32), acc1);
+    _mm256_storeu_si256((__m256i *)(dst + off + 64), acc2);
+    _mm256_storeu_si256((__m256i *)(dst + off + 96), acc3);
+  }
+  if (off < len)
+    xorScalar(dst, src, nsrc, off, len, update);
+}
+
+__attribute__((target("avx512f"))) static void xorAVX512(char *dst, char **src, int nsrc, int off, int len, bool update)
+{
+  for (; off + 256 <= len; off += 256)
+  {
+    __m512i acc0, acc1, acc2, acc3;
+    if (update)
+    {
+      acc0 = _mm512_loadu_si512((void *)(dst + off));
+      acc1 = _mm512_loadu_si512((void *)(dst + off + 64));
+      acc2 = _mm512_loadu_si512((void *)(dst + off + 128));
+      acc3 = _mm512_loadu_si512((void *)(dst + off + 192));
+    }
+    else
+    {
+      acc0 = acc1 = acc2 = acc3 = _mm512_setzero_si512();
+    }
+    for (int i = 0; i < nsrc; i++)
+    {
+      char *cur = src[i] + off;
+      acc0 = _mm512_xor_si512(acc0, _mm512_loadu_si512((void *)cur));
+      acc1 = _mm512_xor_si512(acc1, _mm512_loadu_si512((void *)(cur + 64)));
+      acc2 = _mm512_xor_si512(acc2, _mm512_loadu_si512((void *)(cur + 128)));
+      acc3 = _mm512_xor_si512(acc3, _mm512_loadu_si512((void *)(cur + 192)));
+    }
+    _mm512_storeu_si512((void *)(dst + off), acc0);
+    _mm512_storeu_si512((void *)(dst + off + 64), acc1);
+    _mm512_storeu_si512((void *)(dst + off + 128), acc2);
+    _mm512_storeu_si512((void *)(dst + off + 192), acc3);
+  }
+  if (off < len)
+    xorAVX2(dst, src, nsrc, off, len, update);
+}
+
+XorKernel::XorFunc XorKernel::_xorFunc = xorScalar;
+string XorKernel::_impl = "scalar";
+once_flag XorKernel::_initFlag;
+
+void XorKernel::init()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    _xorFunc = xorAVX512;
+    _impl = "avx512";
+  }
+  else if (__builtin_cpu_supports("avx2"))
+  {
+    _xorFunc = xorAVX2;
+    _impl = "avx2";
+  }
+  else
+  {
+    _xorFunc = xorScalar;
+    _impl = "scalar";
+  }
+}
+
+void XorKernel::xorData(char *dst, char **src, int nsrc, int len)
+{
+  call_once(_initFlag, init);
+  if (nsrc == 0)
+    memset(dst, 0, len);
+  else if (nsrc == 1)
+  {
+    // a single source coded in place is already the result
+    if (dst != src[0])
+      memmove(dst, src[0], len);
+  }
+  else
+    _xorFunc(dst, src, nsrc, 0, len, false);
+}
+
+void XorKernel::xorUpdate(char *dst, char **src, int nsrc, int len)
+{
+  call_once(_initFlag, init);
+  if (nsrc > 0)
+    _xorFunc(dst, src, nsrc, 0, len, true);
+}
+
+string XorKernel::getImpl()
+{
+  call_once(_initFlag, init);
+  return _impl;
+}
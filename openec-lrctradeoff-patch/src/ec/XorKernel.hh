@@ -0,0 +1,34 @@
+#ifndef _XORKERNEL_HH_
+#define _XORKERNEL_HH_
+
+#include "../inc/include.hh"
+
+using namespace std;
+
+/**
+ * Multi-source XOR for coding rows whose coefficients are all 0/1, e.g., the
+ * local parity of Azure-LRC and the virtual symbols joined in local repair.
+ *
+ * The implementation (AVX-512, AVX2 or scalar) is picked once at runtime
+ * according to the features of the running CPU.
+ */
+class XorKernel
+{
+private:
+  typedef void (*XorFunc)(char *, char **, int, int, int, bool);
+
+  static XorFunc _xorFunc;
+  static string _impl;
+  static once_flag _initFlag;
+
+  static void init();
+
+public:
+  // dst = src[0] ^ src[1] ^ ... ^ src[nsrc-1], for len bytes
+  static void xorData(char *dst, char **src, int nsrc, int len);
+  // dst ^= src[0] ^ ... ^ src[nsrc-1], for len bytes
+  static void xorUpdate(char *dst, char **src, int nsrc, int len);
+  static string getImpl();
+};
+
+#endif
@@ -15,6 +15,8 @@ AGCommand::~AGCommand()
     _agCmd = 0;
   }
   _cmLen = 0;
+  for (auto cmd : _subCmds)
+    delete cmd;
 }
 
 AGCommand::AGCommand(char *reqStr)
@@ -54,6 +56,9 @@ AGCommand::AGCommand(char *reqStr)
   case 12:
     resolveType12ForShortening();
     break;
+  case 13:
+    resolveType13();
+    break;
 
   default:
     break;
@@ -136,6 +141,11 @@ int AGCommand::getFilesizeMB()
   return _filesizeMB;
 }
 
+string AGCommand::getShmName()
+{
+  return _shmName;
+}
+
 bool AGCommand::getShouldSend()
 {
   return _shouldSend;
@@ -226,6 +236,71 @@ int AGCommand::getBasesizeMB()
   return _basesizeMB;
 }
 
+unordered_map<int, int> AGCommand::getLocalRefs()
+{
+  return _localRefs;
+}
+
+vector<AGCommand *> AGCommand::getSubCmds()
+{
+  return _subCmds;
+}
+
+void AGCommand::writeLocalRefs()
+{
+  writeInt(_localRefs.size());
+  for (auto item : _localRefs)
+  {
+    writeInt(item.first);
+    writeInt(item.second);
+  }
+}
+
+void AGCommand::readLocalRefs()
+{
+  int refnum = readInt();
+  for (int i = 0; i < refnum; i++)
+  {
+    int cid = readInt();
+    int r = readInt();
+    _localRefs.insert(make_pair(cid, r));
+  }
+}
+
+void AGCommand::rebuild()
+{
+  _cmLen = 0;
+  switch (_type)
+  {
+  case 2:
+    buildType2(_type, _sendIp, _stripeName, _ecw, _num, _readObjName, _readCidList, _cacheRefs);
+    break;
+  case 3:
+    buildType3(_type, _sendIp, _stripeName, _ecw, _num, _nprevs, _prevCids, _prevLocs, _coefs, _cacheRefs);
+    break;
+  case 7:
+    buildType7(_type, _sendIp, _stripeName, _ecw, _num, _readObjName, _readCidList, _nprevs, _prevCids, _prevLocs, _coefs, _cacheRefs);
+    break;
+  case 12:
+    buildType12ForShortening(_type, _sendIp, _stripeName, _ecn, _ecw, _num, _readObjName, _readCidList, _cacheRefs);
+    break;
+  default:
+    break;
+  }
+}
+
+void AGCommand::setLocalRefs(unordered_map<int, int> localRefs)
+{
+  _localRefs = localRefs;
+  rebuild();
+}
+
+void AGCommand::setPrevLocs(vector<unsigned int> prevLocs)
+{
+  _prevLocs = prevLocs;
+  rebuild();
+}
+
 void AGCommand::setRkey(string key)
 {
   _rKey = key;
@@ -243,7 +318,8 @@ void AGCommand::buildType0(int type,
                            string filename,
                            string ecid,
                            string mode,
-                           int filesizeMB)
+                           int filesizeMB,
+                           string shmname)
 {
   // set up corresponding parameters
   _type = type;
@@ -251,6 +327,7 @@ void AGCommand::buildType0(int type,
   _ecid = ecid;
   _mode = mode;
   _filesizeMB = filesizeMB;
+  _shmName = shmname;
 
   // 1. type
   writeInt(_type);
@@ -262,6 +339,8 @@ void AGCommand::buildType0(int type,
   writeString(_mode);
   // 5. filesizeMB
   writeInt(_filesizeMB);
+  // 6. shmname
+  writeString(_shmName);
 }
 
 void AGCommand::resolveType0()
@@ -274,21 +353,27 @@ void AGCommand::resolveType0()
   _mode = readString();
   // 5. filesizeMB
   _filesizeMB = readInt();
+  // 6. shmname
+  _shmName = readString();
 }
 
 void AGCommand::buildType1(int type,
-                           string filename)
+                           string filename,
+                           string shmname)
 {
   _type = type;
   _filename = filename;
+  _shmName = shmname;
 
   writeInt(_type);
   writeString(_filename);
+  writeString(_shmName);
 }
 
 void AGCommand::resolveType1()
 {
   _filename = readString();
+  _shmName = readString();
 }
 
 void AGCommand::buildType2(int type,
@@ -325,6 +410,7 @@ void AGCommand::buildType2(int type,
     writeInt(id);
     writeInt(ref[id]);
   }
+  writeLocalRefs();
 }
 
 void AGCommand::resolveType2()
@@ -341,6 +427,7 @@ void AGCommand::resolveType2()
     _readCidList.push_back(id);
     _cacheRefs.insert(make_pair(id, ref));
   }
+  readLocalRefs();
 }
 
 void AGCommand::buildType3(int type,
@@ -391,6 +478,7 @@ void AGCommand::buildType3(int type,
       writeInt(coef[i]);
     writeInt(r);
   }
+  writeLocalRefs();
 }
 
 void AGCommand::resolveType3()
@@ -415,6 +503,7 @@ void AGCommand::resolveType3()
     _coefs.insert(make_pair(target, coef));
     _cacheRefs.insert(make_pair(target, r));
   }
+  readLocalRefs();
 }
 
 void AGCommand::buildType5(int type,
@@ -520,6 +609,7 @@ void AGCommand::buildType7(int type,
     writeInt(item.first);
     writeInt(item.second);
   }
+  writeLocalRefs();
 }
 
 void AGCommand::resolveType7()
@@ -553,6 +643,7 @@ void AGCommand::resolveType7()
     int r = readInt();
     _cacheRefs.insert(make_pair(cid, r));
   }
+  readLocalRefs();
 }
 
 void AGCommand::buildType10(int type,
@@ -639,6 +730,7 @@ void AGCommand::buildType12ForShortening(int type,
     writeInt(id);
     writeInt(ref[id]);
   }
+  writeLocalRefs();
 }
 
 void AGCommand::resolveType12ForShortening()
@@ -656,17 +748,52 @@ void AGCommand::resolveType12ForShortening()
     _readCidList.push_back(id);
     _cacheRefs.insert(make_pair(id, ref));
   }
+  readLocalRefs();
+}
+
+void AGCommand::buildType13(int type,
+                            unsigned int sendIp,
+                            string stripename,
+                            vector<AGCommand *> cmds)
+{
+  _shouldSend = true;
+  _type = type;
+  _sendIp = sendIp;
+  _stripeName = stripename;
+  _subCmds = cmds;
+
+  writeInt(_type);
+  writeString(_stripeName);
+  writeInt(_subCmds.size());
+  for (auto cmd : _subCmds)
+  {
+    writeInt(cmd->getCmdLen());
+    memcpy(_agCmd + _cmLen, cmd->getCmd(), cmd->getCmdLen());
+    _cmLen += cmd->getCmdLen();
+  }
+}
+
+void AGCommand::resolveType13()
+{
+  _stripeName = readString();
+  int cmdnum = readInt();
+  for (int i = 0; i < cmdnum; i++)
+  {
+    int cmdlen = readInt();
+    _subCmds.push_back(new AGCommand(_agCmd + _cmLen));
+    _cmLen += cmdlen;
+  }
 }
 
 void AGCommand::dump()
 {
   if (_type == 0)
   {
-    cout << "AGCommand::clientWrite: " << _filename << ", ecid: " << _ecid << ", mode: " << _mode << ", size: " << _filesizeMB << endl;
+    cout << "AGCommand::clientWrite: " << _filename << ", ecid: " << _ecid << ", mode: " << _mode << ", size: " << _filesizeMB << ", shm: " << _shmName << endl;
   }
   else if (_type == 1)
   {
-    cout << "AGCommand::clientRead: " << _filename << endl;
+    cout << "AGCommand::clientRead: " << _filename << ", shm: " << _shmName << endl;
   }
   else if (_type == 2)
   {
@@ -694,7 +821,7 @@ void AGCommand::dump()
       cout << "    Compute: " << target << ", coef: ";
       for (int i = 0; i < coef.size(); i++)
         cout << coef[i] << " ";
-      cout << ", cache: " << _cacheRefs[target] << endl;
+      cout << ", cache: " << _cacheRefs[target] << ", local: " << _localRefs[target] << endl;
     }
   }
   else if (_type == 5)
@@ -743,4 +870,13 @@ void AGCommand::dump()
     }
     cout << endl;
   }
+  else if (_type == 13)
+  {
+    cout << "AGCommand::Batch, ip: " << RedisUtil::ip2Str(_sendIp) << ", stripe: " << _stripeName << ", cmds: " << _subCmds.size() << endl;
+    for (auto cmd : _subCmds)
+    {
+      cout << "  ";
+      cmd->dump();
+    }
+  }
 }
@@ -9,8 +9,8 @@ using namespace std;
 /*
  * OECAgent Command format
  * agent_request: type
- *    type=0 (client write data)| filename | ecid | mode |
- *    type=1 (client read data) | filename |
+ *    type=0 (client write data)| filename | ecid | mode | filesizeMB | shmname |
+ *    type=1 (client read data) | filename | shmname |
  *    type=2 (read disk->memory) | read? (| objname | unitIdx | scratio | cid |)
  *    type=3 (fetch->compute->memory) | n prevs | n* (prevloc|prevkey) | m res | m * (n int) | key |
  *   ? type=4 (fetch->disk) |
@@ -22,6 +22,12 @@ using namespace std;
  *
  *    Below commands are only used for handling shortening packets
  *    type=12  (read disk->memory) **with n and w** | read? (| objname | unitIdx | scratio | cid |)
+ *
+ *    type=13  (ectasks of a stripe for the same agent) | n cmds | n * (cmdlen | cmd) |
+ *
+ *    Types 2, 3, 7 and 12 end with | m local refs | m * (cid | ref) |, the fetches of
+ *    each cached cid by tasks on the same agent, which take it in memory. Such a
+ *    task has 0 as the prevloc of that cid.
 
 
  */
@@ -41,9 +47,12 @@ private:
   string _ecid; // for writing with online encoding, it refers to ecid. Other wise, it refers to ecpoolid
   string _mode;
   int _filesizeMB;
+  // shared-memory ring offered by the client, empty if none
+  string _shmName;
 
   // type 1
   // _filename
+  // _shmName
 
   // common variables for ectasks
   bool _shouldSend;
@@ -52,6 +61,8 @@ private:
   int _ecw;                 // s/c ratio: a pkt is divided into _scratio slices
   int _num;                 // we based on the conf->pktSize, num = objsize/pktSize;
   unordered_map<int, int> _cacheRefs;
+  // cid -> the part of _cacheRefs fetched by tasks on the same agent
+  unordered_map<int, int> _localRefs;
 
   // type 2
   // read data from disk and write into memory
@@ -85,6 +96,16 @@ private:
   int _objnum;
   int _basesizeMB;
 
+  // trailer of types 2, 3, 7 and 12
+  void writeLocalRefs();
+  void readLocalRefs();
+  // serialize again after a change of the members
+  void rebuild();
+
+  // type 13
+  // _stripeName
+  vector<AGCommand *> _subCmds;
+
 public:
   AGCommand();
   ~AGCommand();
@@ -103,6 +124,7 @@ public:
   string getEcid();
   string getMode();
   int getFilesizeMB();
+  string getShmName();
   bool getShouldSend();
   unsigned int getSendIp();
   string getStripeName();
@@ -110,6 +132,7 @@ public:
   string getReadObjName();
   vector<int> getReadCidList();
   unordered_map<int, int> getCacheRefs();
+  unordered_map<int, int> getLocalRefs();
   int getNprevs();
   vector<int> getPrevCids();
   vector<unsigned int> getPrevLocs();
@@ -121,6 +144,11 @@ public:
   int getComputen();
   int getObjnum();
   int getBasesizeMB();
+  vector<AGCommand *> getSubCmds();
+
+  // for types 2, 3, 7 and 12, once built
+  void setLocalRefs(unordered_map<int, int> localRefs);
+  void setPrevLocs(vector<unsigned int> prevLocs);
 
   // send method
   void setRkey(string key);
@@ -131,9 +159,11 @@ public:
                   string filename,
                   string ecid,
                   string mode,
-                  int filesizeMB);
+                  int filesizeMB,
+                  string shmname);
   void buildType1(int type,
-                  string filename);
+                  string filename,
+                  string shmname);
   void buildType2(int type,
                   unsigned int sendIp,
                   string stripeName,
@@ -192,6 +222,12 @@ public:
                                 vector<int> cidlist,
                                 unordered_map<int, int> ref);
 
+  // the sub commands are owned by the batch afterwards
+  void buildType13(int type,
+                   unsigned int sendIp,
+                   string stripename,
+                   vector<AGCommand *> cmds);
+
   // resolve AGCommand
   void resolveType0();
   void resolveType1();
@@ -203,6 +239,7 @@ public:
   void resolveType11();
 
   void resolveType12ForShortening();
+  void resolveType13();
 
   // for debug
   void dump();
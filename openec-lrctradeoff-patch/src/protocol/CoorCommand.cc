@@ -34,6 +34,9 @@ CoorCommand::CoorCommand(char* reqStr) {
     case 9: resolveType9(); break;
     case 11: resolveType11(); break;
     case 12: resolveType12(); break;
+    case 13: resolveType13(); break;
+    case 14: resolveType14(); break;
+    case 15: resolveType15(); break;
     case 21: resolveType21(); break;
     case 22: resolveType22(); break;
     default: break;
@@ -130,6 +133,18 @@ string CoorCommand::getBenchName() {
   return _benchname;
 }
 
+string CoorCommand::getFailed() {
+  return _failed;
+}
+
+string CoorCommand::getRack() {
+  return _rack;
+}
+
+int CoorCommand::getSeconds() {
+  return _seconds;
+}
+
 void CoorCommand::sendTo(unsigned int ip) {
   redisContext* sendCtx = RedisUtil::createContext(ip);
   redisReply* rReply = (redisReply*)redisCommand(sendCtx, "RPUSH %s %b", _rKey.c_str(), _coorCmd, _cmLen);
@@ -332,6 +347,65 @@ void CoorCommand::resolveType12() {
   _benchname = readString();
 }
 
+void CoorCommand::buildType13(int type,
+                              unsigned int ip,
+                              string failed) {
+  _type = type;
+  _clientIp = ip;
+  _failed = failed;
+
+  writeInt(_type);
+  writeInt(_clientIp);
+  writeString(_failed);
+}
+
+void CoorCommand::resolveType13() {
+  _clientIp = readInt();
+  _failed = readString();
+}
+
+void CoorCommand::buildType14(int type,
+                              unsigned int ip,
+                              string rack,
+                              int seconds) {
+  _type = type;
+  _clientIp = ip;
+  _rack = rack;
+  _seconds = seconds;
+
+  writeInt(_type);
+  writeInt(_clientIp);
+  writeString(_rack);
+  writeInt(_seconds);
+}
+
+void CoorCommand::resolveType14() {
+  _clientIp = readInt();
+  _rack = readString();
+  _seconds = readInt();
+}
+
+void CoorCommand::buildType15(int type,
+                              unsigned int ip,
+                              string ecpoolid,
+                              string ecid) {
+  _type = type;
+  _clientIp = ip;
+  _ecpoolid = ecpoolid;
+  _ecid = ecid;
+
+  writeInt(_type);
+  writeInt(_clientIp);
+  writeString(_ecpoolid);
+  writeString(_ecid);
+}
+
+void CoorCommand::resolveType15() {
+  _clientIp = readInt();
+  _ecpoolid = readString();
+  _ecid = readString();
+}
+
 void CoorCommand::buildType21(int type) {
   _type = type;
 
@@ -381,5 +455,16 @@ void CoorCommand::dump() {
          << ", filename: " << _filename << endl;
   } else if (_type == 7) {
     cout << ", enable: " << _op << ", ectype: " << _ectype << endl;
+  } else if (_type == 13) {
+    cout << ", client: " << RedisUtil::ip2Str(_clientIp)
+         << ", failed: " << _failed << endl;
+  } else if (_type == 14) {
+    cout << ", client: " << RedisUtil::ip2Str(_clientIp)
+         << ", rack: " << _rack
+         << ", seconds: " << _seconds << endl;
+  } else if (_type == 15) {
+    cout << ", client: " << RedisUtil::ip2Str(_clientIp)
+         << ", ecpoolid: " << _ecpoolid
+         << ", ecid: " << _ecid << endl;
   }
 }
@@ -23,6 +23,9 @@ using namespace std;
  *  ? type = 10: clientip| filename |  // update lostmap in stripestore
  *   type = 11: clientip| filename |   // report successfully repair
  *   type = 12: clientip | benchname |
+ *   type = 13: clientip | failed | // repair all blocks of a failed node (ip) or rack (name) as a batch
+ *   type = 14: clientip | rack | seconds | // open a maintenance window on rack, 0 seconds closes it
+ *   type = 15: clientip | ecpoolid | ecid | // migrate the stripes of a pool to the placement of ecid
  *
  *   type = 21: // get hdfs metadata and save in stripe store
  *   type = 22: clientip | objname // offline degraded for object
@@ -68,6 +71,17 @@ private:
   // type12
   string _benchname;
 
+  // type13
+  string _failed;
+
+  // type14
+  string _rack;
+  int _seconds;
+
+  // type15
+  // _ecpoolid
+  // _ecid
+
 public:
   CoorCommand();
   ~CoorCommand();
@@ -93,6 +107,9 @@ public:
   string getECType();
   vector<int> getCorruptIdx();
   string getBenchName();
+  string getFailed();
+  string getRack();
+  int getSeconds();
 
   // send method
   void sendTo(unsigned int ip);
@@ -131,6 +148,17 @@ public:
   void buildType12(int type,
                    unsigned int ip,
                    string benchname);
+  void buildType13(int type,
+                   unsigned int ip,
+                   string failed);
+  void buildType14(int type,
+                   unsigned int ip,
+                   string rack,
+                   int seconds);
+  void buildType15(int type,
+                   unsigned int ip,
+                   string ecpoolid,
+                   string ecid);
   void buildType21(int type);
   void buildType22(int type,
                    unsigned int ip,
@@ -148,6 +176,9 @@ public:
   void resolveType9();
   void resolveType11();
   void resolveType12();
+  void resolveType13();
+  void resolveType14();
+  void resolveType15();
   void resolveType21();
   void resolveType22();
 